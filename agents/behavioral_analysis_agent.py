@@ -30,6 +30,9 @@ class BehavioralAnalysisAgent:
         # Baseline tracking
         self.flow_baselines: Dict[str, Dict[str, Any]] = defaultdict(dict)
         self.protocol_stats: Dict[str, Dict[str, int]] = defaultdict(lambda: defaultdict(int))
+
+        # Host profiles kept by the exporter, by host address
+        self.host_profiles: Dict[str, Dict[str, Any]] = {}
         
         # ML model (placeholder - would load actual model in production)
         self.ml_model = None
@@ -276,6 +279,43 @@ class BehavioralAnalysisAgent:
         
         logger.debug("Flow processed for baseline", src_ip=src_ip, protocol=protocol)
     
+    async def process_profile(self, event: Dict[str, Any]) -> List[Dict[str, Any]]:
+        """
+        Take host profiles from the exporter instead of rebuilding them from flows.
+
+        Args:
+            event: Profile event, a deviation or a snapshot part
+
+        Returns:
+            The deviations reported, if any
+        """
+        if event.get('kind') == 'snapshot':
+            for profile in event.get('profiles', []):
+                self.host_profiles[profile['host']] = profile
+
+            logger.debug(
+                "Host profiles received",
+                part=event.get('part'),
+                parts=event.get('parts'),
+                profiles=len(event.get('profiles', []))
+            )
+            return []
+
+        profile = event.get('profile', {})
+        host = profile.get('host')
+        deviations = event.get('deviations', [])
+
+        if host:
+            self.host_profiles[host] = profile
+
+        logger.warning(
+            "Host deviates from its profile",
+            host=host,
+            flow_id=event.get('flow_id'),
+            metrics=[d.get('metric') for d in deviations]
+        )
+        return deviations
+
     async def stop(self) -> None:
         """Stop the agent and cleanup resources."""
         logger.info("Behavioral Analysis Agent stopped")
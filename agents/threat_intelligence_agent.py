@@ -80,7 +80,7 @@ class ThreatIntelligenceAgent:
             
             Args:
                 ioc: The indicator (IP, domain, hash, etc.)
-                ioc_type: Type of indicator (ip, domain, hash, url)
+                ioc_type: Type of indicator (ip, domain, hash, url, ja3, ja4, ja3s, ja4s)
             
             Returns:
                 Threat intelligence data
@@ -119,6 +119,7 @@ class ThreatIntelligenceAgent:
         src_ip = event.get('src_ip')
         dst_ip = event.get('dst_ip')
         domain = event.get('domain')
+        tls = event.get('tls') or {}
         
         # Check cache first
         iocs_to_check = []
@@ -128,6 +129,9 @@ class ThreatIntelligenceAgent:
             iocs_to_check.append(('ip', dst_ip))
         if domain:
             iocs_to_check.append(('domain', domain))
+        for fingerprint in ('ja3', 'ja4', 'ja3s', 'ja4s'):
+            if tls.get(fingerprint):
+                iocs_to_check.append((fingerprint, tls[fingerprint]))
         
         # Lookup IOCs
         for ioc_type, ioc_value in iocs_to_check:
@@ -136,7 +140,7 @@ class ThreatIntelligenceAgent:
             if cache_key in self.cache:
                 # Check if cache is still valid
                 cached_data = self.cache[cache_key]
-                cache_age = datetime.utcnow() - datetime.fromisoformat(cached_data['cached_at'])
+                cache_age = datetime.now(UTC) - datetime.fromisoformat(cached_data['cached_at'])
                 if cache_age.total_seconds() < self.config.cache_ttl:
                     ioc_data = cached_data['data']
                     logger.debug("Using cached threat intel", ioc=ioc_value, type=ioc_type)
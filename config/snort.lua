@@ -78,6 +78,10 @@ port_scan = {
 }
 
 -- Output modules
+
+-- Rule alerts with gid/sid/rev/priority for ai_event_exporter
+alert_ai_ops = { }
+
 alert_fast = {
     file = true,
     packet = false
@@ -1,5 +1,13 @@
 """Connector modules for external system integrations."""
 
+from .event_topics import event_topic, parse_topic, topic_prefix
 from .snort3_event_stream import Snort3EventStream
+from .unix_datagram import UnixDatagramReceiver
 
-__all__ = ['Snort3EventStream']
+__all__ = [
+    'Snort3EventStream',
+    'UnixDatagramReceiver',
+    'event_topic',
+    'parse_topic',
+    'topic_prefix',
+]
@@ -0,0 +1,86 @@
+"""Topic prefixes used by the exporter's PUB mode.
+
+With ``zmq_socket_type = 'pub'`` every event is sent as two frames: a
+three byte topic (event type, priority, IP protocol) followed by the
+encoded event.  Subscribing to a prefix of the topic makes the publisher
+send only matching events, and classes nobody subscribes to are not even
+encoded.
+"""
+
+from typing import Any, Dict, Optional, Union
+
+EVENT_TYPES = {'alert': 0, 'flow': 1, 'flow_end': 2, 'beacon': 3, 'graph': 4, 'baseline': 5,
+               'profile': 6, 'dns': 7, 'heartbeat': 0xfe}
+
+PROTOCOLS = {'icmp': 1, 'tcp': 6, 'udp': 17, 'icmp6': 58}
+
+# events the exporter does not publish (e.g. simulated stats)
+UNKNOWN_TYPE = 0xff
+
+
+def _protocol_number(protocol: Union[str, int, None]) -> int:
+    if protocol is None:
+        return 0
+    if isinstance(protocol, int):
+        return protocol
+    if protocol.isdigit():
+        return int(protocol)
+    return PROTOCOLS[protocol.lower()]
+
+
+def topic_prefix(
+    event_type: Optional[str] = None,
+    priority: Optional[int] = None,
+    protocol: Union[str, int, None] = None
+) -> bytes:
+    """
+    Build a subscription prefix; later fields need the earlier ones.
+
+    Flows have priority 0, so TCP flows are topic_prefix('flow', 0, 'tcp').
+    """
+    if event_type is None:
+        return b''
+
+    prefix = bytes([EVENT_TYPES[event_type]])
+
+    if priority is None:
+        return prefix
+
+    prefix += bytes([priority])
+
+    if protocol is None:
+        return prefix
+
+    return prefix + bytes([_protocol_number(protocol)])
+
+
+def parse_topic(spec: str) -> bytes:
+    """
+    Parse 'type[:priority[:protocol]]', e.g. 'alert', 'alert:1' or
+    'flow:0:tcp'; an empty string subscribes to everything.
+    """
+    if not spec:
+        return b''
+
+    parts = spec.split(':')
+
+    if len(parts) > 3:
+        raise ValueError(f"bad topic '{spec}'")
+
+    priority = int(parts[1]) if len(parts) > 1 else None
+    protocol = parts[2] if len(parts) > 2 else None
+
+    return topic_prefix(parts[0], priority, protocol)
+
+
+def event_topic(event: Dict[str, Any]) -> bytes:
+    """The full topic the exporter would publish an event under."""
+    event_type = EVENT_TYPES.get(event.get('type', ''), UNKNOWN_TYPE)
+    priority = event.get('priority', 0) if event.get('type') == 'alert' else 0
+
+    try:
+        protocol = _protocol_number(event.get('protocol'))
+    except (KeyError, ValueError):
+        protocol = 0
+
+    return bytes([event_type, min(int(priority), 255), protocol & 0xff])
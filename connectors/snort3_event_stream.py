@@ -1,45 +1,105 @@
-"""Snort3 Event Stream connector using ZeroMQ."""
+"""Snort3 Event Stream connector using ZeroMQ or a unix:// socket."""
 
 import asyncio
 import json
-from typing import AsyncIterator, Dict, Any, Optional
+import struct
+from typing import AsyncIterator, Dict, Any, List, Optional, Tuple
 
 import zmq
 import zmq.asyncio
 import structlog
 import msgpack
 
+from .event_topics import parse_topic, topic_prefix
+from .unix_datagram import UnixDatagramReceiver
+
 logger = structlog.get_logger(__name__)
 
+# the lane bit of a sequence header asking us to ack the event
+ACK_REQUESTED = 0x80000000
+
 
 class Snort3EventStream:
-    """Connector for receiving events from Snort3 via ZeroMQ."""
+    """Connector for receiving events from Snort3 via ZeroMQ or a unix socket."""
     
     def __init__(
         self, 
         endpoint: str = 'tcp://127.0.0.1:5555',
         buffer_size: int = 10000,
-        timeout: int = 5000
+        timeout: int = 5000,
+        unix_socket_type: str = 'seqpacket',
+        zmq_socket_type: str = 'push',
+        topics: Optional[List[str]] = None,
+        flow_control: str = 'none',
+        credit_window: int = 1000,
+        alert_acks: bool = False,
+        heartbeat_interval: float = 0.0
     ):
         """
         Initialize the Snort3 event stream connector.
         
         Args:
-            endpoint: ZeroMQ endpoint URL
+            endpoint: ZeroMQ endpoint URL, or unix:///path for the unix sink
             buffer_size: Maximum buffer size for messages
             timeout: Receive timeout in milliseconds
+            unix_socket_type: 'seqpacket' or 'dgram' for unix:// endpoints
+            zmq_socket_type: the exporter's socket type; 'push' is received
+                with PULL, 'pub' with SUB
+            topics: with 'pub', the classes to subscribe to as
+                'type[:priority[:protocol]]', e.g. ['alert:1', 'flow:0:tcp'];
+                all events if empty
+            flow_control: 'credit' if the exporter runs with
+                flow_control = 'credit'; events are then received with a
+                bound ROUTER that grants each exporter credit_window events
+                and replenishes them as they are consumed
+            credit_window: events an exporter may send ahead of us
+            alert_acks: True if the exporter runs with alert_ack_window;
+                alerts are then received with a bound ROUTER, taken in
+                sequence order and acked once processed, so the exporter
+                resends any that were lost
+            heartbeat_interval: the exporter's heartbeat_interval in
+                seconds; when nothing arrives for three intervals the
+                exporter is reported stalled, 0 if it sends none
+
+        Events sent with sequence numbers are checked for gaps in every
+        lane; missed events are counted in the events_missed stat.
         """
         self.endpoint = endpoint
         self.buffer_size = buffer_size
         self.timeout = timeout
+        self.unix_socket_type = unix_socket_type
+        self.zmq_socket_type = zmq_socket_type
+        self.topics = [parse_topic(t) for t in (topics or [''])]
+        self.flow_control = flow_control
+        self.credit_window = max(1, credit_window)
+
+        self.alert_acks = alert_acks
+
+        # per exporter, events received since we last granted credit
+        self.consumed: Dict[bytes, int] = {}
+
+        # next sequence number expected per (peer, stream, lane)
+        self.sequences: Dict[Tuple[bytes, int, int], int] = {}
+
+        self.heartbeat_interval = heartbeat_interval
+        self.last_message = 0.0
+        self.stalled = False
+
+        # the latest heartbeat per (peer, sender)
+        self.liveness: Dict[Tuple[bytes, int], Dict[str, Any]] = {}
         
         self.context: Optional[zmq.asyncio.Context] = None
         self.socket: Optional[zmq.asyncio.Socket] = None
+        self.receiver: Optional[UnixDatagramReceiver] = None
         self.connected = False
         
         self.stats = {
             'events_received': 0,
             'events_dropped': 0,
+            'events_missed': 0,
+            'duplicates': 0,
+            'heartbeats': 0,
+            'stalls': 0,
             'errors': 0
         }
         
@@ -52,16 +112,50 @@ class Snort3EventStream:
     async def connect(self) -> None:
         """Establish connection to Snort3 event stream."""
         try:
+            if self.endpoint.startswith('unix://'):
+                self.receiver = UnixDatagramReceiver(
+                    self.endpoint[len('unix://'):],
+                    socket_type=self.unix_socket_type,
+                    buffer_size=self.buffer_size
+                )
+                await self.receiver.start()
+                self.connected = True
+
+                logger.info("Connected to Snort3 event stream", endpoint=self.endpoint)
+                return
+
             self.context = zmq.asyncio.Context()
-            self.socket = self.context.socket(zmq.PULL)
+            subscriber = self.zmq_socket_type == 'pub'
+            router = not subscriber and (self.flow_control == 'credit' or self.alert_acks)
+
+            if subscriber:
+                socket_type = zmq.SUB
+            elif router:
+                socket_type = zmq.ROUTER
+            else:
+                socket_type = zmq.PULL
+
+            self.socket = self.context.socket(socket_type)
             
             # Set socket options
             self.socket.setsockopt(zmq.RCVHWM, self.buffer_size)
             self.socket.setsockopt(zmq.RCVTIMEO, self.timeout)
             self.socket.setsockopt(zmq.LINGER, 0)
+
+            # the publisher filters on these, so unsubscribed classes
+            # never cross the wire
+            if subscriber:
+                for topic in self.topics:
+                    self.socket.setsockopt(zmq.SUBSCRIBE, topic)
+
+                if b'' not in self.topics:
+                    self.socket.setsockopt(zmq.SUBSCRIBE, topic_prefix('heartbeat'))
             
-            # Connect to endpoint
-            self.socket.connect(self.endpoint)
+            # Connect to endpoint; credit and ack mode exporters connect to us
+            if router:
+                self.socket.bind(self.endpoint)
+            else:
+                self.socket.connect(self.endpoint)
             self.connected = True
             
             logger.info("Connected to Snort3 event stream", endpoint=self.endpoint)
@@ -77,6 +171,11 @@ class Snort3EventStream:
     
     async def disconnect(self) -> None:
         """Disconnect from Snort3 event stream."""
+        if self.receiver:
+            self.stats['events_dropped'] += self.receiver.dropped
+            await self.receiver.stop()
+            self.receiver = None
+        
         if self.socket:
             self.socket.close()
             self.socket = None
@@ -103,15 +202,50 @@ class Snort3EventStream:
             raise RuntimeError("Not connected to event stream. Call connect() first.")
         
         logger.info("Starting event stream processing")
+        self.last_message = asyncio.get_event_loop().time()
         
         try:
             while self.connected:
                 try:
+                    ack = None
+                    peer = b''
+
                     # Receive message
-                    message = await self.socket.recv()
+                    if self.receiver:
+                        message = await self.receiver.get(self.timeout / 1000.0)
+                    else:
+                        # a published event follows its topic frame, a
+                        # credit or ack mode event its sender's identity,
+                        # and with sequence numbers it has a header frame
+                        frames = await self.socket.recv_multipart()
+                        message = frames[-1]
+                        router = self.socket.socket_type == zmq.ROUTER
+                        peer = frames[0] if router else b''
+
+                        if router and not message:
+                            await self._hello(peer)
+                            continue
+
+                        if self.flow_control == 'credit' and router:
+                            await self._account_credit(peer)
+
+                        base = 1 if self.socket.socket_type == zmq.PULL else 2
+
+                        if len(frames) > base:
+                            taken, ack = self._check_sequence(peer, frames[-2])
+
+                            if not taken:
+                                await self._ack(ack)
+                                continue
                     
+                    self._alive()
+
                     # Deserialize event
                     event = self._deserialize_event(message)
+
+                    if event and event.get('type') == 'heartbeat':
+                        self._heartbeat(peer, event)
+                        continue
                     
                     if event:
                         self.stats['events_received'] += 1
@@ -123,9 +257,13 @@ class Snort3EventStream:
                     else:
                         self.stats['events_dropped'] += 1
                         logger.warning("Failed to deserialize event")
+
+                    # after the event was handled, so a crash gets it resent
+                    await self._ack(ack)
                 
-                except zmq.Again:
+                except (zmq.Again, asyncio.TimeoutError):
                     # Timeout - continue
+                    self._check_stall()
                     await asyncio.sleep(0.1)
                     continue
                 
@@ -145,6 +283,129 @@ class Snort3EventStream:
         finally:
             logger.info("Event stream processing stopped", stats=self.stats)
     
+    async def _hello(self, peer: bytes) -> None:
+        """
+        A sink says hello with an empty message when it has no credit left,
+        on connecting or after waiting a while, so it gets a full window.
+        """
+        if self.flow_control == 'credit':
+            self.consumed[peer] = 0
+            await self._grant(peer, self.credit_window)
+
+    async def _account_credit(self, peer: bytes) -> None:
+        """
+        Replenish credit once half the window is consumed, keeping the
+        exporter streaming without letting it run further than
+        credit_window events ahead of us.  Resent alerts count too, since
+        the exporter spent credit on them.
+        """
+        consumed = self.consumed.get(peer, 0) + 1
+
+        if consumed >= (self.credit_window + 1) // 2:
+            await self._grant(peer, consumed)
+            consumed = 0
+
+        self.consumed[peer] = consumed
+
+    async def _grant(self, peer: bytes, events: int) -> None:
+        await self.socket.send_multipart([peer, struct.pack('!I', events)])
+
+    def _check_sequence(
+        self,
+        peer: bytes,
+        header: bytes
+    ) -> Tuple[bool, Optional[Tuple[bytes, int]]]:
+        """
+        Check an event's sequence header (stream id, lane, sequence number).
+
+        Returns whether to take the event and what to ack for it, if
+        anything.  Acked lanes are taken strictly in order: the exporter
+        resends everything after the last ack, so anything else is a
+        duplicate or will come again.  Other lanes are best effort and only
+        have their gaps counted; one seen again is dropped without moving
+        the lane back, which would count the events after it as missed.
+        """
+        if len(header) != 16:
+            return True, None
+
+        stream, lane, seq = struct.unpack('!IIQ', header)
+        key = (peer, stream, lane & ~ACK_REQUESTED)
+        expected = self.sequences.get(key)
+
+        if lane & ACK_REQUESTED:
+            if expected is not None and seq != expected:
+                if seq < expected:
+                    self.stats['duplicates'] += 1
+                return False, (peer, expected - 1)
+
+            self.sequences[key] = seq + 1
+            return True, (peer, seq)
+
+        if expected is not None:
+            if seq < expected:
+                self.stats['duplicates'] += 1
+                return False, None
+
+            self.stats['events_missed'] += seq - expected
+
+        self.sequences[key] = seq + 1
+        return True, None
+
+    def _heartbeat(self, peer: bytes, heartbeat: Dict[str, Any]) -> None:
+        """
+        Record an exporter heartbeat and check its lane marks.
+
+        A heartbeat follows the events sent before it on the same socket,
+        so a lane whose last sent sequence number is past what we received
+        lost the difference.  Acked lanes are skipped; the exporter resends
+        those.  Lanes we never saw (topics we do not subscribe to) are too.
+        """
+        self.stats['heartbeats'] += 1
+        heartbeat['_received_at'] = asyncio.get_event_loop().time()
+        self.liveness[(peer, heartbeat.get('sender', 0))] = heartbeat
+
+        for stream, lane, seq in heartbeat.get('sequences', []):
+            if lane & ACK_REQUESTED:
+                continue
+
+            key = (peer, stream, lane)
+            expected = self.sequences.get(key)
+
+            if expected is not None and seq >= expected:
+                self.stats['events_missed'] += seq - expected + 1
+                self.sequences[key] = seq + 1
+
+    def _alive(self) -> None:
+        self.last_message = asyncio.get_event_loop().time()
+
+        if self.stalled:
+            self.stalled = False
+            logger.info("Snort3 event stream resumed", endpoint=self.endpoint)
+
+    def _check_stall(self) -> None:
+        """An exporter that sends heartbeats and went quiet is stalled or gone."""
+        if not self.heartbeat_interval or self.stalled:
+            return
+
+        silent = asyncio.get_event_loop().time() - self.last_message
+
+        if silent > 3 * self.heartbeat_interval:
+            self.stalled = True
+            self.stats['stalls'] += 1
+            logger.warning(
+                "No events or heartbeats from Snort3",
+                endpoint=self.endpoint,
+                silent_seconds=round(silent, 1)
+            )
+
+    def get_liveness(self) -> Dict[Tuple[bytes, int], Dict[str, Any]]:
+        """The latest heartbeat of each exporter sender, by (peer, sender)."""
+        return dict(self.liveness)
+
+    async def _ack(self, ack: Optional[Tuple[bytes, int]]) -> None:
+        if ack:
+            await self.socket.send_multipart([ack[0], struct.pack('!Q', ack[1])])
+
     def _deserialize_event(self, message: bytes) -> Optional[Dict[str, Any]]:
         """
         Deserialize event message.
@@ -0,0 +1,231 @@
+"""Unix domain datagram receiver for the Snort3 event exporter's unix:// sink."""
+
+import asyncio
+import ctypes
+import ctypes.util
+import errno
+import os
+import socket
+from typing import List, Optional, Tuple
+
+import structlog
+
+logger = structlog.get_logger(__name__)
+
+# Largest event the exporter will put in one datagram
+MAX_EVENT_SIZE = 65536
+
+# Datagrams drained per recvmmsg() call
+RECV_BATCH = 64
+
+
+class _IoVec(ctypes.Structure):
+    _fields_ = [('iov_base', ctypes.c_void_p), ('iov_len', ctypes.c_size_t)]
+
+
+class _MsgHdr(ctypes.Structure):
+    _fields_ = [
+        ('msg_name', ctypes.c_void_p),
+        ('msg_namelen', ctypes.c_uint32),
+        ('msg_iov', ctypes.POINTER(_IoVec)),
+        ('msg_iovlen', ctypes.c_size_t),
+        ('msg_control', ctypes.c_void_p),
+        ('msg_controllen', ctypes.c_size_t),
+        ('msg_flags', ctypes.c_int),
+    ]
+
+
+class _MMsgHdr(ctypes.Structure):
+    _fields_ = [('msg_hdr', _MsgHdr), ('msg_len', ctypes.c_uint)]
+
+
+def _load_recvmmsg():
+    """Return libc's recvmmsg, or None where it is not available."""
+    try:
+        libc = ctypes.CDLL(ctypes.util.find_library('c'), use_errno=True)
+        fn = libc.recvmmsg
+    except (OSError, AttributeError):
+        return None
+
+    fn.argtypes = [
+        ctypes.c_int, ctypes.POINTER(_MMsgHdr), ctypes.c_uint, ctypes.c_int, ctypes.c_void_p
+    ]
+    fn.restype = ctypes.c_int
+    return fn
+
+
+_recvmmsg = _load_recvmmsg()
+
+
+class MMsgReader:
+    """Reads up to RECV_BATCH datagrams from a socket with one recvmmsg() call."""
+
+    def __init__(self, batch: int = RECV_BATCH, max_size: int = MAX_EVENT_SIZE):
+        self.batch = batch
+        self.max_size = max_size
+
+        self._buffers = [ctypes.create_string_buffer(max_size) for _ in range(batch)]
+        self._iov = (_IoVec * batch)()
+        self._msgs = (_MMsgHdr * batch)()
+
+        for i, buf in enumerate(self._buffers):
+            self._iov[i].iov_base = ctypes.cast(buf, ctypes.c_void_p)
+            self._iov[i].iov_len = max_size
+            self._msgs[i].msg_hdr.msg_iov = ctypes.pointer(self._iov[i])
+            self._msgs[i].msg_hdr.msg_iovlen = 1
+
+    def read(self, sock: socket.socket) -> Tuple[List[bytes], bool]:
+        """
+        Drain whatever is queued on a non-blocking socket.
+
+        Returns:
+            Received datagrams (empty if nothing was queued), and whether
+            the peer closed a seqpacket connection after sending them
+        """
+        if _recvmmsg is None:
+            return self._read_fallback(sock)
+
+        n = _recvmmsg(sock.fileno(), self._msgs, self.batch, socket.MSG_DONTWAIT, None)
+
+        if n < 0:
+            err = ctypes.get_errno()
+            if err in (errno.EAGAIN, errno.EWOULDBLOCK, errno.EINTR):
+                return [], False
+            raise OSError(err, os.strerror(err))
+
+        messages = []
+        seqpacket = sock.type == socket.SOCK_SEQPACKET
+
+        for i in range(n):
+            length = self._msgs[i].msg_len
+            if length == 0 and seqpacket:
+                return messages, True
+            messages.append(self._buffers[i].raw[:length])
+
+        return messages, False
+
+    def _read_fallback(self, sock: socket.socket) -> Tuple[List[bytes], bool]:
+        messages = []
+        seqpacket = sock.type == socket.SOCK_SEQPACKET
+
+        for _ in range(self.batch):
+            try:
+                data = sock.recv(self.max_size, socket.MSG_DONTWAIT)
+            except BlockingIOError:
+                break
+
+            if not data and seqpacket:
+                return messages, True
+
+            messages.append(data)
+
+        return messages, False
+
+
+class UnixDatagramReceiver:
+    """
+    Consumer side of the exporter's unix:// sink.
+
+    Binds (dgram) or listens (seqpacket) on the socket path and feeds every
+    received event into an asyncio queue.  Each sender thread of the
+    exporter connects separately when seqpacket is used.
+    """
+
+    def __init__(
+        self,
+        path: str,
+        socket_type: str = 'seqpacket',
+        buffer_size: int = 10000
+    ):
+        """
+        Initialize the receiver.
+
+        Args:
+            path: Filesystem path of the socket
+            socket_type: 'seqpacket' or 'dgram', matching unix_socket_type
+            buffer_size: Maximum number of queued events
+        """
+        if socket_type not in ('seqpacket', 'dgram'):
+            raise ValueError(f"unsupported unix socket type: {socket_type}")
+
+        self.path = path
+        self.socket_type = socket_type
+        self.queue: asyncio.Queue = asyncio.Queue(maxsize=buffer_size)
+
+        self.dropped = 0
+
+        self._listener: Optional[socket.socket] = None
+        self._connections: List[socket.socket] = []
+        self._reader = MMsgReader()
+        self._loop: Optional[asyncio.AbstractEventLoop] = None
+
+    async def start(self) -> None:
+        """Create the socket and start receiving."""
+        self._loop = asyncio.get_running_loop()
+
+        if os.path.exists(self.path):
+            os.unlink(self.path)
+
+        kind = socket.SOCK_DGRAM if self.socket_type == 'dgram' else socket.SOCK_SEQPACKET
+        self._listener = socket.socket(socket.AF_UNIX, kind)
+        self._listener.setblocking(False)
+        self._listener.bind(self.path)
+
+        if kind == socket.SOCK_DGRAM:
+            self._loop.add_reader(self._listener.fileno(), self._on_readable, self._listener)
+        else:
+            self._listener.listen(64)
+            self._loop.add_reader(self._listener.fileno(), self._on_accept)
+
+        logger.info("Listening for Snort3 events", path=self.path, socket_type=self.socket_type)
+
+    async def stop(self) -> None:
+        """Stop receiving and remove the socket."""
+        for conn in list(self._connections):
+            self._close(conn)
+
+        if self._listener:
+            self._loop.remove_reader(self._listener.fileno())
+            self._listener.close()
+            self._listener = None
+
+        if os.path.exists(self.path):
+            os.unlink(self.path)
+
+    async def get(self, timeout: float) -> bytes:
+        """Next event; raises asyncio.TimeoutError if none arrives in time."""
+        return await asyncio.wait_for(self.queue.get(), timeout)
+
+    def _on_accept(self) -> None:
+        try:
+            conn, _ = self._listener.accept()
+        except BlockingIOError:
+            return
+
+        conn.setblocking(False)
+        self._connections.append(conn)
+        self._loop.add_reader(conn.fileno(), self._on_readable, conn)
+
+    def _on_readable(self, sock: socket.socket) -> None:
+        try:
+            messages, closed = self._reader.read(sock)
+        except OSError:
+            # A failed listener socket is left for stop() to tear down
+            messages, closed = [], sock is not self._listener
+
+        for message in messages:
+            try:
+                self.queue.put_nowait(message)
+            except asyncio.QueueFull:
+                self.dropped += 1
+
+        if closed:
+            self._close(sock)
+
+    def _close(self, sock: socket.socket) -> None:
+        self._loop.remove_reader(sock.fileno())
+
+        if sock in self._connections:
+            self._connections.remove(sock)
+
+        sock.close()
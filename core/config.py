@@ -14,6 +14,13 @@ class EventStreamConfig(BaseModel):
     endpoint: str = 'tcp://127.0.0.1:5555'
     buffer_size: int = 10000
     timeout: int = 5000
+    unix_socket_type: str = 'seqpacket'
+    zmq_socket_type: str = 'push'
+    topics: List[str] = Field(default_factory=list)
+    flow_control: str = 'none'
+    credit_window: int = 1000
+    alert_acks: bool = False
+    heartbeat_interval: float = 0.0
 
 
 class ThreatIntelConfig(BaseModel):
@@ -120,7 +120,14 @@ class AIOpsEngine:
         self.event_stream = Snort3EventStream(
             endpoint=self.config.event_stream.endpoint,
             buffer_size=self.config.event_stream.buffer_size,
-            timeout=self.config.event_stream.timeout
+            timeout=self.config.event_stream.timeout,
+            unix_socket_type=self.config.event_stream.unix_socket_type,
+            zmq_socket_type=self.config.event_stream.zmq_socket_type,
+            topics=self.config.event_stream.topics,
+            flow_control=self.config.event_stream.flow_control,
+            credit_window=self.config.event_stream.credit_window,
+            alert_acks=self.config.event_stream.alert_acks,
+            heartbeat_interval=self.config.event_stream.heartbeat_interval
         )
         
         logger.info(
@@ -205,6 +212,62 @@ class AIOpsEngine:
             if 'behavioral' in self.agents:
                 await self.agents['behavioral'].process_flow(event)
         
+        # Host behaviour profiles: deviations and on-demand snapshots
+        elif event_type == 'profile':
+            if 'behavioral' in self.agents:
+                await self.agents['behavioral'].process_profile(event)
+
+        # Storm summaries stand in for a misfiring rule's alerts
+        elif event_type == 'storm':
+            logger.warning(
+                "Alert storm",
+                state=event.get('state'),
+                sid=event.get('sid'),
+                rate=event.get('rate'),
+                suppressed_total=event.get('suppressed_total')
+            )
+
+        # Periodic connection pairs scored by the exporter
+        elif event_type == 'beacon':
+            logger.warning(
+                "Beacon candidate",
+                src_ip=event.get('src_ip'),
+                dst_ip=event.get('dst_ip'),
+                dst_port=event.get('dst_port'),
+                interval_ms=event.get('interval_ms'),
+                periodicity=event.get('periodicity')
+            )
+
+        # Communication graph snapshots, possibly in several parts
+        elif event_type == 'graph':
+            logger.debug(
+                "Graph snapshot",
+                part=event.get('part'),
+                parts=event.get('parts'),
+                nodes=len(event.get('nodes', [])),
+                edges=len(event.get('edges', []))
+            )
+
+        # Per-port and per-host flow quantile sketches, possibly in several parts
+        elif event_type == 'baseline':
+            logger.debug(
+                "Flow baselines",
+                part=event.get('part'),
+                parts=event.get('parts'),
+                baselines=len(event.get('baselines', []))
+            )
+
+        # Answered DNS queries with their name features already computed
+        elif event_type == 'dns':
+            logger.debug(
+                "DNS query",
+                src_ip=event.get('src_ip'),
+                query=event.get('query'),
+                entropy=event.get('entropy'),
+                subdomain=event.get('subdomain'),
+                client_rate=event.get('client_rate')
+            )
+
         # Stats events - rule optimization
         elif event_type == 'stats':
             if 'rule_optimizer' in self.agents:
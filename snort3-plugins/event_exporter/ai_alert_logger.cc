@@ -0,0 +1,117 @@
+//--------------------------------------------------------------------------
+// ai_alert_logger.cc - Rule alerts with signature details for the exporter
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "ai_alert_logger.h"
+
+#include "events/event.h"
+#include "framework/module.h"
+
+#include <atomic>
+
+#include "ai_event_exporter.h"
+
+using namespace snort;
+
+#define S_NAME "alert_ai_ops"
+#define S_HELP "hand rule alerts with gid, sid, rev and priority to ai_event_exporter"
+
+// loggers live across a reload, so more than one can exist at a time
+static std::atomic<unsigned> active_loggers { 0 };
+
+bool ai_alert_logger_active()
+{
+    return active_loggers.load(std::memory_order_relaxed) > 0;
+}
+
+//-------------------------------------------------------------------------
+// Module
+//-------------------------------------------------------------------------
+
+class AIAlertModule : public Module
+{
+public:
+    AIAlertModule() : Module(S_NAME, S_HELP) { }
+
+    Usage get_usage() const override
+    { return CONTEXT; }
+};
+
+//-------------------------------------------------------------------------
+// Logger
+//-------------------------------------------------------------------------
+
+class AIAlertLogger : public Logger
+{
+public:
+    AIAlertLogger()
+    { active_loggers++; }
+
+    ~AIAlertLogger() override
+    { active_loggers--; }
+
+    void alert(Packet*, const char* msg, const Event&) override;
+};
+
+void AIAlertLogger::alert(Packet* p, const char* msg, const Event& event)
+{
+    AIEventExporter* exporter = AIEventExporter::get_thread_exporter();
+
+    if (!exporter || !p)
+        return;
+
+    RuleAlert ra;
+    uint32_t class_id;
+
+    event.get_sig_ident(ra.gid, ra.sid, ra.rev, class_id, ra.priority);
+    ra.msg = msg;
+
+    exporter->export_rule_alert(p, ra);
+}
+
+//-------------------------------------------------------------------------
+// API
+//-------------------------------------------------------------------------
+
+static Module* mod_ctor()
+{
+    return new AIAlertModule;
+}
+
+static void mod_dtor(Module* m)
+{
+    delete m;
+}
+
+static Logger* ai_alert_ctor(Module*)
+{
+    return new AIAlertLogger;
+}
+
+static void ai_alert_dtor(Logger* p)
+{
+    delete p;
+}
+
+const LogApi ai_alert_api =
+{
+    {
+        PT_LOGGER,
+        sizeof(LogApi),
+        LOGAPI_VERSION,
+        0,
+        API_RESERVED,
+        API_OPTIONS,
+        S_NAME,
+        S_HELP,
+        mod_ctor,
+        mod_dtor
+    },
+    OUTPUT_TYPE_FLAG__ALERT,
+    ai_alert_ctor,
+    ai_alert_dtor
+};
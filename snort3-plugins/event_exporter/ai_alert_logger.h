@@ -0,0 +1,33 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// ai_alert_logger.h - Rule alerts with signature details for the exporter
+
+#ifndef AI_ALERT_LOGGER_H
+#define AI_ALERT_LOGGER_H
+
+#include "framework/logger.h"
+
+//-------------------------------------------------------------------------
+// An inspector never sees which rules fired, so the alert_ai_ops logger
+// hands each rule alert (gid, sid, rev, priority, msg) to the exporter on
+// the same packet thread.  While it is configured, these replace the
+// exporter's own per-packet verdict alerts.
+//-------------------------------------------------------------------------
+
+extern const snort::LogApi ai_alert_api;
+
+// true while an alert_ai_ops logger is configured
+bool ai_alert_logger_active();
+
+#endif
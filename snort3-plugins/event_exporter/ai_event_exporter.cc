@@ -7,21 +7,34 @@
 #endif
 
 #include "ai_event_exporter.h"
+#include "ai_alert_logger.h"
+#include "ai_flow_data.h"
+#include "event_sender.h"
+#include "event_sink.h"
+#include "event_topics.h"
 
 #include "detection/detection_engine.h"
 #include "events/event.h"
 #include "flow/flow.h"
 #include "framework/data_bus.h"
 #include "log/messages.h"
+#include "managers/module_manager.h"
+#include "main/thread.h"
+#include "main/thread_config.h"
 #include "packet_io/active.h"
 #include "protocols/packet.h"
 #include "protocols/tcp.h"
 #include "protocols/udp.h"
+#include "pub_sub/dns_events.h"
 #include "pub_sub/intrinsic_event_ids.h"
 #include "time/packet_time.h"
 
 #include <nlohmann/json.hpp>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
 
 using namespace snort;
 using namespace std;
@@ -31,10 +44,57 @@ using json = nlohmann::json;
 // Module Implementation
 //-------------------------------------------------------------------------
 
+static const Parameter ai_sink_params[] =
+{
+    { "endpoint", Parameter::PT_STRING, nullptr, nullptr,
+      "endpoint of this sink, in the same forms as the primary endpoint" },
+
+    { "backpressure", Parameter::PT_ENUM, "block | drop", "block",
+      "when this sink falls behind, hold back all sinks or drop its own events" },
+
+    { "types", Parameter::PT_MULTI, "alert | flow | flow_end | beacon | graph | baseline | profile | dns", nullptr,
+      "event types routed to this sink (default all)" },
+
+    { "max_priority", Parameter::PT_INT, "0:255", "0",
+      "route only alerts of this priority or higher (1 is highest, 0 = no limit)" },
+
+    { "protocols", Parameter::PT_STRING, nullptr, nullptr,
+      "IP protocols routed to this sink, by name (icmp, tcp, udp, icmp6) or number" },
+
+    { "sids", Parameter::PT_STRING, nullptr, nullptr,
+      "alert sids or sid ranges routed to this sink, e.g. '2000000:2099999 1337'" },
+
+    { "nets", Parameter::PT_STRING, nullptr, nullptr,
+      "route only events with either end in one of these IPv4 or IPv6 prefixes" },
+
+    { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
+};
+
 static const Parameter ai_event_params[] =
 {
     { "endpoint", Parameter::PT_STRING, nullptr, "tcp://127.0.0.1:5555",
-      "ZeroMQ endpoint for event streaming" },
+      "ZeroMQ endpoint, file:///path/prefix for a local archive or unix:///path for a unix socket; {node} and {sender} are replaced per sender thread; empty to use only sinks" },
+
+    { "backpressure", Parameter::PT_ENUM, "block | drop", "block",
+      "when the primary endpoint falls behind, hold back all sinks or drop its own events" },
+
+    { "sinks", Parameter::PT_LIST, ai_sink_params, nullptr,
+      "additional sinks; each event is encoded once and shared by all of them" },
+
+    { "export_filter", Parameter::PT_STRING, nullptr, nullptr,
+      "tcpdump-like expression over addresses, ports and protocol; only matching packets are exported or seen by the flow analytics" },
+
+    { "include_nets", Parameter::PT_STRING, nullptr, nullptr,
+      "export and analyse only packets with either end in one of these IPv4 or IPv6 prefixes" },
+
+    { "include_nets_file", Parameter::PT_STRING, nullptr, nullptr,
+      "file of further include prefixes, one or more per line, # starts a comment" },
+
+    { "exclude_nets", Parameter::PT_STRING, nullptr, nullptr,
+      "never export or analyse packets with either end in one of these IPv4 or IPv6 prefixes" },
+
+    { "exclude_nets_file", Parameter::PT_STRING, nullptr, nullptr,
+      "file of further exclude prefixes, one or more per line, # starts a comment" },
 
     { "export_alerts", Parameter::PT_BOOL, nullptr, "true",
       "export alert events" },
@@ -54,6 +114,138 @@ static const Parameter ai_event_params[] =
     { "flush_interval", Parameter::PT_INT, "100:10000", "1000",
       "flush interval in milliseconds" },
 
+    { "encoding", Parameter::PT_ENUM, "json | msgpack", "json",
+      "wire encoding of exported events" },
+
+    { "numa_senders", Parameter::PT_BOOL, nullptr, "true",
+      "run one sender thread per NUMA node, each with its own socket" },
+
+    { "sender_cpus", Parameter::PT_STRING, nullptr, nullptr,
+      "CPUs to pin sender threads to, e.g. '2,26'; each node's senders use the listed CPUs on their node" },
+
+    { "sender_threads", Parameter::PT_INT, "1:64", "1",
+      "sender threads per NUMA node; idle senders steal work from busy ones" },
+
+    { "sharding", Parameter::PT_ENUM, "node | flow", "node",
+      "assign events to senders by producer node, or by flow hash to keep each flow in order on one socket" },
+
+    { "latency_mode", Parameter::PT_ENUM, "batch | busy_poll", "batch",
+      "batch wakes senders per flush threshold or interval; busy_poll spins pinned senders for lowest latency" },
+
+    { "file_rotate_size", Parameter::PT_INT, "0:1048576", "1024",
+      "start a new archive file after this many MiB (0 = no size limit)" },
+
+    { "file_rotate_interval", Parameter::PT_INT, "0:86400", "3600",
+      "start a new archive file after this many seconds (0 = no time limit)" },
+
+    { "file_direct_io", Parameter::PT_BOOL, nullptr, "false",
+      "open archive files with O_DIRECT, padding each write to 4 KiB" },
+
+    { "unix_socket_type", Parameter::PT_ENUM, "seqpacket | dgram", "seqpacket",
+      "socket type for unix:// endpoints" },
+
+    { "zmq_socket_type", Parameter::PT_ENUM, "push | pub", "push",
+      "push connects to one consumer; pub binds and sends each event under a type, priority and protocol topic; with more than one sender thread a pub endpoint needs {sender} or {node}" },
+
+    { "flow_control", Parameter::PT_ENUM, "none | credit", "none",
+      "with credit, push sinks send only as many events as the consumer has granted and hold or drop the rest per backpressure" },
+
+    { "sequence_events", Parameter::PT_BOOL, nullptr, "false",
+      "send each ZeroMQ event after a header with its stream, lane and 64-bit sequence number so consumers can detect gaps" },
+
+    { "alert_ack_window", Parameter::PT_INT, "0:65535", "0",
+      "push sinks keep alerts until the consumer acks them, resending unacked ones, with at most this many in flight (0 = best effort); implies sequence_events" },
+
+    { "shutdown_drain", Parameter::PT_INT, "0:60000", "1000",
+      "milliseconds sender threads keep delivering at shutdown before spooling or losing what is left" },
+
+    { "spool_dir", Parameter::PT_STRING, nullptr, nullptr,
+      "directory for events still undelivered when the shutdown drain ends; they are sent first on the next start or reload" },
+
+    { "heartbeat_interval", Parameter::PT_INT, "0:3600000", "0",
+      "milliseconds between heartbeats with lane sequence marks, queue depths and uptime from each sender to each sink (0 = none)" },
+
+    { "storm_rate", Parameter::PT_INT, "0:max32", "0",
+      "alerts per second from one sid on one packet thread that switch the sid to storm summaries (0 = no absolute limit)" },
+
+    { "storm_zscore", Parameter::PT_REAL, "0:1000", "0",
+      "standard deviations above a sid's per second baseline that switch it to storm summaries (0 = no baseline test)" },
+
+    { "storm_min_rate", Parameter::PT_INT, "1:max32", "100",
+      "alerts per second from one sid on one packet thread below which storm_zscore never trips" },
+
+    { "storm_recovery", Parameter::PT_INT, "1:3600", "10",
+      "seconds a storming sid must stay under half its trip rate before its alerts are exported again" },
+
+    { "rate_limit", Parameter::PT_INT, "0:max32", "0",
+      "events per second this sensor may export over all sinks (0 = no limit)" },
+
+    { "rate_limit_bytes", Parameter::PT_INT, "0:max32", "0",
+      "encoded bytes per second this sensor may export over all sinks (0 = no limit)" },
+
+    { "rate_limit_shares", Parameter::PT_STRING, nullptr, "alert:50 flow_end:25 flow:25",
+      "percent of the rate limits reserved per event type; each may borrow from those after it in alert, beacon, profile, flow_end, dns, flow" },
+
+    { "beacon_pairs", Parameter::PT_INT, "0:max32", "0",
+      "client, server and port pairs tracked for periodic connections (0 = no beacon detection)" },
+
+    { "beacon_periodicity", Parameter::PT_REAL, "0:1", "0.8",
+      "share of a pair's recent connection gaps that must fall in one band to make it a beacon candidate" },
+
+    { "beacon_jitter", Parameter::PT_REAL, "0:10", "0.2",
+      "largest standard deviation over mean of the gaps in that band for a beacon candidate" },
+
+    { "beacon_min_connections", Parameter::PT_INT, "3:17", "8",
+      "connections a pair needs before it is scored" },
+
+    { "beacon_min_interval", Parameter::PT_INT, "1:max32", "1000",
+      "milliseconds; connections closer together than this count as one" },
+
+    { "graph_interval", Parameter::PT_INT, "0:86400", "0",
+      "seconds between communication graph snapshots of the flows ended in between (0 = none)" },
+
+    { "graph_edges", Parameter::PT_INT, "1024:16777216", "65536",
+      "distinct client, server, port and protocol edges each packet thread can hold per interval" },
+
+    { "baseline_interval", Parameter::PT_INT, "0:86400", "0",
+      "seconds between updates of the per-port and per-host flow baselines (0 = none)" },
+
+    { "baseline_halflife", Parameter::PT_INT, "1:max32", "3600",
+      "seconds for a flow's weight in the baselines to halve" },
+
+    { "baseline_hosts", Parameter::PT_INT, "0:1048576", "4096",
+      "internal hosts given a baseline of their own" },
+
+    { "baseline_nets", Parameter::PT_STRING, nullptr, nullptr,
+      "IPv4 or IPv6 prefixes whose hosts get baselines of their own" },
+
+    { "profile_hosts", Parameter::PT_INT, "0:16777216", "0",
+      "internal hosts given a behaviour profile (0 = no profiles)" },
+
+    { "profile_nets", Parameter::PT_STRING, nullptr, nullptr,
+      "IPv4 or IPv6 prefixes whose hosts are profiled" },
+
+    { "profile_zscore", Parameter::PT_REAL, "1:100", "4",
+      "standard deviations above a host's profile that make a deviation event" },
+
+    { "profile_min_flows", Parameter::PT_INT, "1:max32", "100",
+      "flows a host needs before its profile is tested" },
+
+    { "payload_bytes", Parameter::PT_INT, "0:4096", "0",
+      "first payload bytes of each flow direction whose entropy and byte classes go in flow_end events (0 = none)" },
+
+    { "tls_fingerprints", Parameter::PT_BOOL, nullptr, "false",
+      "add JA3 and JA4 fingerprints of the TLS hellos to flow, flow_end and alert events" },
+
+    { "tcp_health", Parameter::PT_BOOL, nullptr, "false",
+      "add handshake round trips, retransmits, out of order segments and zero windows to flow_end events" },
+
+    { "export_dns", Parameter::PT_BOOL, nullptr, "false",
+      "export the name features of each DNS query the dns inspector sees answered" },
+
+    { "dns_clients", Parameter::PT_INT, "1024:16777216", "65536",
+      "clients whose query rates are tracked for dns events" },
+
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
@@ -61,18 +253,99 @@ AIEventExporterModule::AIEventExporterModule()
     : Module("ai_event_exporter", "AI-Ops event exporter plugin", ai_event_params)
 {
     config.endpoint = "tcp://127.0.0.1:5555";
+    config.backpressure = BACKPRESSURE_BLOCK;
     config.export_alerts = true;
     config.export_flows = true;
     config.export_stats = false;
     config.min_severity = "low";
     config.buffer_size = 10000;
     config.flush_interval = 1000;
+    config.encoding = ENCODING_JSON;
+    config.numa_senders = true;
+    config.sender_threads = 1;
+    config.sharding = SHARD_BY_NODE;
+    config.latency_mode = LATENCY_BATCH;
+    config.file_rotate_size = 1024;
+    config.file_rotate_interval = 3600;
+    config.file_direct_io = false;
+    config.unix_socket_type = UNIX_SEQPACKET;
+    config.zmq_socket_type = ZMQ_SOCKET_PUSH;
+    config.flow_control = FLOW_CONTROL_NONE;
+    config.sequence_events = false;
+    config.alert_ack_window = 0;
+    config.shutdown_drain = 1000;
+    config.heartbeat_interval = 0;
+    config.storm = StormConfig();
+    config.rate_limit = RateLimitConfig();
+    config.beacons = BeaconConfig();
+    config.graph_interval = 0;
+    config.graph_edges = 65536;
+    config.baselines = BaselineConfig();
+    config.profiles = ProfileConfig();
+    config.payload_bytes = 0;
+    config.tls_fingerprints = false;
+    config.tcp_health = false;
+    config.export_dns = false;
+    config.dns_clients = 65536;
 }
 
-bool AIEventExporterModule::set(const char*, Value& v, SnortConfig*)
+static const char* SINKS_FQN = "ai_event_exporter.sinks";
+
+static bool in_sinks(const char* fqn)
 {
-    if ( v.is("endpoint") )
+    size_t n = strlen(SINKS_FQN);
+    return !strncmp(fqn, SINKS_FQN, n) && (fqn[n] == '.' || !fqn[n]);
+}
+
+bool AIEventExporterModule::set(const char* fqn, Value& v, SnortConfig*)
+{
+    if ( in_sinks(fqn) )
+    {
+        if ( v.is("endpoint") )
+            sink.endpoint = v.get_string();
+        else if ( v.is("backpressure") )
+            sink.backpressure = (SinkBackpressure)v.get_uint8();
+        else if ( v.is("types") )
+            return parse_route_types(v.get_string(), sink.filter.types);
+        else if ( v.is("max_priority") )
+            sink.filter.max_priority = v.get_uint8();
+        else if ( v.is("protocols") )
+            return parse_route_protocols(v.get_string(), sink.filter.protocols);
+        else if ( v.is("sids") )
+            return parse_route_sids(v.get_string(), sink.filter.sids);
+        else if ( v.is("nets") )
+            return parse_route_nets(v.get_string(), sink.filter.nets);
+    }
+    else if ( v.is("endpoint") )
         config.endpoint = v.get_string();
+    else if ( v.is("backpressure") )
+        config.backpressure = (SinkBackpressure)v.get_uint8();
+    else if ( v.is("export_filter") )
+    {
+        ExportFilter f;
+        string error;
+
+        if ( !f.compile(v.get_string(), error) )
+        {
+            ParseError("ai_event_exporter.export_filter: %s", error.c_str());
+            return false;
+        }
+        config.export_filter = v.get_string();
+    }
+    else if ( v.is("include_nets") || v.is("exclude_nets") )
+    {
+        vector<pair<RouteAddr, RouteAddr>> nets;
+
+        if ( !parse_route_nets(v.get_string(), nets) )
+            return false;
+
+        (v.is("include_nets") ? config.nets.include_nets : config.nets.exclude_nets) =
+            v.get_string();
+    }
+    else if ( v.is("include_nets_file") )
+        config.nets.include_nets_file = v.get_string();
+    else if ( v.is("exclude_nets_file") )
+        config.nets.exclude_nets_file = v.get_string();
     else if ( v.is("export_alerts") )
         config.export_alerts = v.get_bool();
     else if ( v.is("export_flows") )
@@ -85,59 +358,417 @@ bool AIEventExporterModule::set(const char*, Value& v, SnortConfig*)
         config.buffer_size = v.get_size();
     else if ( v.is("flush_interval") )
         config.flush_interval = v.get_uint32();
+    else if ( v.is("encoding") )
+        config.encoding = (EventEncoding)v.get_uint8();
+    else if ( v.is("numa_senders") )
+        config.numa_senders = v.get_bool();
+    else if ( v.is("sender_cpus") )
+    {
+        vector<unsigned> cpus;
+
+        if ( !parse_cpu_list(v.get_string(), cpus) )
+            return false;
+
+        config.sender_cpus = v.get_string();
+    }
+    else if ( v.is("sender_threads") )
+        config.sender_threads = v.get_uint32();
+    else if ( v.is("sharding") )
+        config.sharding = (SenderSharding)v.get_uint8();
+    else if ( v.is("latency_mode") )
+        config.latency_mode = (LatencyMode)v.get_uint8();
+    else if ( v.is("file_rotate_size") )
+        config.file_rotate_size = v.get_uint32();
+    else if ( v.is("file_rotate_interval") )
+        config.file_rotate_interval = v.get_uint32();
+    else if ( v.is("file_direct_io") )
+        config.file_direct_io = v.get_bool();
+    else if ( v.is("unix_socket_type") )
+        config.unix_socket_type = (UnixSocketType)v.get_uint8();
+    else if ( v.is("zmq_socket_type") )
+        config.zmq_socket_type = (ZmqSocketType)v.get_uint8();
+    else if ( v.is("flow_control") )
+        config.flow_control = (FlowControl)v.get_uint8();
+    else if ( v.is("sequence_events") )
+        config.sequence_events = v.get_bool();
+    else if ( v.is("alert_ack_window") )
+        config.alert_ack_window = v.get_uint32();
+    else if ( v.is("shutdown_drain") )
+        config.shutdown_drain = v.get_uint32();
+    else if ( v.is("spool_dir") )
+        config.spool_dir = v.get_string();
+    else if ( v.is("heartbeat_interval") )
+        config.heartbeat_interval = v.get_uint32();
+    else if ( v.is("storm_rate") )
+        config.storm.rate = v.get_uint32();
+    else if ( v.is("storm_zscore") )
+        config.storm.zscore = v.get_real();
+    else if ( v.is("storm_min_rate") )
+        config.storm.min_rate = v.get_uint32();
+    else if ( v.is("storm_recovery") )
+        config.storm.recovery = v.get_uint32();
+    else if ( v.is("rate_limit") )
+        config.rate_limit.events = v.get_uint32();
+    else if ( v.is("rate_limit_bytes") )
+        config.rate_limit.bytes = v.get_uint32();
+    else if ( v.is("beacon_pairs") )
+        config.beacons.pairs = v.get_uint32();
+    else if ( v.is("beacon_periodicity") )
+        config.beacons.periodicity = v.get_real();
+    else if ( v.is("beacon_jitter") )
+        config.beacons.jitter = v.get_real();
+    else if ( v.is("beacon_min_connections") )
+        config.beacons.min_connections = v.get_uint32();
+    else if ( v.is("beacon_min_interval") )
+        config.beacons.min_interval = v.get_uint32();
+    else if ( v.is("graph_interval") )
+        config.graph_interval = v.get_uint32();
+    else if ( v.is("graph_edges") )
+        config.graph_edges = v.get_uint32();
+    else if ( v.is("baseline_interval") )
+        config.baselines.interval = v.get_uint32();
+    else if ( v.is("baseline_halflife") )
+        config.baselines.halflife = v.get_uint32();
+    else if ( v.is("baseline_hosts") )
+        config.baselines.hosts = v.get_uint32();
+    else if ( v.is("baseline_nets") )
+    {
+        vector<pair<RouteAddr, RouteAddr>> nets;
+
+        if ( !parse_route_nets(v.get_string(), nets) )
+            return false;
+
+        config.baselines.nets = v.get_string();
+    }
+    else if ( v.is("profile_hosts") )
+        config.profiles.hosts = v.get_uint32();
+    else if ( v.is("profile_nets") )
+    {
+        vector<pair<RouteAddr, RouteAddr>> nets;
+
+        if ( !parse_route_nets(v.get_string(), nets) )
+            return false;
+
+        config.profiles.nets = v.get_string();
+    }
+    else if ( v.is("profile_zscore") )
+        config.profiles.zscore = v.get_real();
+    else if ( v.is("profile_min_flows") )
+        config.profiles.min_flows = v.get_uint32();
+    else if ( v.is("payload_bytes") )
+        config.payload_bytes = v.get_uint32();
+    else if ( v.is("tls_fingerprints") )
+        config.tls_fingerprints = v.get_bool();
+    else if ( v.is("tcp_health") )
+        config.tcp_health = v.get_bool();
+    else if ( v.is("export_dns") )
+        config.export_dns = v.get_bool();
+    else if ( v.is("dns_clients") )
+        config.dns_clients = v.get_uint32();
+    else if ( v.is("rate_limit_shares") )
+    {
+        if ( !parse_rate_shares(v.get_string(), config.rate_limit.shares) )
+        {
+            ParseError("ai_event_exporter.rate_limit_shares: expected type:percent, "
+                "at most 100 in all");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool AIEventExporterModule::begin(const char* fqn, int idx, SnortConfig*)
+{
+    if ( !strcmp(fqn, get_name()) )
+        config.nets = NetListConfig();
 
+    else if ( !idx && !strcmp(fqn, SINKS_FQN) )
+        config.sinks.clear();
+
+    else if ( idx && !strcmp(fqn, SINKS_FQN) )
+    {
+        sink.endpoint.clear();
+        sink.backpressure = BACKPRESSURE_BLOCK;
+        sink.filter = RouteFilter();
+    }
     return true;
 }
 
-bool AIEventExporterModule::begin(const char*, int, SnortConfig*)
+bool AIEventExporterModule::end(const char* fqn, int idx, SnortConfig*)
 {
+    if ( idx && !strcmp(fqn, SINKS_FQN) )
+    {
+        if ( sink.endpoint.empty() )
+        {
+            ParseError("ai_event_exporter: each sink needs an endpoint");
+            return false;
+        }
+        if ( config.sinks.size() + 1 >= EventRouter::MAX_SINKS )
+        {
+            ParseError("ai_event_exporter: at most %u sinks", EventRouter::MAX_SINKS - 1);
+            return false;
+        }
+        config.sinks.emplace_back(sink);
+    }
+    else if ( !strcmp(fqn, get_name()) )
+        return load_nets();
+
     return true;
 }
 
-bool AIEventExporterModule::end(const char*, int, SnortConfig*)
+bool AIEventExporterModule::load_nets()
 {
+    string error;
+    auto lists = NetLists::load(config.nets, error);
+
+    if ( !lists )
+    {
+        ParseError("ai_event_exporter: %s", error.c_str());
+        return false;
+    }
+    nets.swap(lists);
     return true;
 }
 
+static int reload_nets(lua_State*)
+{
+    auto mod = (AIEventExporterModule*)ModuleManager::get_module("ai_event_exporter");
+
+    // a bad file leaves the current lists in place
+    if ( mod && mod->load_nets() )
+        LogMessage("ai_event_exporter: prefix lists reloaded\n");
+
+    return 0;
+}
+
+static int dump_profiles(lua_State*)
+{
+    // the first sender thread sends them to the sinks that take profiles
+    HostProfiles::request_snapshot();
+    LogMessage("ai_event_exporter: profile snapshot requested\n");
+
+    return 0;
+}
+
+static const Command ai_event_cmds[] =
+{
+    { "reload_nets", reload_nets, nullptr,
+      "re-read include_nets_file and exclude_nets_file and swap in the new lists" },
+
+    { "dump_profiles", dump_profiles, nullptr,
+      "send a snapshot of all host behaviour profiles" },
+
+    { nullptr, nullptr, nullptr, nullptr }
+};
+
+const Command* AIEventExporterModule::get_commands() const
+{
+    return ai_event_cmds;
+}
+
+enum AIEventPeg
+{
+    PEG_ALERTS_ACKED,
+    PEG_ALERTS_RETRANSMITTED,
+    PEG_ALERT_STORMS,
+    PEG_ALERTS_SUPPRESSED,
+    PEG_ALERTS_THROTTLED,
+    PEG_FLOWS_THROTTLED,
+    PEG_FLOW_ENDS_THROTTLED,
+    PEG_BEACONS_THROTTLED,
+    PEG_PROFILES_THROTTLED,
+    PEG_DNS_THROTTLED,
+    PEG_TOKENS_BORROWED,
+    PEG_BEACON_CANDIDATES,
+    PEG_BEACON_PAIRS_EVICTED,
+    PEG_GRAPH_SNAPSHOTS,
+    PEG_GRAPH_EDGES,
+    PEG_GRAPH_EDGES_LOST,
+    PEG_BASELINE_UPDATES,
+    PEG_BASELINE_SAMPLES_LOST,
+    PEG_BASELINE_HOSTS_SKIPPED,
+    PEG_PROFILE_DEVIATIONS,
+    PEG_PROFILES_EVICTED,
+    PEG_PROFILE_SNAPSHOTS,
+    PEG_DNS_QUERIES,
+    PEG_DNS_CLIENTS_EVICTED,
+    PEG_TLS_CLIENT_HELLOS,
+    PEG_TLS_SERVER_HELLOS,
+    PEG_MAX
+};
+
+static const PegInfo ai_event_pegs[] =
+{
+    { CountType::NOW, "alerts_acked", "alerts the consumer acknowledged" },
+    { CountType::NOW, "alerts_retransmitted", "alerts sent again because no ack came in time" },
+    { CountType::NOW, "alert_storms", "times a sid tripped the storm breaker" },
+    { CountType::NOW, "alerts_suppressed", "alerts folded into storm summaries" },
+    { CountType::NOW, "alerts_throttled", "alerts and storm records held back by the rate limit" },
+    { CountType::NOW, "flows_throttled", "flow events held back by the rate limit" },
+    { CountType::NOW, "flow_ends_throttled", "flow end events held back by the rate limit" },
+    { CountType::NOW, "beacons_throttled", "beacon events held back by the rate limit" },
+    { CountType::NOW, "profiles_throttled", "profile deviations held back by the rate limit" },
+    { CountType::NOW, "dns_throttled", "dns events held back by the rate limit" },
+    { CountType::NOW, "tokens_borrowed", "times an event type took rate limit tokens from a lower one" },
+    { CountType::NOW, "beacon_candidates", "periodic connection pairs reported" },
+    { CountType::NOW, "beacon_pairs_evicted", "tracked pairs dropped to make room for new ones" },
+    { CountType::NOW, "graph_snapshots", "communication graph snapshots taken" },
+    { CountType::NOW, "graph_edges", "edges in all graph snapshots" },
+    { CountType::NOW, "graph_edges_lost", "edges that did not fit a packet thread's table" },
+    { CountType::NOW, "baseline_updates", "flow baseline updates" },
+    { CountType::NOW, "baseline_samples_lost", "ended flows left out of the baselines for want of buffer" },
+    { CountType::NOW, "baseline_hosts_skipped", "flow samples of internal hosts beyond baseline_hosts" },
+    { CountType::NOW, "profile_deviations", "flows that made a host deviate from its profile" },
+    { CountType::NOW, "profiles_evicted", "host profiles dropped to make room for new ones" },
+    { CountType::NOW, "profile_snapshots", "host profile snapshots sent" },
+    { CountType::NOW, "dns_queries", "answered DNS queries whose names were scored" },
+    { CountType::NOW, "dns_clients_evicted", "query rate clients dropped to make room for new ones" },
+    { CountType::NOW, "tls_client_hellos", "TLS client hellos fingerprinted" },
+    { CountType::NOW, "tls_server_hellos", "TLS server hellos fingerprinted" },
+    { CountType::END, nullptr, nullptr }
+};
+
+static PegCount ai_event_counts[PEG_MAX];
+
+const PegInfo* AIEventExporterModule::get_pegs() const
+{
+    return ai_event_pegs;
+}
+
+PegCount* AIEventExporterModule::get_counts() const
+{
+    return ai_event_counts;
+}
+
+void AIEventExporterModule::prep_counts(bool)
+{
+    ai_event_counts[PEG_ALERTS_ACKED] = sink_pegs.alerts_acked.load(memory_order_relaxed);
+    ai_event_counts[PEG_ALERTS_RETRANSMITTED] =
+        sink_pegs.alerts_retransmitted.load(memory_order_relaxed);
+    ai_event_counts[PEG_ALERT_STORMS] = storm_pegs.storms.load(memory_order_relaxed);
+    ai_event_counts[PEG_ALERTS_SUPPRESSED] = storm_pegs.alerts_suppressed.load(memory_order_relaxed);
+    ai_event_counts[PEG_ALERTS_THROTTLED] =
+        rate_pegs.throttled[EVENT_ALERT].load(memory_order_relaxed);
+    ai_event_counts[PEG_FLOWS_THROTTLED] = rate_pegs.throttled[EVENT_FLOW].load(memory_order_relaxed);
+    ai_event_counts[PEG_FLOW_ENDS_THROTTLED] =
+        rate_pegs.throttled[EVENT_FLOW_END].load(memory_order_relaxed);
+    ai_event_counts[PEG_BEACONS_THROTTLED] =
+        rate_pegs.throttled[EVENT_BEACON].load(memory_order_relaxed);
+    ai_event_counts[PEG_PROFILES_THROTTLED] =
+        rate_pegs.throttled[EVENT_PROFILE].load(memory_order_relaxed);
+    ai_event_counts[PEG_DNS_THROTTLED] = rate_pegs.throttled[EVENT_DNS].load(memory_order_relaxed);
+    ai_event_counts[PEG_TOKENS_BORROWED] = rate_pegs.borrowed.load(memory_order_relaxed);
+    ai_event_counts[PEG_BEACON_CANDIDATES] = beacon_pegs.candidates.load(memory_order_relaxed);
+    ai_event_counts[PEG_BEACON_PAIRS_EVICTED] = beacon_pegs.evicted.load(memory_order_relaxed);
+    ai_event_counts[PEG_GRAPH_SNAPSHOTS] = graph_pegs.snapshots.load(memory_order_relaxed);
+    ai_event_counts[PEG_GRAPH_EDGES] = graph_pegs.edges.load(memory_order_relaxed);
+    ai_event_counts[PEG_GRAPH_EDGES_LOST] = graph_pegs.edges_lost.load(memory_order_relaxed);
+    ai_event_counts[PEG_BASELINE_UPDATES] = baseline_pegs.updates.load(memory_order_relaxed);
+    ai_event_counts[PEG_BASELINE_SAMPLES_LOST] =
+        baseline_pegs.samples_lost.load(memory_order_relaxed);
+    ai_event_counts[PEG_BASELINE_HOSTS_SKIPPED] =
+        baseline_pegs.hosts_skipped.load(memory_order_relaxed);
+    ai_event_counts[PEG_PROFILE_DEVIATIONS] = profile_pegs.deviations.load(memory_order_relaxed);
+    ai_event_counts[PEG_PROFILES_EVICTED] = profile_pegs.evicted.load(memory_order_relaxed);
+    ai_event_counts[PEG_PROFILE_SNAPSHOTS] = profile_pegs.snapshots.load(memory_order_relaxed);
+    ai_event_counts[PEG_DNS_QUERIES] = dns_pegs.queries.load(memory_order_relaxed);
+    ai_event_counts[PEG_DNS_CLIENTS_EVICTED] = dns_pegs.clients_evicted.load(memory_order_relaxed);
+    ai_event_counts[PEG_TLS_CLIENT_HELLOS] = tls_pegs.client_hellos.load(memory_order_relaxed);
+    ai_event_counts[PEG_TLS_SERVER_HELLOS] = tls_pegs.server_hellos.load(memory_order_relaxed);
+}
+
 //-------------------------------------------------------------------------
 // Inspector Implementation
 //-------------------------------------------------------------------------
 
-AIEventExporter::AIEventExporter(AIEventExporterConfig* c)
-    : config(c), zmq_context(nullptr), zmq_socket(nullptr),
-      events_sent(0), events_dropped(0)
+static THREAD_LOCAL AIEventExporter* thread_exporter = nullptr;
+
+// alert rates are kept per packet thread, so the breaker needs no locking
+static THREAD_LOCAL StormBreaker* thread_breaker = nullptr;
+
+static string encode_event(const json& j, EventEncoding encoding)
+{
+    if (encoding == ENCODING_MSGPACK)
+    {
+        vector<uint8_t> packed = json::to_msgpack(j);
+        return string(packed.begin(), packed.end());
+    }
+    return j.dump();
+}
+
+class DnsResponseHandler : public DataHandler
+{
+public:
+    DnsResponseHandler(AIEventExporter& e) : DataHandler("ai_event_exporter"), exporter(e)
+    { }
+
+    void handle(DataEvent& e, Flow* f) override
+    { exporter.export_dns((DnsResponseEvent&)e, f); }
+
+private:
+    AIEventExporter& exporter;
+};
+
+AIEventExporter::AIEventExporter(AIEventExporterConfig* c, NetListsHandle* n)
+    : config(c), sender(nullptr), nets(n), beacons(nullptr), dns_rates(nullptr),
+      events_dropped(0)
 {
 }
 
 AIEventExporter::~AIEventExporter()
 {
-    if (zmq_socket)
-    {
-        zmq_socket->close();
-        delete zmq_socket;
-    }
-    if (zmq_context)
-    {
-        zmq_context->close();
-        delete zmq_context;
-    }
+    // stops the sender threads after they drain what the packet threads left
+    delete sender;
+    delete beacons;
+    delete dns_rates;
 }
 
 bool AIEventExporter::configure(SnortConfig*)
 {
     try
     {
-        zmq_context = new zmq::context_t(1);
-        zmq_socket = new zmq::socket_t(*zmq_context, ZMQ_PUSH);
-        
-        // Set socket options
-        int hwm = config->buffer_size;
-        zmq_socket->set(zmq::sockopt::sndbuf, hwm);
-        zmq_socket->set(zmq::sockopt::linger, 1000);
-        
-        LogMessage("AI Event Exporter: Connecting to %s\n", config->endpoint.c_str());
-        zmq_socket->connect(config->endpoint);
-        
+        sender = new EventSender(*config, ThreadConfig::get_instance_max());
+        sender->connect();
+        router.compile(sender->get_sinks());
+
+        if (sender->get_graph())
+        {
+            // snapshots have no priority, protocol or addresses; sinks that
+            // filter on those do not get them
+            RouteKey k = { EVENT_GRAPH, 0, 0, 0, { 0, 0 }, { 0, 0 } };
+            sender->set_routes(EVENT_GRAPH, router.route(k));
+        }
+
+        if (sender->get_baselines())
+        {
+            RouteKey k = { EVENT_BASELINE, 0, 0, 0, { 0, 0 }, { 0, 0 } };
+            sender->set_routes(EVENT_BASELINE, router.route(k));
+        }
+
+        if (sender->get_profiles())
+        {
+            RouteKey k = { EVENT_PROFILE, 0, 0, 0, { 0, 0 }, { 0, 0 } };
+            sender->set_routes(EVENT_PROFILE, router.route(k));
+        }
+
+        string error;
+
+        if (!filter.compile(config->export_filter, error))
+            throw runtime_error("export_filter: " + error);
+
+        if (config->beacons.enabled())
+            beacons = new BeaconTracker(config->beacons);
+
+        if (config->export_dns)
+        {
+            dns_rates = new DnsClientRates(config->dns_clients);
+
+            // the bus owns the handler
+            DataBus::subscribe_network(dns_pub_key, DnsEventIds::DNS_RESPONSE_DATA,
+                new DnsResponseHandler(*this));
+        }
+
         LogMessage("AI Event Exporter configured successfully\n");
         return true;
     }
@@ -148,54 +779,382 @@ bool AIEventExporter::configure(SnortConfig*)
     }
 }
 
-void AIEventExporter::tinit()
+void AIEventExporter::tinit()
+{
+    // the ring is allocated here so it lives on this packet thread's node
+    sender->attach(get_instance_id());
+    thread_exporter = this;
+
+    if (config->storm.enabled())
+        thread_breaker = new StormBreaker(config->storm);
+}
+
+void AIEventExporter::tterm()
+{
+    if (thread_exporter == this)
+        thread_exporter = nullptr;
+
+    if (thread_breaker)
+    {
+        // consumers see every storm end, even one cut short
+        vector<StormReport> reports;
+        thread_breaker->finish(reports);
+        export_storms(reports);
+
+        delete thread_breaker;
+        thread_breaker = nullptr;
+    }
+
+    // the sender keeps draining the closed ring until it is empty
+    sender->detach(get_instance_id());
+}
+
+AIEventExporter* AIEventExporter::get_thread_exporter()
+{
+    return thread_exporter;
+}
+
+static bool uses_scheme(const AIEventExporterConfig& config, const char* scheme)
+{
+    size_t n = strlen(scheme);
+
+    if (!config.endpoint.compare(0, n, scheme))
+        return true;
+
+    for (auto& sink : config.sinks)
+        if (!sink.endpoint.compare(0, n, scheme))
+            return true;
+
+    return false;
+}
+
+static const char* backpressure_name(SinkBackpressure bp)
+{
+    return bp == BACKPRESSURE_DROP ? "drop" : "block";
+}
+
+void AIEventExporter::show(const SnortConfig*) const
+{
+    LogMessage("AI Event Exporter Configuration:\n");
+    LogMessage("  Endpoint: %s (%s)\n", config->endpoint.empty() ? "none" : config->endpoint.c_str(),
+        backpressure_name(config->backpressure));
+
+    for (auto& sink : config->sinks)
+        LogMessage("  Sink: %s (%s%s)\n", sink.endpoint.c_str(), backpressure_name(sink.backpressure),
+            sink.filter.empty() ? "" : ", filtered");
+
+    if (!filter.empty())
+        LogMessage("  Export Filter: %s (%zu tests)\n", config->export_filter.c_str(),
+            filter.size());
+
+    if (const NetLists* lists = nets->get())
+    {
+        if (lists->get_include_size())
+            LogMessage("  Include Nets: %zu prefixes\n", lists->get_include_size());
+        if (lists->get_exclude_size())
+            LogMessage("  Exclude Nets: %zu prefixes\n", lists->get_exclude_size());
+    }
+
+    LogMessage("  Rule Alerts: %s\n", ai_alert_logger_active() ? "alert_ai_ops" : "verdicts only");
+
+    LogMessage("  Export Alerts: %s\n", config->export_alerts ? "yes" : "no");
+    LogMessage("  Export Flows: %s\n", config->export_flows ? "yes" : "no");
+    LogMessage("  Export Stats: %s\n", config->export_stats ? "yes" : "no");
+    LogMessage("  Min Severity: %s\n", config->min_severity.c_str());
+    LogMessage("  Buffer Size: %zu\n", config->buffer_size);
+    LogMessage("  Encoding: %s\n", config->encoding == ENCODING_MSGPACK ? "msgpack" : "json");
+    LogMessage("  NUMA Senders: %s\n", config->numa_senders ? "yes" : "no");
+    LogMessage("  Sender CPUs: %s\n", config->sender_cpus.empty() ? "any" : config->sender_cpus.c_str());
+    LogMessage("  Sender Threads: %u per node\n", config->sender_threads);
+    LogMessage("  Sharding: %s\n", config->sharding == SHARD_BY_FLOW ? "flow" : "node");
+    LogMessage("  Latency Mode: %s\n",
+        config->latency_mode == LATENCY_BUSY_POLL ? "busy_poll" : "batch");
+
+    if (uses_scheme(*config, "file://"))
+    {
+        LogMessage("  File Rotate Size: %u MiB\n", config->file_rotate_size);
+        LogMessage("  File Rotate Interval: %u s\n", config->file_rotate_interval);
+        LogMessage("  File Direct IO: %s\n", config->file_direct_io ? "yes" : "no");
+    }
+    if (uses_scheme(*config, "unix://"))
+        LogMessage("  Unix Socket Type: %s\n",
+            config->unix_socket_type == UNIX_DGRAM ? "dgram" : "seqpacket");
+
+    LogMessage("  ZeroMQ Socket Type: %s\n",
+        config->zmq_socket_type == ZMQ_SOCKET_PUB ? "pub" : "push");
+    LogMessage("  Flow Control: %s\n",
+        config->flow_control == FLOW_CONTROL_CREDIT ? "credit" : "none");
+    LogMessage("  Sequence Events: %s\n",
+        config->sequence_events || config->alert_ack_window ? "yes" : "no");
+
+    if (config->alert_ack_window)
+        LogMessage("  Alert Ack Window: %u\n", config->alert_ack_window);
+
+    LogMessage("  Shutdown Drain: %u ms\n", config->shutdown_drain);
+    LogMessage("  Spool Dir: %s\n", config->spool_dir.empty() ? "none" : config->spool_dir.c_str());
+
+    if (config->heartbeat_interval)
+        LogMessage("  Heartbeat Interval: %u ms\n", config->heartbeat_interval);
+
+    if (config->storm.enabled())
+    {
+        LogMessage("  Storm Rate: %u/s\n", config->storm.rate);
+        LogMessage("  Storm Z-Score: %.1f (above %u/s)\n", config->storm.zscore,
+            config->storm.min_rate);
+        LogMessage("  Storm Recovery: %u s\n", config->storm.recovery);
+    }
+
+    if (config->rate_limit.enabled())
+    {
+        const uint8_t* shares = config->rate_limit.shares;
+
+        LogMessage("  Rate Limit: %u events/s, %u bytes/s (0 = none)\n",
+            config->rate_limit.events, config->rate_limit.bytes);
+        LogMessage("  Rate Limit Shares: alert %u%%, beacon %u%%, flow_end %u%%, flow %u%%, "
+            "profile %u%%, dns %u%%\n", shares[EVENT_ALERT], shares[EVENT_BEACON],
+            shares[EVENT_FLOW_END], shares[EVENT_FLOW], shares[EVENT_PROFILE], shares[EVENT_DNS]);
+    }
+
+    if (config->graph_interval)
+        LogMessage("  Graph Interval: %u s, %u edges per thread\n", config->graph_interval,
+            config->graph_edges);
+
+    if (config->baselines.enabled())
+    {
+        LogMessage("  Baseline Interval: %u s, half-life %u s\n", config->baselines.interval,
+            config->baselines.halflife);
+        LogMessage("  Baseline Hosts: %u in %s\n", config->baselines.hosts,
+            config->baselines.nets.empty() ? "none" : config->baselines.nets.c_str());
+    }
+
+    if (config->payload_bytes)
+        LogMessage("  Payload Bytes: %u per direction (%s)\n", config->payload_bytes,
+            payload_features_simd() ? "avx2" : "scalar");
+
+    if (config->tls_fingerprints)
+        LogMessage("  TLS Fingerprints: ja3, ja4\n");
+
+    if (config->tcp_health)
+        LogMessage("  TCP Health: yes\n");
+
+    if (config->export_dns)
+        LogMessage("  Export DNS: yes, rates of %u clients\n", config->dns_clients);
+
+    if (config->profiles.enabled())
+    {
+        LogMessage("  Profile Hosts: %u in %s\n", config->profiles.hosts,
+            config->profiles.nets.empty() ? "none" : config->profiles.nets.c_str());
+        LogMessage("  Profile Z-Score: %.1f (after %u flows)\n", config->profiles.zscore,
+            config->profiles.min_flows);
+    }
+
+    if (config->beacons.enabled())
+    {
+        LogMessage("  Beacon Pairs: %u\n", config->beacons.pairs);
+        LogMessage("  Beacon Periodicity: %.2f, jitter %.2f\n", config->beacons.periodicity,
+            config->beacons.jitter);
+        LogMessage("  Beacon Min Connections: %u, %u ms apart\n",
+            config->beacons.min_connections, config->beacons.min_interval);
+    }
+
+    uint64_t sent = sender ? sender->get_sent() : 0;
+    uint64_t dropped = events_dropped + (sender ? sender->get_dropped() : 0);
+
+    LogMessage("  Events Sent: %lu\n", sent);
+    LogMessage("  Events Dropped: %lu\n", dropped);
+    LogMessage("  Events Stolen: %lu\n", sender ? sender->get_stolen() : 0);
+
+    if (!sender)
+        return;
+
+    for (unsigned i = 0; i < sender->get_sinks().size(); ++i)
+    {
+        uint64_t sink_sent, sink_dropped, sink_held;
+        sender->get_sink_stats(i, sink_sent, sink_dropped, sink_held);
+
+        LogMessage("  %s: sent %lu, dropped %lu, held %lu\n",
+            sender->get_sinks()[i].endpoint.c_str(), sink_sent, sink_dropped, sink_held);
+    }
+}
+
+void AIEventExporter::eval(Packet* p)
+{
+    if (!p)
+        return;
+
+    // summaries and recoveries go out on packet time, alerts or not
+    if (thread_breaker && p->pkth)
+    {
+        vector<StormReport> reports;
+        thread_breaker->tick(p->pkth->ts.tv_sec, reports);
+        export_storms(reports);
+    }
+
+    if (!exported(p))
+        return;
+
+    if (p->flow)
+    {
+        AIFlowData* fd = get_flow_data(p->flow);
+        fd->update(p->flow);
+
+        // segments as they came, not the reassembled copies of them
+        if (config->payload_bytes && p->dsize && !p->is_rebuilt())
+            fd->add_payload(p->data, p->dsize, p->is_from_client(), config->payload_bytes);
+
+        // a hello split over segments is whole in the reassembled copy
+        if (config->tls_fingerprints && p->dsize && p->type() == PktType::TCP)
+            fd->add_hello(p->data, p->dsize, p->is_from_client());
+
+        if (config->tcp_health && p->ptrs.tcph && !p->is_rebuilt() && p->pkth)
+        {
+            const tcp::TCPHdr* th = p->ptrs.tcph;
+            uint64_t us = (uint64_t)p->pkth->ts.tv_sec * 1000000 + p->pkth->ts.tv_usec;
+            fd->tcp.add(th->th_flags, th->seq(), th->win(), p->dsize, p->is_from_client(), us);
+        }
+    }
+
+    // Export alerts - check if packet has alerts/events (any action beyond ALLOW);
+    // with alert_ai_ops configured, rule alerts come from the logger instead
+    if (config->export_alerts && !ai_alert_logger_active() &&
+        p->active && p->active->get_action() > Active::ACT_ALLOW)
+    {
+        export_alert(p);
+    }
+
+    // Export flows
+    if (config->export_flows && p->flow && p->flow->flow_state == Flow::FlowState::INSPECT)
+    {
+        export_flow(p);
+    }
+}
+
+AIFlowData* AIEventExporter::get_flow_data(Flow* f)
+{
+    AIFlowData* fd = AIFlowData::get(f);
+
+    if (!fd)
+    {
+        fd = new AIFlowData(this, f);
+        f->set_flow_data(fd);
+
+        if (beacons)
+            track_connection(*fd);
+    }
+    return fd;
+}
+
+static const RouteAddr no_addr = { 0, 0 };
+
+static RouteAddr route_addr(const SfIp* ip)
+{
+    return ip ? RouteAddr::from_bytes(ip->get_ip6_ptr()) : no_addr;
+}
+
+bool AIEventExporter::exported(const Packet* p) const
 {
-    // Thread initialization if needed
+    // checked before any flow data or encoding work is done
+    const NetLists* lists = nets->get();
+
+    if (filter.empty() && (!lists || lists->empty()))
+        return true;
+
+    FilterKey k;
+
+    k.protocol = p->has_ip() ? to_utype(p->get_ip_proto_next()) : 0;
+    k.src = p->has_ip() ? route_addr(p->ptrs.ip_api.get_src()) : no_addr;
+    k.dst = p->has_ip() ? route_addr(p->ptrs.ip_api.get_dst()) : no_addr;
+    k.src_port = p->ptrs.sp;
+    k.dst_port = p->ptrs.dp;
+
+    if (lists && !lists->allow(k.src, k.dst))
+        return false;
+
+    return filter.match(k);
 }
 
-void AIEventExporter::tterm()
+uint64_t AIEventExporter::route_packet(EventType type, Packet* p, const RuleAlert* ra,
+    uint32_t& topic) const
 {
-    flush_buffer();
+    RouteKey k;
+
+    k.type = type;
+    k.priority = ra ? (uint8_t)min(ra->priority, 255u) : 0;
+    k.protocol = p->has_ip() ? to_utype(p->get_ip_proto_next()) : 0;
+    k.sid = ra ? ra->sid : 0;
+    k.src = p->has_ip() ? route_addr(p->ptrs.ip_api.get_src()) : no_addr;
+    k.dst = p->has_ip() ? route_addr(p->ptrs.ip_api.get_dst()) : no_addr;
+
+    // PUB sinks without a subscriber for the topic do not want it
+    topic = make_topic(type, k.priority, k.protocol);
+    return router.route(k) & sender->get_topics().wanted(topic);
 }
 
-void AIEventExporter::show(const SnortConfig*) const
+uint64_t AIEventExporter::route_flow(EventType type, const SfIp& client, const SfIp& server,
+    uint8_t protocol, uint32_t& topic) const
 {
-    LogMessage("AI Event Exporter Configuration:\n");
-    LogMessage("  Endpoint: %s\n", config->endpoint.c_str());
-    LogMessage("  Export Alerts: %s\n", config->export_alerts ? "yes" : "no");
-    LogMessage("  Export Flows: %s\n", config->export_flows ? "yes" : "no");
-    LogMessage("  Export Stats: %s\n", config->export_stats ? "yes" : "no");
-    LogMessage("  Min Severity: %s\n", config->min_severity.c_str());
-    LogMessage("  Buffer Size: %zu\n", config->buffer_size);
-    LogMessage("  Events Sent: %lu\n", events_sent);
-    LogMessage("  Events Dropped: %lu\n", events_dropped);
+    RouteKey k;
+
+    k.type = type;
+    k.priority = 0;
+    k.protocol = protocol;
+    k.sid = 0;
+    k.src = route_addr(&client);
+    k.dst = route_addr(&server);
+
+    topic = make_topic(type, 0, protocol);
+    return router.route(k) & sender->get_topics().wanted(topic);
 }
 
-void AIEventExporter::eval(Packet* p)
+// rule messages are kept with their quotes
+static string rule_msg(const char* s)
 {
-    if (!p)
-        return;
+    string msg = s ? s : "";
+
+    if (msg.size() >= 2 && msg.front() == '"' && msg.back() == '"')
+        msg = msg.substr(1, msg.size() - 2);
 
-    // Export alerts - check if packet has alerts/events (any action beyond ALLOW)
-    if (config->export_alerts && p->active && p->active->get_action() > Active::ACT_ALLOW)
+    return msg;
+}
+
+static void tls_json(json& j, const TlsFingerprints& t)
+{
+    if (t.ja3[0])
     {
-        export_alert(p);
+        j["tls"]["ja3"] = t.ja3;
+        j["tls"]["ja4"] = t.ja4;
     }
 
-    // Export flows
-    if (config->export_flows && p->flow && p->flow->flow_state == Flow::FlowState::INSPECT)
+    if (t.ja3s[0])
     {
-        export_flow(p);
+        j["tls"]["ja3s"] = t.ja3s;
+        j["tls"]["ja4s"] = t.ja4s;
     }
 }
 
-string AIEventExporter::serialize_packet(Packet* p)
+string AIEventExporter::serialize_packet(Packet* p, const RuleAlert* ra)
 {
     json j;
     
     j["type"] = "alert";
     j["timestamp"] = chrono::duration_cast<chrono::milliseconds>(
         chrono::system_clock::now().time_since_epoch()).count();
+
+    if (p->flow)
+    {
+        AIFlowData* fd = get_flow_data(p->flow);
+        j["flow_id"] = fd->flow_id;
+        tls_json(j, fd->tls);
+    }
+
+    if (ra)
+    {
+        j["gid"] = ra->gid;
+        j["sid"] = ra->sid;
+        j["rev"] = ra->rev;
+        j["priority"] = ra->priority;
+        j["msg"] = rule_msg(ra->msg);
+    }
     
     // Packet info
     if (p->has_ip())
@@ -230,7 +1189,7 @@ string AIEventExporter::serialize_packet(Packet* p)
         j["verdict"] = p->active->get_status();
     }
     
-    return j.dump();
+    return encode_event(j, config->encoding);
 }
 
 string AIEventExporter::serialize_flow(Flow* f)
@@ -240,6 +1199,9 @@ string AIEventExporter::serialize_flow(Flow* f)
     j["type"] = "flow";
     j["timestamp"] = chrono::duration_cast<chrono::milliseconds>(
         chrono::system_clock::now().time_since_epoch()).count();
+    AIFlowData* fd = get_flow_data(f);
+    j["flow_id"] = fd->flow_id;
+    tls_json(j, fd->tls);
     
     // Flow info
     char src_ip[INET6_ADDRSTRLEN], dst_ip[INET6_ADDRSTRLEN];
@@ -262,15 +1224,249 @@ string AIEventExporter::serialize_flow(Flow* f)
     j["bytes_to_server"] = f->flowstats.client_bytes;
     j["bytes_to_client"] = f->flowstats.server_bytes;
     
-    return j.dump();
+    return encode_event(j, config->encoding);
+}
+
+// from the first packet to the last the exporter saw
+static uint64_t duration_ms(const AIFlowData& fd)
+{
+    int64_t us = (int64_t)(fd.last_seen.tv_sec - fd.start_time.tv_sec) * 1000000 +
+        (fd.last_seen.tv_usec - fd.start_time.tv_usec);
+
+    return us > 0 ? us / 1000 : 0;
+}
+
+static void ranks_json(json& j, const float ranks[METRIC_MAX])
+{
+    // two decimals are as much as a baseline can tell apart
+    for (unsigned m = 0; m < METRIC_MAX; ++m)
+        j[FlowBaselines::metric_names[m]] = round(ranks[m] * 100) / 100;
+}
+
+static void payload_json(json& j, const PayloadFeatures& f)
+{
+    j["bytes"] = f.bytes;
+    j["entropy"] = round(f.entropy * 1000) / 1000;
+    j["distinct"] = f.distinct;
+
+    // shares of the sampled bytes
+    j["printable"] = round(1000.0 * f.printable / f.bytes) / 1000;
+    j["zero"] = round(1000.0 * f.zero / f.bytes) / 1000;
+    j["high"] = round(1000.0 * f.high / f.bytes) / 1000;
+}
+
+// integers only, the same fields in every record
+static void tcp_json(json& j, const TcpHealth& h)
+{
+    j["server_rtt_us"] = h.server_rtt_us;
+    j["client_rtt_us"] = h.client_rtt_us;
+    j["retransmits_to_server"] = h.retransmits[0];
+    j["retransmits_to_client"] = h.retransmits[1];
+    j["out_of_order_to_server"] = h.out_of_order[0];
+    j["out_of_order_to_client"] = h.out_of_order[1];
+    j["zero_windows_to_server"] = h.zero_windows[0];
+    j["zero_windows_to_client"] = h.zero_windows[1];
+}
+
+string AIEventExporter::serialize_flow_end(const AIFlowData& fd, const FlowRanks* r)
+{
+    json j;
+
+    j["type"] = "flow_end";
+    j["timestamp"] = chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    j["flow_id"] = fd.flow_id;
+
+    char src_ip[INET6_ADDRSTRLEN], dst_ip[INET6_ADDRSTRLEN];
+    fd.client_ip.ntop(src_ip, sizeof(src_ip));
+    fd.server_ip.ntop(dst_ip, sizeof(dst_ip));
+
+    j["src_ip"] = src_ip;
+    j["dst_ip"] = dst_ip;
+    j["src_port"] = fd.client_port;
+    j["dst_port"] = fd.server_port;
+    j["ip_proto"] = fd.protocol;
+    j["start_time"] = (uint64_t)fd.start_time.tv_sec * 1000 + fd.start_time.tv_usec / 1000;
+
+    j["packets_to_server"] = fd.packets_to_server;
+    j["packets_to_client"] = fd.packets_to_client;
+    j["bytes_to_server"] = fd.bytes_to_server;
+    j["bytes_to_client"] = fd.bytes_to_client;
+    j["duration_ms"] = duration_ms(fd);
+
+    for (unsigned dir = 0; dir < 2; ++dir)
+        if (fd.payload[dir].bytes)
+            payload_json(j["payload"][dir ? "to_client" : "to_server"], fd.payload[dir]);
+
+    tls_json(j, fd.tls);
+
+    if (config->tcp_health && fd.protocol == to_utype(IpProtocol::TCP))
+        tcp_json(j["tcp"], fd.tcp.get());
+
+    // percentile ranks against the server port's and the internal host's
+    // baselines, where there are enough flows to have one
+    if (r && r->port)
+        ranks_json(j["baseline"]["port"], r->port_rank);
+
+    if (r && r->host)
+        ranks_json(j["baseline"]["host"], r->host_rank);
+
+    return encode_event(j, config->encoding);
+}
+
+static const char* storm_states[] = { "start", "active", "end" };
+
+string AIEventExporter::serialize_storm(const Storm& s, StormState state)
+{
+    json j;
+
+    j["type"] = "storm";
+    j["timestamp"] = chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    j["state"] = storm_states[state];
+
+    j["gid"] = s.gid;
+    j["sid"] = s.sid;
+    j["rev"] = s.rev;
+    j["priority"] = s.priority;
+    j["msg"] = s.msg;
+
+    j["started"] = (uint64_t)s.started * 1000;
+    j["rate"] = s.rate;
+    j["baseline"] = s.baseline;
+    j["deviation"] = s.deviation;
+    j["suppressed"] = s.suppressed;
+    j["suppressed_total"] = s.total;
+
+    return encode_event(j, config->encoding);
+}
+
+string AIEventExporter::serialize_beacon(const AIFlowData& fd, const BeaconCandidate& c)
+{
+    json j;
+
+    j["type"] = "beacon";
+    j["timestamp"] = chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    j["flow_id"] = fd.flow_id;
+
+    char src_ip[INET6_ADDRSTRLEN], dst_ip[INET6_ADDRSTRLEN];
+    fd.client_ip.ntop(src_ip, sizeof(src_ip));
+    fd.server_ip.ntop(dst_ip, sizeof(dst_ip));
+
+    j["src_ip"] = src_ip;
+    j["dst_ip"] = dst_ip;
+    j["dst_port"] = fd.server_port;
+    j["ip_proto"] = fd.protocol;
+
+    j["connections"] = c.connections;
+    j["interval_ms"] = c.interval;
+    j["periodicity"] = c.periodicity;
+    j["jitter"] = c.jitter;
+    j["first_seen"] = c.first_seen;
+    j["last_seen"] = c.last_seen;
+
+    return encode_event(j, config->encoding);
+}
+
+string AIEventExporter::serialize_deviation(const AIFlowData& fd, const ProfileDeviation& d)
+{
+    json j;
+
+    j["type"] = "profile";
+    j["kind"] = "deviation";
+    j["timestamp"] = chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    j["flow_id"] = fd.flow_id;
+    j["deviations"] = json::array();
+
+    for (unsigned m = 0; m < PROFILE_METRIC_MAX; ++m)
+    {
+        if (!(d.metrics & (1u << m)))
+            continue;
+
+        json dev = { { "metric", HostProfiles::metric_names[m] }, { "value", d.value[m] } };
+
+        // a new active hour has no baseline to score against
+        if (m != PROFILE_ACTIVE_HOUR)
+        {
+            dev["expected"] = round(d.expected[m] * 100) / 100;
+            dev["zscore"] = round(d.zscore[m] * 100) / 100;
+        }
+        j["deviations"].push_back(std::move(dev));
+    }
+
+    j["profile"] = HostProfiles::to_json(d.profile);
+
+    return encode_event(j, config->encoding);
+}
+
+string AIEventExporter::serialize_dns(const DnsResponseEvent& e, Flow* f, uint64_t flow_id,
+    const DnsQueryFeatures& q, const DnsAnswerSizes* a, float client_rate)
+{
+    json j;
+
+    j["type"] = "dns";
+    j["timestamp"] = chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    j["flow_id"] = flow_id;
+
+    char src_ip[INET6_ADDRSTRLEN], dst_ip[INET6_ADDRSTRLEN];
+    f->client_ip.ntop(src_ip, sizeof(src_ip));
+    f->server_ip.ntop(dst_ip, sizeof(dst_ip));
+
+    j["src_ip"] = src_ip;
+    j["dst_ip"] = dst_ip;
+    j["query"] = e.get_query();
+    j["qtype"] = e.get_query_type();
+    j["rcode"] = e.get_rcode();
+
+    j["length"] = q.length;
+    j["labels"] = q.labels;
+    j["max_label"] = q.max_label;
+    j["subdomain"] = q.subdomain;
+    j["max_consonants"] = q.max_consonants;
+    j["entropy"] = round(q.entropy * 1000) / 1000;
+    j["bigram_entropy"] = round(q.bigram_entropy * 1000) / 1000;
+
+    // shares of the name's bytes, dots included
+    if (q.length)
+    {
+        j["letters"] = round(1000.0 * q.letters / q.length) / 1000;
+        j["vowels"] = round(1000.0 * q.vowels / q.length) / 1000;
+        j["digits"] = round(1000.0 * q.digits / q.length) / 1000;
+        j["hyphens"] = round(1000.0 * q.hyphens / q.length) / 1000;
+        j["other"] = round(1000.0 * q.other / q.length) / 1000;
+    }
+
+    // absent when the response could not be read whole
+    if (a)
+    {
+        j["answers"] = a->answers;
+        j["txt_bytes"] = a->txt_bytes;
+        j["null_bytes"] = a->null_bytes;
+    }
+
+    // queries per second from the client over the last ten seconds or so
+    j["client_rate"] = round(client_rate * 100) / 100;
+
+    return encode_event(j, config->encoding);
 }
 
-void AIEventExporter::export_alert(Packet* p)
+void AIEventExporter::export_alert(Packet* p, const RuleAlert* ra)
 {
+    // no sink wants it; skip the encoding
+    uint32_t topic;
+    uint64_t routes = route_packet(EVENT_ALERT, p, ra, topic);
+
+    if (!routes)
+        return;
+
     try
     {
-        string event_json = serialize_packet(p);
-        send_event(event_json);
+        string event_json = serialize_packet(p, ra);
+        send_event(std::move(event_json), p->flow ? get_flow_data(p->flow)->flow_id : 0, routes,
+            topic);
     }
     catch (const exception& e)
     {
@@ -281,10 +1477,17 @@ void AIEventExporter::export_alert(Packet* p)
 
 void AIEventExporter::export_flow(Packet* p)
 {
+    Flow* f = p->flow;
+    uint32_t topic;
+    uint64_t routes = route_flow(EVENT_FLOW, f->client_ip, f->server_ip, f->ip_proto, topic);
+
+    if (!routes)
+        return;
+
     try
     {
-        string event_json = serialize_flow(p->flow);
-        send_event(event_json);
+        string event_json = serialize_flow(f);
+        send_event(std::move(event_json), get_flow_data(f)->flow_id, routes, topic);
     }
     catch (const exception& e)
     {
@@ -293,59 +1496,260 @@ void AIEventExporter::export_flow(Packet* p)
     }
 }
 
-void AIEventExporter::send_event(const string& event_json)
+void AIEventExporter::export_flow_end(const AIFlowData& fd)
 {
-    lock_guard<mutex> lock(buffer_mutex);
-    
-    if (event_buffer.size() >= config->buffer_size)
+    FlowRanks ranks;
+    bool ranked = false;
+
+    if (FlowBaselines* baselines = sender->get_baselines())
+    {
+        FlowSample s;
+        uint64_t bytes = fd.bytes_to_server + fd.bytes_to_client;
+        uint64_t packets = fd.packets_to_server + fd.packets_to_client;
+
+        s.client = route_addr(&fd.client_ip);
+        s.server = route_addr(&fd.server_ip);
+        s.port = fd.server_port;
+        s.values[METRIC_BYTES] = bytes;
+        s.values[METRIC_DURATION] = duration_ms(fd);
+        s.values[METRIC_PACKET_SIZE] = packets ? (float)bytes / packets : 0;
+
+        // ranked before it joins the baseline it is ranked against
+        ranked = baselines->rank(s, ranks);
+        baselines->add(get_instance_id(), s);
+    }
+
+    if (sender->get_profiles())
+        profile_flow(fd);
+
+    if (CommGraph* graph = sender->get_graph())
+    {
+        EdgeKey k;
+
+        k.src = route_addr(&fd.client_ip);
+        k.dst = route_addr(&fd.server_ip);
+        k.port = fd.server_port;
+        k.protocol = fd.protocol;
+
+        graph->add(get_instance_id(), k, fd.packets_to_server + fd.packets_to_client,
+            fd.bytes_to_server + fd.bytes_to_client);
+    }
+
+    if (!config->export_flows)
+        return;
+
+    uint32_t topic;
+    uint64_t routes = route_flow(EVENT_FLOW_END, fd.client_ip, fd.server_ip, fd.protocol, topic);
+
+    if (!routes)
+        return;
+
+    try
+    {
+        string event_json = serialize_flow_end(fd, ranked ? &ranks : nullptr);
+        send_event(std::move(event_json), fd.flow_id, routes, topic);
+    }
+    catch (const exception& e)
     {
-        // Drop oldest event if buffer is full
-        event_buffer.pop();
+        ErrorMessage("Failed to export flow end: %s\n", e.what());
         events_dropped++;
     }
-    
-    event_buffer.push(event_json);
-    
-    // Send if buffer reached threshold
-    if (event_buffer.size() >= config->buffer_size / 10)
+}
+
+void AIEventExporter::track_connection(const AIFlowData& fd)
+{
+    BeaconKey key;
+
+    key.client = route_addr(&fd.client_ip);
+    key.server = route_addr(&fd.server_ip);
+    key.port = fd.server_port;
+    key.protocol = fd.protocol;
+
+    uint64_t ms = (uint64_t)fd.start_time.tv_sec * 1000 + fd.start_time.tv_usec / 1000;
+    BeaconCandidate c;
+
+    if (!beacons->observe(key, ms, c))
+        return;
+
+    uint32_t topic;
+    uint64_t routes = route_flow(EVENT_BEACON, fd.client_ip, fd.server_ip, fd.protocol, topic);
+
+    if (!routes)
+        return;
+
+    try
+    {
+        send_event(serialize_beacon(fd, c), fd.flow_id, routes, topic);
+    }
+    catch (const exception& e)
     {
-        flush_buffer();
+        ErrorMessage("Failed to export beacon: %s\n", e.what());
+        events_dropped++;
     }
 }
 
-void AIEventExporter::flush_buffer()
+void AIEventExporter::profile_flow(const AIFlowData& fd)
 {
-    lock_guard<mutex> lock(buffer_mutex);
-    
-    while (!event_buffer.empty())
+    HostProfiles* profiles = sender->get_profiles();
+    ProfileFlow f;
+
+    f.port = fd.server_port;
+    f.time = fd.last_seen.tv_sec;
+
+    // each internal end, from its own side
+    for (bool client : { true, false })
     {
-        const string& event = event_buffer.front();
-        
+        f.host = route_addr(client ? &fd.client_ip : &fd.server_ip);
+        f.peer = route_addr(client ? &fd.server_ip : &fd.client_ip);
+
+        if (!profiles->internal(f.host))
+            continue;
+
+        f.client = client;
+        f.bytes_out = client ? fd.bytes_to_server : fd.bytes_to_client;
+        f.bytes_in = client ? fd.bytes_to_client : fd.bytes_to_server;
+
+        ProfileDeviation d;
+
+        if (!profiles->observe(f, d))
+            continue;
+
+        uint32_t topic;
+        uint64_t routes = route_flow(EVENT_PROFILE, fd.client_ip, fd.server_ip, fd.protocol,
+            topic);
+
+        if (!routes)
+            continue;
+
         try
         {
-            zmq::message_t message(event.size());
-            memcpy(message.data(), event.data(), event.size());
-            
-            if (zmq_socket->send(message, zmq::send_flags::dontwait))
-            {
-                events_sent++;
-            }
-            else
-            {
-                events_dropped++;
-                break; // Stop if send would block
-            }
+            send_event(serialize_deviation(fd, d), fd.flow_id, routes, topic);
         }
         catch (const exception& e)
         {
-            ErrorMessage("Failed to send event: %s\n", e.what());
+            ErrorMessage("Failed to export profile deviation: %s\n", e.what());
+            events_dropped++;
+        }
+    }
+}
+
+void AIEventExporter::export_dns(const DnsResponseEvent& dns, Flow* f)
+{
+    // the response being inspected; the event itself has no addresses
+    Packet* p = DetectionEngine::get_current_packet();
+
+    if (!f || !p || !p->pkth || !exported(p))
+        return;
+
+    const string& query = dns.get_query();
+    DnsQueryFeatures q;
+
+    dns_query_features(query.data(), query.size(), q);
+    dns_pegs.queries.fetch_add(1, memory_order_relaxed);
+
+    // counted whether or not a sink wants the event, so the rate stays true
+    uint64_t ms = (uint64_t)p->pkth->ts.tv_sec * 1000 + p->pkth->ts.tv_usec / 1000;
+    float rate = dns_rates->count(route_addr(&f->client_ip), ms);
+
+    uint32_t topic;
+    uint64_t routes = route_flow(EVENT_DNS, f->client_ip, f->server_ip, f->ip_proto, topic);
+
+    if (!routes)
+        return;
+
+    // the response message itself; over TCP only when the segment holds
+    // all of it behind its length
+    const uint8_t* msg = p->data;
+    size_t len = p->dsize;
+
+    if (p->is_tcp())
+    {
+        if (len < 2 || (size_t)(msg[0] << 8 | msg[1]) != len - 2)
+            len = 0;
+        else
+        {
+            msg += 2;
+            len -= 2;
+        }
+    }
+
+    DnsAnswerSizes answers;
+    bool read = len && dns_answer_sizes(msg, len, answers);
+
+    try
+    {
+        uint64_t flow_id = get_flow_data(f)->flow_id;
+        send_event(serialize_dns(dns, f, flow_id, q, read ? &answers : nullptr, rate),
+            flow_id, routes, topic);
+    }
+    catch (const exception& e)
+    {
+        ErrorMessage("Failed to export dns: %s\n", e.what());
+        events_dropped++;
+    }
+}
+
+void AIEventExporter::export_rule_alert(Packet* p, const RuleAlert& ra)
+{
+    if (config->export_alerts && exported(p) && pass_breaker(p, ra))
+        export_alert(p, &ra);
+}
+
+bool AIEventExporter::pass_breaker(Packet* p, const RuleAlert& ra)
+{
+    if (!thread_breaker || !p->pkth)
+        return true;
+
+    Storm* storm = nullptr;
+
+    switch (thread_breaker->check(ra.gid, ra.sid, p->pkth->ts.tv_sec, storm))
+    {
+    case StormBreaker::PASS:
+        return true;
+
+    case StormBreaker::SUPPRESS:
+        return false;
+
+    case StormBreaker::TRIP:
+        break;
+    }
+
+    // the start record takes the place of the alert that tripped it
+    storm->rev = ra.rev;
+    storm->priority = ra.priority;
+    storm->msg = rule_msg(ra.msg);
+    storm->routes = route_packet(EVENT_ALERT, p, &ra, storm->topic);
+
+    vector<StormReport> reports { { STORM_START, *storm } };
+    export_storms(reports);
+    return false;
+}
+
+void AIEventExporter::export_storms(vector<StormReport>& reports)
+{
+    for (auto& r : reports)
+    {
+        if (!r.storm.routes)
+            continue;
+
+        try
+        {
+            send_event(serialize_storm(r.storm, r.state), 0, r.storm.routes, r.storm.topic);
+        }
+        catch (const exception& e)
+        {
+            ErrorMessage("Failed to export storm: %s\n", e.what());
             events_dropped++;
         }
-        
-        event_buffer.pop();
     }
 }
 
+void AIEventExporter::send_event(string&& event, uint64_t flow_id, uint64_t routes,
+    uint32_t topic)
+{
+    sender->send(get_instance_id(), std::move(event), flow_id, routes, topic);
+}
+
 //-------------------------------------------------------------------------
 // API
 //-------------------------------------------------------------------------
@@ -363,7 +1767,7 @@ static void mod_dtor(Module* m)
 static Inspector* ai_event_ctor(Module* m)
 {
     AIEventExporterModule* mod = (AIEventExporterModule*)m;
-    return new AIEventExporter(mod->get_config());
+    return new AIEventExporter(mod->get_config(), mod->get_nets());
 }
 
 static void ai_event_dtor(Inspector* p)
@@ -371,6 +1775,11 @@ static void ai_event_dtor(Inspector* p)
     delete p;
 }
 
+static void ai_event_init()
+{
+    AIFlowData::init();
+}
+
 static const InspectApi ai_event_api =
 {
     {
@@ -389,7 +1798,7 @@ static const InspectApi ai_event_api =
     PROTO_BIT__ALL,
     nullptr, // buffers
     "ai-ops",
-    nullptr, // pinit
+    ai_event_init, // pinit
     nullptr, // pterm
     nullptr, // tinit
     nullptr, // tterm
@@ -402,5 +1811,6 @@ static const InspectApi ai_event_api =
 SO_PUBLIC const BaseApi* snort_plugins[] =
 {
     &ai_event_api.base,
+    &ai_alert_api.base,
     nullptr
 };
@@ -18,24 +18,134 @@
 
 #include "framework/inspector.h"
 #include "framework/module.h"
-#include <zmq.hpp>
+#include <atomic>
 #include <string>
-#include <queue>
-#include <mutex>
+#include <vector>
+
+#include "beacon_tracker.h"
+#include "dns_features.h"
+#include "event_router.h"
+#include "export_filter.h"
+#include "flow_baselines.h"
+#include "host_profiles.h"
+#include "net_trie.h"
+#include "rate_limiter.h"
+#include "storm_breaker.h"
+
+class AIFlowData;
+class EventSender;
+
+namespace snort
+{
+class DnsResponseEvent;
+struct SfIp;
+}
 
 //-------------------------------------------------------------------------
 // Configuration
 //-------------------------------------------------------------------------
 
+enum EventEncoding
+{
+    ENCODING_JSON,
+    ENCODING_MSGPACK
+};
+
+enum SenderSharding
+{
+    SHARD_BY_NODE,
+    SHARD_BY_FLOW
+};
+
+enum LatencyMode
+{
+    LATENCY_BATCH,
+    LATENCY_BUSY_POLL
+};
+
+enum ZmqSocketType
+{
+    ZMQ_SOCKET_PUSH,
+    ZMQ_SOCKET_PUB
+};
+
+enum FlowControl
+{
+    FLOW_CONTROL_NONE,
+    FLOW_CONTROL_CREDIT
+};
+
+enum UnixSocketType
+{
+    UNIX_SEQPACKET,
+    UNIX_DGRAM
+};
+
+enum SinkBackpressure
+{
+    BACKPRESSURE_BLOCK,
+    BACKPRESSURE_DROP
+};
+
+struct SinkConfig
+{
+    std::string endpoint;
+    SinkBackpressure backpressure;
+    RouteFilter filter;
+};
+
 struct AIEventExporterConfig
 {
     std::string endpoint;
+    SinkBackpressure backpressure;
+    std::vector<SinkConfig> sinks;
+    std::string export_filter;
+    NetListConfig nets;
     bool export_alerts;
     bool export_flows;
     bool export_stats;
     std::string min_severity;
     size_t buffer_size;
     uint32_t flush_interval;
+    EventEncoding encoding;
+    std::string sender_cpus;
+    bool numa_senders;
+    unsigned sender_threads;
+    SenderSharding sharding;
+    LatencyMode latency_mode;
+    uint32_t file_rotate_size;
+    uint32_t file_rotate_interval;
+    bool file_direct_io;
+    UnixSocketType unix_socket_type;
+    ZmqSocketType zmq_socket_type;
+    FlowControl flow_control;
+    bool sequence_events;
+    uint32_t alert_ack_window;
+    uint32_t shutdown_drain;
+    std::string spool_dir;
+    uint32_t heartbeat_interval;
+    StormConfig storm;
+    RateLimitConfig rate_limit;
+    BeaconConfig beacons;
+    uint32_t graph_interval;
+    uint32_t graph_edges;
+    BaselineConfig baselines;
+    ProfileConfig profiles;
+    uint32_t payload_bytes;
+    bool tls_fingerprints;
+    bool tcp_health;
+    bool export_dns;
+    uint32_t dns_clients;
+};
+
+// a rule alert as reported to the alert_ai_ops logger
+struct RuleAlert
+{
+    uint32_t gid;
+    uint32_t sid;
+    uint32_t rev;
+    uint32_t priority;
+    const char* msg;
 };
 
 //-------------------------------------------------------------------------
@@ -52,6 +162,17 @@ public:
     bool begin(const char*, int, snort::SnortConfig*) override;
     bool end(const char*, int, snort::SnortConfig*) override;
 
+    const snort::Command* get_commands() const override;
+
+    const PegInfo* get_pegs() const override;
+    PegCount* get_counts() const override;
+
+    // the counts are totals kept across threads, not per packet thread
+    bool global_stats() const override
+    { return true; }
+
+    void prep_counts(bool) override;
+
     Usage get_usage() const override
     { return INSPECT; }
 
@@ -61,8 +182,16 @@ public:
     AIEventExporterConfig* get_config()
     { return &config; }
 
+    NetListsHandle* get_nets()
+    { return &nets; }
+
+    // compiles the configured prefix lists and swaps them in
+    bool load_nets();
+
 private:
     AIEventExporterConfig config;
+    NetListsHandle nets;
+    SinkConfig sink;
 };
 
 //-------------------------------------------------------------------------
@@ -72,7 +201,7 @@ private:
 class AIEventExporter : public snort::Inspector
 {
 public:
-    AIEventExporter(AIEventExporterConfig* c);
+    AIEventExporter(AIEventExporterConfig* c, NetListsHandle* n);
     ~AIEventExporter() override;
 
     void show(const snort::SnortConfig*) const override;
@@ -82,23 +211,56 @@ public:
     void tinit() override;
     void tterm() override;
 
+    void export_flow_end(const AIFlowData&);
+    void export_rule_alert(snort::Packet*, const RuleAlert&);
+
+    // a response the DNS inspector published for the current packet
+    void export_dns(const snort::DnsResponseEvent&, snort::Flow*);
+
+    // the exporter running on the calling packet thread, if any
+    static AIEventExporter* get_thread_exporter();
+
 private:
-    void export_alert(snort::Packet* p);
+    void export_alert(snort::Packet* p, const RuleAlert* = nullptr);
     void export_flow(snort::Packet* p);
-    void send_event(const std::string& event_json);
-    void flush_buffer();
+    void send_event(std::string&& event, uint64_t flow_id, uint64_t routes, uint32_t topic);
+
+    // false if the breaker holds the alert back for its sid's storm summary
+    bool pass_breaker(snort::Packet*, const RuleAlert&);
+    void export_storms(std::vector<StormReport>&);
+
+    // scores the new flow's connection pair for periodicity
+    void track_connection(const AIFlowData&);
+
+    // updates the profiles of the flow's internal ends
+    void profile_flow(const AIFlowData&);
+
+    // the sinks that get the event, and its PUB topic
+    uint64_t route_packet(EventType, snort::Packet*, const RuleAlert*, uint32_t& topic) const;
+    uint64_t route_flow(EventType, const snort::SfIp& client, const snort::SfIp& server,
+        uint8_t protocol, uint32_t& topic) const;
     
-    std::string serialize_packet(snort::Packet* p);
+    std::string serialize_packet(snort::Packet* p, const RuleAlert*);
     std::string serialize_flow(snort::Flow* f);
+    std::string serialize_flow_end(const AIFlowData&, const FlowRanks*);
+    std::string serialize_storm(const Storm&, StormState);
+    std::string serialize_beacon(const AIFlowData&, const BeaconCandidate&);
+    std::string serialize_deviation(const AIFlowData&, const ProfileDeviation&);
+    std::string serialize_dns(const snort::DnsResponseEvent&, snort::Flow*, uint64_t flow_id,
+        const DnsQueryFeatures&, const DnsAnswerSizes*, float client_rate);
+
+    AIFlowData* get_flow_data(snort::Flow* f);
+    bool exported(const snort::Packet*) const;
 
 private:
     AIEventExporterConfig* config;
-    zmq::context_t* zmq_context;
-    zmq::socket_t* zmq_socket;
-    std::queue<std::string> event_buffer;
-    std::mutex buffer_mutex;
-    uint64_t events_sent;
-    uint64_t events_dropped;
+    EventSender* sender;
+    EventRouter router;
+    ExportFilter filter;
+    NetListsHandle* nets;
+    BeaconTracker* beacons;
+    DnsClientRates* dns_rates;
+    std::atomic<uint64_t> events_dropped;
 };
 
 #endif
@@ -0,0 +1,113 @@
+//--------------------------------------------------------------------------
+// ai_flow_data.cc - Per-flow state kept by the AI Event Exporter
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "ai_flow_data.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "main/thread.h"
+#include "time/packet_time.h"
+
+#include "ai_event_exporter.h"
+
+using namespace snort;
+
+// segments of a direction looked at for its hello, reassembled ones included
+static const uint8_t MAX_HELLO_TRIES = 4;
+
+unsigned AIFlowData::inspector_id = 0;
+
+static const uint64_t FLOW_ID_COUNTER_MASK = (1ULL << 48) - 1;
+static THREAD_LOCAL uint64_t flow_id_counter = 0;
+
+uint64_t AIFlowData::next_flow_id()
+{
+    uint64_t thread = (uint64_t)get_instance_id() + 1;
+    return (thread << 48) | (++flow_id_counter & FLOW_ID_COUNTER_MASK);
+}
+
+AIFlowData::AIFlowData(AIEventExporter* ins, const Flow* f)
+    : FlowData(inspector_id, ins), flow_id(next_flow_id()),
+      client_ip(f->client_ip), server_ip(f->server_ip),
+      client_port(f->client_port), server_port(f->server_port),
+      protocol(f->ip_proto), start_time(f->flowstats.start_time),
+      last_seen(f->flowstats.start_time),
+      exporter(ins)
+{
+}
+
+AIFlowData::~AIFlowData()
+{
+    // a short flow is scored on what it had
+    finish_payload(0);
+    finish_payload(1);
+
+    // the handler reference keeps the exporter alive until this point
+    exporter->export_flow_end(*this);
+}
+
+void AIFlowData::update(const Flow* f)
+{
+    packets_to_server = f->flowstats.client_pkts;
+    packets_to_client = f->flowstats.server_pkts;
+    bytes_to_server = f->flowstats.client_bytes;
+    bytes_to_client = f->flowstats.server_bytes;
+    packet_gettimeofday(&last_seen);
+}
+
+void AIFlowData::add_payload(const uint8_t* data, uint16_t len, bool to_server, uint16_t limit)
+{
+    unsigned dir = to_server ? 0 : 1;
+
+    if (payload[dir].bytes)
+        return;
+
+    // the buffer's own size, not the caller's, which a reload may change
+    if (!sample[dir])
+    {
+        sample[dir] = new uint8_t[limit];
+        sample_limit[dir] = limit;
+    }
+
+    uint16_t n = std::min<uint16_t>(len, sample_limit[dir] - sampled[dir]);
+    memcpy(sample[dir] + sampled[dir], data, n);
+    sampled[dir] += n;
+
+    if (sampled[dir] == sample_limit[dir])
+        finish_payload(dir);
+}
+
+void AIFlowData::finish_payload(unsigned dir)
+{
+    if (!sample[dir])
+        return;
+
+    payload_features(sample[dir], sampled[dir], payload[dir]);
+
+    delete[] sample[dir];
+    sample[dir] = nullptr;
+}
+
+void AIFlowData::add_hello(const uint8_t* data, uint16_t len, bool to_server)
+{
+    unsigned dir = to_server ? 0 : 1;
+
+    if (hello_tries[dir] >= MAX_HELLO_TRIES)
+        return;
+
+    TlsHello res = to_server ? tls_client_fingerprint(data, len, tls) :
+        tls_server_fingerprint(data, len, tls);
+
+    // the segments after a partial hello carry the rest of it, not a record
+    // start, so only the first one can say the direction is not TLS
+    if (res == TLS_HELLO_DONE || (res == TLS_HELLO_NONE && !hello_tries[dir]))
+        hello_tries[dir] = MAX_HELLO_TRIES;
+    else
+        hello_tries[dir]++;
+}
@@ -0,0 +1,95 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// ai_flow_data.h - Per-flow state kept by the AI Event Exporter
+
+#ifndef AI_FLOW_DATA_H
+#define AI_FLOW_DATA_H
+
+#include "flow/flow.h"
+
+#include "payload_entropy.h"
+#include "tcp_health.h"
+#include "tls_fingerprint.h"
+
+#include <cstdint>
+#include <sys/time.h>
+
+class AIEventExporter;
+
+//-------------------------------------------------------------------------
+// Flow IDs are (packet thread + 1) << 48 | per-thread counter, so they are
+// unique per sensor without any cross-thread coordination.  Every record
+// that belongs to a flow carries the same ID.
+//-------------------------------------------------------------------------
+
+class AIFlowData : public snort::FlowData
+{
+public:
+    AIFlowData(AIEventExporter*, const snort::Flow*);
+    ~AIFlowData() override;
+
+    static void init()
+    { inspector_id = snort::FlowData::create_flow_data_id(); }
+
+    static AIFlowData* get(const snort::Flow* f)
+    { return (AIFlowData*)f->get_flow_data(inspector_id); }
+
+    static uint64_t next_flow_id();
+
+    void update(const snort::Flow*);
+
+    // copies payload until limit bytes of the direction are in, then works
+    // out their features and lets the copy go; the limit of the first call
+    // holds for the rest of the flow, even across a reload that changes it
+    void add_payload(const uint8_t*, uint16_t len, bool to_server, uint16_t limit);
+
+    // fingerprints the direction's hello from the start of its payload;
+    // a hello cut short is tried again on the next few segments
+    void add_hello(const uint8_t*, uint16_t len, bool to_server);
+
+public:
+    static unsigned inspector_id;
+
+    uint64_t flow_id;
+
+    snort::SfIp client_ip;
+    snort::SfIp server_ip;
+    uint16_t client_port;
+    uint16_t server_port;
+    uint8_t protocol;
+
+    struct timeval start_time;
+    struct timeval last_seen;
+    uint64_t packets_to_server = 0;
+    uint64_t packets_to_client = 0;
+    uint64_t bytes_to_server = 0;
+    uint64_t bytes_to_client = 0;
+
+    // to server, to client
+    PayloadFeatures payload[2];
+
+    TlsFingerprints tls;
+    TcpHealthTracker tcp;
+
+private:
+    void finish_payload(unsigned dir);
+
+    AIEventExporter* exporter;
+    uint8_t* sample[2] = { nullptr, nullptr };
+    uint16_t sampled[2] = { 0, 0 };
+    uint16_t sample_limit[2] = { 0, 0 };
+    uint8_t hello_tries[2] = { 0, 0 };
+};
+
+#endif
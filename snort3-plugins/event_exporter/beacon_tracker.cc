@@ -0,0 +1,165 @@
+//--------------------------------------------------------------------------
+// beacon_tracker.cc - Periodic connections (C2 beaconing) seen in-plugin
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "beacon_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+BeaconPegs beacon_pegs;
+
+constexpr unsigned BeaconTracker::WINDOW;
+
+// bins per octave of gap length above min_interval
+static const double BINS_PER_OCTAVE = 4;
+
+static uint64_t hash_key(const BeaconKey& k)
+{
+    uint64_t h = k.client.lo * 0x9e3779b97f4a7c15ULL;
+    h ^= k.client.hi * 0xc2b2ae3d27d4eb4fULL;
+    h ^= k.server.lo * 0x165667b19e3779f9ULL;
+    h ^= k.server.hi * 0xd6e8feb86659fd93ULL;
+    h ^= ((uint64_t)k.port << 8 | k.protocol) * 0xff51afd7ed558ccdULL;
+    return h ^ (h >> 29);
+}
+
+BeaconTracker::BeaconTracker(const BeaconConfig& c) : config(c)
+{
+    uint32_t n = 1;
+
+    while (n * WAYS < config.pairs)
+        n <<= 1;
+
+    sets.reset(new Set[n]);
+    set_mask = n - 1;
+
+    for (uint32_t i = 0; i < n; ++i)
+        for (auto& p : sets[i].ways)
+            p.used = false;
+}
+
+BeaconTracker::Pair& BeaconTracker::find(Set& s, const BeaconKey& key, uint64_t ms)
+{
+    Pair* victim = nullptr;
+
+    for (auto& p : s.ways)
+    {
+        if (p.used && p.key == key)
+            return p;
+
+        if (!victim || (victim->used && (!p.used || p.last < victim->last)))
+            victim = &p;
+    }
+
+    if (victim->used)
+        beacon_pegs.evicted.fetch_add(1, memory_order_relaxed);
+
+    Pair& p = *victim;
+
+    p.key = key;
+    p.used = true;
+    p.first = p.last = ms;
+    p.connections = p.gaps = p.reported = 0;
+    fill(p.bins, p.bins + BINS, 0);
+
+    return p;
+}
+
+static unsigned gap_bin(uint32_t gap, uint32_t min_interval, unsigned bins)
+{
+    double octaves = log2((double)gap / max(min_interval, 1u));
+    return min((unsigned)max(octaves * BINS_PER_OCTAVE, 0.0), bins - 1);
+}
+
+bool BeaconTracker::score(const Pair& p, BeaconCandidate& c) const
+{
+    const unsigned n = min(p.gaps, WINDOW);
+    unsigned band = 0, in_band = 0;
+
+    for (unsigned i = 0; i + 1 < BINS; ++i)
+    {
+        unsigned count = p.bins[i] + p.bins[i + 1];
+
+        if (count > in_band)
+        {
+            in_band = count;
+            band = i;
+        }
+    }
+
+    c.periodicity = (double)in_band / n;
+
+    if (c.periodicity < config.periodicity)
+        return false;
+
+    double sum = 0, sumsq = 0;
+
+    for (unsigned i = 0; i < n; ++i)
+    {
+        unsigned b = gap_bin(p.ring[i], config.min_interval, BINS);
+
+        if (b == band || b == band + 1)
+        {
+            sum += p.ring[i];
+            sumsq += (double)p.ring[i] * p.ring[i];
+        }
+    }
+
+    double mean = sum / in_band;
+    c.jitter = sqrt(max(sumsq / in_band - mean * mean, 0.0)) / mean;
+
+    if (c.jitter > config.jitter)
+        return false;
+
+    c.connections = p.connections;
+    c.interval = (uint32_t)lround(mean);
+    c.first_seen = p.first;
+    c.last_seen = p.last;
+    return true;
+}
+
+bool BeaconTracker::observe(const BeaconKey& key, uint64_t ms, BeaconCandidate& c)
+{
+    Set& s = sets[hash_key(key) & set_mask];
+    lock_guard<mutex> lock(s.lock);
+
+    Pair& p = find(s, key, ms);
+    p.connections++;
+
+    // the first connection, one of a burst, or one that started before the
+    // latest on another packet thread
+    if (p.connections == 1 || ms < p.last + config.min_interval)
+        return false;
+
+    uint32_t gap = (uint32_t)min<uint64_t>(ms - p.last, UINT32_MAX);
+    uint32_t& slot = p.ring[p.gaps % WINDOW];
+
+    if (p.gaps >= WINDOW)
+        p.bins[gap_bin(slot, config.min_interval, BINS)]--;
+
+    slot = gap;
+    p.bins[gap_bin(gap, config.min_interval, BINS)]++;
+    p.gaps++;
+    p.last = ms;
+
+    // connections, not gaps; bursts only count once
+    if (p.gaps + 1 < config.min_connections)
+        return false;
+
+    if (p.reported && p.gaps - p.reported < WINDOW)
+        return false;
+
+    if (!score(p, c))
+        return false;
+
+    p.reported = p.gaps;
+    beacon_pegs.candidates.fetch_add(1, memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,133 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// beacon_tracker.h - Periodic connections (C2 beaconing) seen in-plugin
+
+#ifndef BEACON_TRACKER_H
+#define BEACON_TRACKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "event_router.h"
+
+//-------------------------------------------------------------------------
+// For each (client, server, server port, protocol) the tracker keeps the
+// gaps between the starts of its last WINDOW connections in a ring, and a
+// histogram of those gaps in quarter octave bins that the ring keeps in
+// step: each new gap is added and the one it pushes out is removed.
+//
+//   periodicity   share of the window in the two busiest adjacent bins,
+//                 so a beacon with a few percent of jitter stays in one
+//                 band however the bin edges fall
+//   jitter        standard deviation over mean of the gaps in that band;
+//                 a missed beacon lands outside it and does not count
+//
+// Connections closer together than min_interval are taken as one burst.
+// Scoring a connection touches one bucket set and a fixed number of bins.
+//
+// The table is shared by the packet threads, so a pair is tracked however
+// its connections are balanced; each set of WAYS pairs has a lock, and
+// the least recently seen pair of a full set makes room.
+//-------------------------------------------------------------------------
+
+struct BeaconConfig
+{
+    uint32_t pairs = 0;             // table size, 0 = off
+    double periodicity = 0.8;
+    double jitter = 0.2;
+    uint32_t min_connections = 8;
+    uint32_t min_interval = 1000;   // ms
+
+    bool enabled() const
+    { return pairs > 0; }
+};
+
+struct BeaconKey
+{
+    RouteAddr client;
+    RouteAddr server;
+    uint16_t port;
+    uint8_t protocol;
+
+    bool operator==(const BeaconKey& that) const
+    {
+        return client == that.client && server == that.server &&
+            port == that.port && protocol == that.protocol;
+    }
+};
+
+struct BeaconCandidate
+{
+    uint32_t connections;       // since the pair was first seen
+    uint32_t interval;          // mean gap in the band, ms
+    double periodicity;
+    double jitter;
+    uint64_t first_seen;        // ms
+    uint64_t last_seen;
+};
+
+// totals over all packet threads, for the module pegs
+struct BeaconPegs
+{
+    std::atomic<uint64_t> candidates { 0 };
+    std::atomic<uint64_t> evicted { 0 };
+};
+
+extern BeaconPegs beacon_pegs;
+
+class BeaconTracker
+{
+public:
+    BeaconTracker(const BeaconConfig&);
+
+    static constexpr unsigned WINDOW = 16;
+
+    // a new connection started at ms; true with the candidate if the pair
+    // now scores as a beacon, again only after another WINDOW gaps
+    bool observe(const BeaconKey&, uint64_t ms, BeaconCandidate&);
+
+private:
+    static constexpr unsigned WAYS = 4;
+    static constexpr unsigned BINS = 64;
+
+    struct Pair
+    {
+        BeaconKey key;
+        bool used;
+        uint64_t first;
+        uint64_t last;
+        uint32_t connections;
+        uint32_t gaps;              // since first seen
+        uint32_t reported;          // gaps when last reported
+        uint32_t ring[WINDOW];
+        uint8_t bins[BINS];
+    };
+
+    struct alignas(64) Set
+    {
+        std::mutex lock;
+        Pair ways[WAYS];
+    };
+
+    Pair& find(Set&, const BeaconKey&, uint64_t ms);
+    bool score(const Pair&, BeaconCandidate&) const;
+
+    BeaconConfig config;
+    std::unique_ptr<Set[]> sets;
+    uint32_t set_mask;
+};
+
+#endif
@@ -0,0 +1,35 @@
+//--------------------------------------------------------------------------
+// bench_shims.cc - Stand-ins for the Snort logging API used by benchmarks
+//--------------------------------------------------------------------------
+
+#include "log/messages.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+namespace snort
+{
+void LogMessage(const char* format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+}
+
+void WarningMessage(const char* format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+}
+
+void ErrorMessage(const char* format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+}
+}
@@ -0,0 +1,57 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// bench_util.h - Timing helpers shared by the exporter benchmarks
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+static inline uint64_t bench_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// keep the optimizer from discarding a computed value
+template<typename T>
+static inline void bench_keep(const T& v)
+{ asm volatile("" : : "g"(v) : "memory"); }
+
+static inline double bench_percentile(std::vector<uint64_t>& sorted, double pct)
+{
+    if (sorted.empty())
+        return 0;
+
+    size_t idx = (size_t)(pct / 100.0 * (sorted.size() - 1));
+    return (double)sorted[idx];
+}
+
+static inline void bench_report_latency(const char* label, std::vector<uint64_t>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    printf("%-12s n=%-9zu p50=%9.1fus p99=%9.1fus p99.9=%9.1fus max=%9.1fus\n", label,
+        samples.size(),
+        bench_percentile(samples, 50) / 1000.0,
+        bench_percentile(samples, 99) / 1000.0,
+        bench_percentile(samples, 99.9) / 1000.0,
+        samples.empty() ? 0.0 : samples.back() / 1000.0);
+}
+
+#endif
@@ -0,0 +1,101 @@
+//--------------------------------------------------------------------------
+// filter_bench.cc - Per-packet cost of the compiled export_filter
+//
+// Evaluates a few representative expressions against a pre-built set of
+// random 5-tuples and reports the mean cost of one match() call, which is
+// what eval() adds to every packet when export_filter is configured.
+//
+//     filter_bench [packets] [rounds]
+//--------------------------------------------------------------------------
+
+#include "export_filter.h"
+
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace std;
+
+static const double TARGET_NS = 20.0;
+
+static const char* expressions[] =
+{
+    "tcp",
+    "not net 10.0.0.0/8",
+    "tcp and (dst port 80 or dst port 443)",
+    "(tcp or udp) and not (src net 10.0.0.0/8 or src net 192.168.0.0/16) and portrange 1-1023",
+    "host 198.51.100.7 or net 2001:db8::/32 or (udp and dst port 53) or icmp or icmp6",
+};
+
+static RouteAddr v4_addr(uint32_t ip)
+{
+    return { 0, 0x0000ffff00000000ULL | ip };
+}
+
+static vector<FilterKey> make_keys(size_t n)
+{
+    mt19937_64 rng(42);
+    vector<FilterKey> keys(n);
+    static const uint8_t protos[] = { 6, 6, 6, 17, 17, 1 };
+    static const uint16_t ports[] = { 80, 443, 53, 22, 8080 };
+
+    for (auto& k : keys)
+    {
+        uint64_t r = rng();
+
+        // mostly private clients talking to public servers, some IPv6
+        if (r % 8)
+        {
+            k.src = v4_addr((r & 1 ? 0x0a000000 : 0xc0a80000) | (uint32_t)(r >> 40 & 0xffff));
+            k.dst = v4_addr((uint32_t)(rng() & 0xffffffff));
+        }
+        else
+        {
+            k.src = { 0x20010db800000000ULL | (r >> 48), rng() };
+            k.dst = { rng(), rng() };
+        }
+        k.protocol = protos[(r >> 8) % sizeof(protos)];
+        k.src_port = (uint16_t)(1024 + (r >> 16) % 64000);
+        k.dst_port = ports[(r >> 32) % 5];
+    }
+    return keys;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t packets = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4096;
+    unsigned rounds = argc > 2 ? strtoul(argv[2], nullptr, 10) : 2000;
+
+    vector<FilterKey> keys = make_keys(packets);
+
+    for (auto expr : expressions)
+    {
+        ExportFilter filter;
+        string error;
+
+        if (!filter.compile(expr, error))
+        {
+            printf("%s: %s\n", expr, error.c_str());
+            return 1;
+        }
+
+        size_t hits = 0;
+        uint64_t start = bench_now_ns();
+
+        for (unsigned r = 0; r < rounds; ++r)
+            for (auto& k : keys)
+                hits += filter.match(k);
+
+        uint64_t elapsed = bench_now_ns() - start;
+        bench_keep(hits);
+
+        double ns = (double)elapsed / ((double)rounds * keys.size());
+
+        printf("%6.2f ns/packet %5.1f%% match %2zu tests %s  %s\n", ns,
+            100.0 * hits / ((double)rounds * keys.size()), filter.size(),
+            ns <= TARGET_NS ? "ok  " : "SLOW", expr);
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+//--------------------------------------------------------------------------
+// net_trie_bench.cc - Prefix list lookups: radix trie vs linear scan
+//
+// Builds a list of random IPv4 and IPv6 prefixes and looks up addresses of
+// which about half fall inside the list, once through NetTrie and once by
+// scanning the prefix ranges in order, and reports lookups per second.
+//
+//     net_trie_bench [prefixes] [lookups]
+//--------------------------------------------------------------------------
+
+#include "net_trie.h"
+
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace std;
+
+typedef vector<pair<RouteAddr, RouteAddr>> Ranges;
+
+static RouteAddr random_addr(mt19937_64& rng, bool v4)
+{
+    if (v4)
+        return { 0, 0x0000ffff00000000ULL | (rng() & 0xffffffff) };
+
+    return { 0x2000000000000000ULL | (rng() >> 4), rng() };
+}
+
+static pair<RouteAddr, RouteAddr> random_prefix(mt19937_64& rng)
+{
+    bool v4 = rng() % 4;
+    unsigned bits = v4 ? 96 + 12 + rng() % 21 : 32 + rng() % 33;
+    RouteAddr a = random_addr(rng, v4);
+
+    uint64_t hi_mask = bits >= 64 ? ~0ULL : ~0ULL << (64 - bits);
+    uint64_t lo_mask = bits <= 64 ? 0 : bits >= 128 ? ~0ULL : ~0ULL << (128 - bits);
+
+    RouteAddr lo = { a.hi & hi_mask, a.lo & lo_mask };
+    return { lo, { lo.hi | ~hi_mask, lo.lo | ~lo_mask } };
+}
+
+static bool scan(const Ranges& ranges, const RouteAddr& a)
+{
+    for (auto& r : ranges)
+        if (!(a < r.first) && !(r.second < a))
+            return true;
+
+    return false;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 5000;
+    size_t lookups = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1000000;
+
+    mt19937_64 rng(42);
+    Ranges ranges;
+
+    for (size_t i = 0; i < count; ++i)
+        ranges.emplace_back(random_prefix(rng));
+
+    // half inside a random prefix, half anywhere
+    vector<RouteAddr> addrs;
+
+    for (size_t i = 0; i < 65536; ++i)
+    {
+        if (i % 2)
+        {
+            auto& r = ranges[rng() % ranges.size()];
+            RouteAddr a = random_addr(rng, r.first.hi == 0);
+            addrs.push_back({ r.first.hi | (a.hi & (r.first.hi ^ r.second.hi)),
+                r.first.lo | (a.lo & (r.first.lo ^ r.second.lo)) });
+        }
+        else
+            addrs.emplace_back(random_addr(rng, rng() % 4));
+    }
+
+    uint64_t start = bench_now_ns();
+    NetTrie trie;
+    trie.build(ranges);
+    uint64_t build = bench_now_ns() - start;
+
+    for (auto& a : addrs)
+    {
+        if (trie.contains(a) != scan(ranges, a))
+        {
+            printf("mismatch\n");
+            return 1;
+        }
+    }
+
+    size_t hits = 0;
+    start = bench_now_ns();
+
+    for (size_t i = 0; i < lookups; ++i)
+        hits += trie.contains(addrs[i & 0xffff]);
+
+    double trie_ns = (double)(bench_now_ns() - start) / lookups;
+    bench_keep(hits);
+
+    // the scan is far slower; fewer lookups give the same precision
+    size_t scan_lookups = max<size_t>(lookups / 100, 1000);
+    start = bench_now_ns();
+
+    for (size_t i = 0; i < scan_lookups; ++i)
+        hits += scan(ranges, addrs[i & 0xffff]);
+
+    double scan_ns = (double)(bench_now_ns() - start) / scan_lookups;
+    bench_keep(hits);
+
+    printf("%zu prefixes (%zu stored), trie built in %.2f ms\n", count, trie.size(),
+        build / 1e6);
+    printf("trie   %10.2f ns/lookup %12.0f lookups/s\n", trie_ns, 1e9 / trie_ns);
+    printf("linear %10.2f ns/lookup %12.0f lookups/s\n", scan_ns, 1e9 / scan_ns);
+    printf("speedup %.0fx\n", scan_ns / trie_ns);
+
+    return 0;
+}
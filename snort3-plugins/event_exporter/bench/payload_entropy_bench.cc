@@ -0,0 +1,109 @@
+//--------------------------------------------------------------------------
+// payload_entropy_bench.cc - Payload byte features: AVX2 kernel vs scalar
+//
+// Fills buffers of random bytes and of text at each sample size, checks
+// that both implementations agree, and reports the time per sample and
+// the throughput of each.
+//
+//     payload_entropy_bench [iterations]
+//--------------------------------------------------------------------------
+
+#include "payload_entropy.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace std;
+
+static const size_t BUFFERS = 64;
+
+typedef void (*Kernel)(const uint8_t*, size_t, PayloadFeatures&);
+
+static double run(Kernel k, const vector<vector<uint8_t>>& bufs, size_t n, size_t iterations)
+{
+    PayloadFeatures f;
+    uint64_t start = bench_now_ns();
+
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        k(bufs[i % BUFFERS].data(), n, f);
+        bench_keep(f);
+    }
+
+    return (double)(bench_now_ns() - start) / iterations;
+}
+
+static bool same(const PayloadFeatures& a, const PayloadFeatures& b)
+{
+    return a.bytes == b.bytes && a.distinct == b.distinct && a.printable == b.printable &&
+        a.zero == b.zero && a.high == b.high && fabs(a.entropy - b.entropy) < 1e-3;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+
+#if defined(__x86_64__) || defined(__i386__)
+    if (!payload_features_simd())
+    {
+        printf("no AVX2 on this CPU; nothing to compare\n");
+        return 0;
+    }
+
+    static const char* const words[] =
+        { "GET ", "/index.html ", "HTTP/1.1\r\n", "Host: ", "example.com\r\n", "Accept: */*\r\n" };
+
+    mt19937 rng(42);
+
+    for (const char* kind : { "random", "text" })
+    {
+        vector<vector<uint8_t>> bufs(BUFFERS, vector<uint8_t>(MAX_PAYLOAD_SAMPLE));
+
+        for (auto& b : bufs)
+        {
+            for (size_t i = 0; i < b.size(); )
+            {
+                if (kind[0] == 'r')
+                    b[i++] = rng();
+                else
+                    for (const char* w = words[rng() % 6]; *w && i < b.size(); )
+                        b[i++] = *w++;
+            }
+        }
+
+        for (size_t n : { 64, 256, 1024, 4096 })
+        {
+            for (auto& b : bufs)
+            {
+                PayloadFeatures s, v;
+                payload_features_scalar(b.data(), n, s);
+                payload_features_avx2(b.data(), n, v);
+
+                if (!same(s, v))
+                {
+                    printf("mismatch at %zu bytes: entropy %.4f vs %.4f\n", n, s.entropy,
+                        v.entropy);
+                    return 1;
+                }
+            }
+
+            size_t its = max<size_t>(iterations * 256 / n, 1000);
+            double scalar_ns = run(payload_features_scalar, bufs, n, its);
+            double avx2_ns = run(payload_features_avx2, bufs, n, its);
+
+            printf("%-6s %5zu bytes  scalar %8.1f ns %7.0f MB/s  avx2 %8.1f ns %7.0f MB/s  "
+                "speedup %.1fx\n", kind, n, scalar_ns, n * 1e3 / scalar_ns, avx2_ns,
+                n * 1e3 / avx2_ns, scalar_ns / avx2_ns);
+        }
+    }
+#else
+    (void)iterations;
+    printf("the AVX2 kernel is x86 only\n");
+#endif
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+//--------------------------------------------------------------------------
+// sender_latency_bench.cc - Export latency of batch vs busy_poll senders
+//
+// A packet thread stand-in pushes time-stamped events at a fixed rate
+// through EventSender to a local PULL socket; the receiver reports the
+// push-to-receive latency distribution for each latency_mode.
+//
+//     sender_latency_bench [events] [events_per_sec]
+//--------------------------------------------------------------------------
+
+#include "ai_event_exporter.h"
+#include "event_sender.h"
+
+#include <zmq.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace std;
+
+static const char* BENCH_ENDPOINT = "tcp://127.0.0.1:5599";
+static const size_t EVENT_SIZE = 256;
+
+static void run_mode(LatencyMode mode, const char* label, size_t events, size_t rate)
+{
+    AIEventExporterConfig config {};
+    config.endpoint = BENCH_ENDPOINT;
+    config.buffer_size = 10000;
+    config.flush_interval = 100;
+    config.shutdown_drain = 1000;
+    config.numa_senders = true;
+    config.sender_threads = 1;
+    config.sharding = SHARD_BY_NODE;
+    config.latency_mode = mode;
+
+    zmq::context_t ctx(1);
+    zmq::socket_t pull(ctx, ZMQ_PULL);
+    pull.set(zmq::sockopt::rcvtimeo, 2000);
+    pull.bind(BENCH_ENDPOINT);
+
+    vector<uint64_t> samples;
+    samples.reserve(events);
+
+    thread receiver([&]()
+    {
+        zmq::message_t msg;
+
+        while (samples.size() < events && pull.recv(msg))
+        {
+            uint64_t stamp;
+            memcpy(&stamp, msg.data(), sizeof(stamp));
+            samples.emplace_back(bench_now_ns() - stamp);
+        }
+    });
+
+    {
+        EventSender sender(config, 1);
+        sender.connect();
+
+        thread producer([&]()
+        {
+            sender.attach(0);
+
+            const uint64_t gap = 1000000000ULL / rate;
+            uint64_t next = bench_now_ns();
+
+            for (size_t i = 0; i < events; ++i)
+            {
+                while (bench_now_ns() < next)
+                    ;
+                next += gap;
+
+                string event(EVENT_SIZE, 'x');
+                uint64_t stamp = bench_now_ns();
+                memcpy(&event[0], &stamp, sizeof(stamp));
+                sender.send(0, std::move(event), i, ~0ULL);
+            }
+            sender.detach(0);
+        });
+
+        producer.join();
+        receiver.join();
+    }
+
+    bench_report_latency(label, samples);
+}
+
+int main(int argc, char** argv)
+{
+    size_t events = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+    size_t rate = argc > 2 ? strtoul(argv[2], nullptr, 10) : 100000;
+
+    printf("export latency, %zu events at %zu/s\n", events, rate);
+    run_mode(LATENCY_BATCH, "batch", events, rate);
+    run_mode(LATENCY_BUSY_POLL, "busy_poll", events, rate);
+    return 0;
+}
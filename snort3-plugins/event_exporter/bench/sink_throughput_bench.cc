@@ -0,0 +1,229 @@
+//--------------------------------------------------------------------------
+// sink_throughput_bench.cc - Local transport throughput, unix:// vs ZeroMQ
+//
+// One packet thread stand-in pushes events as fast as the sender accepts
+// them, retrying while its ring is full; a receiver on the same host
+// drains them with recvmmsg() (unix sockets) or a PULL socket (ipc://)
+// and reports the delivered rate.  Events the transport lost after the
+// sender accepted them show up as the gap between sent and received.
+//
+//     sink_throughput_bench [events] [event_size]
+//--------------------------------------------------------------------------
+
+#include "ai_event_exporter.h"
+#include "event_sender.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <zmq.hpp>
+
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace std;
+
+static const char* BENCH_SOCKET = "/tmp/ai_exporter_bench.sock";
+static const char* BENCH_IPC = "ipc:///tmp/ai_exporter_bench.ipc";
+static const unsigned RECV_BATCH = 64;
+static const int RECV_IDLE_MS = 2000;
+
+static AIEventExporterConfig bench_config(const string& endpoint, UnixSocketType type)
+{
+    AIEventExporterConfig config {};
+    config.endpoint = endpoint;
+    config.buffer_size = 65536;
+    config.flush_interval = 100;
+    config.shutdown_drain = 1000;
+    config.numa_senders = true;
+    config.sender_threads = 1;
+    config.sharding = SHARD_BY_NODE;
+    config.latency_mode = LATENCY_BATCH;
+    config.unix_socket_type = type;
+    return config;
+}
+
+static void produce(EventSender& sender, size_t events, size_t size)
+{
+    sender.attach(0);
+
+    for (size_t i = 0; i < events; ++i)
+    {
+        string event(size, 'x');
+
+        // a refused push leaves the event with us
+        while (!sender.send(0, std::move(event), i, ~0ULL))
+            this_thread::yield();
+    }
+
+    sender.detach(0);
+}
+
+static void report(const char* label, size_t received, size_t size, uint64_t elapsed,
+    const EventSender& sender)
+{
+    double secs = elapsed / 1e9;
+
+    printf("%-16s sent=%-9" PRIu64 " recv=%-9zu %10.0f events/s %8.1f MiB/s\n", label,
+        sender.get_sent(), received, received / secs,
+        received * (double)size / secs / (1024 * 1024));
+}
+
+//-------------------------------------------------------------------------
+// unix:// receiver
+//-------------------------------------------------------------------------
+
+// elapsed time ends at the last delivered event, not at the idle timeout
+static size_t recv_unix(int fd, size_t events, size_t size, uint64_t& last)
+{
+    vector<uint8_t> buffers(RECV_BATCH * size);
+    vector<struct iovec> iov(RECV_BATCH);
+    vector<struct mmsghdr> msgs(RECV_BATCH);
+
+    for (unsigned i = 0; i < RECV_BATCH; ++i)
+    {
+        iov[i] = { &buffers[i * size], size };
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    size_t received = 0;
+    struct pollfd pfd = { fd, POLLIN, 0 };
+
+    while (received < events && poll(&pfd, 1, RECV_IDLE_MS) > 0)
+    {
+        int n = recvmmsg(fd, msgs.data(), RECV_BATCH, MSG_DONTWAIT, nullptr);
+
+        if (n <= 0)
+            continue;
+
+        for (int i = 0; i < n; ++i)
+        {
+            if (msgs[i].msg_len == 0)
+                return received;
+            ++received;
+        }
+        last = bench_now_ns();
+    }
+    return received;
+}
+
+static void run_unix(UnixSocketType type, const char* label, size_t events, size_t size)
+{
+    int kind = type == UNIX_DGRAM ? SOCK_DGRAM : SOCK_SEQPACKET;
+    int listener = socket(AF_UNIX, kind, 0);
+
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, BENCH_SOCKET, sizeof(addr.sun_path) - 1);
+    unlink(BENCH_SOCKET);
+
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        perror(BENCH_SOCKET);
+        exit(1);
+    }
+
+    if (kind == SOCK_DGRAM)
+    {
+        // give the receiver room so a scheduling hiccup isn't a drop storm
+        int rcvbuf = 16 * 1024 * 1024;
+        setsockopt(listener, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    else
+        listen(listener, 1);
+
+    // EventSender keeps a reference to its config
+    AIEventExporterConfig config = bench_config(string("unix://") + BENCH_SOCKET, type);
+    EventSender sender(config, 1);
+    sender.connect();
+
+    size_t received = 0;
+    uint64_t start = bench_now_ns();
+    uint64_t last = start;
+
+    thread receiver([&]()
+    {
+        int fd = listener;
+
+        if (kind == SOCK_SEQPACKET)
+        {
+            struct pollfd pfd = { listener, POLLIN, 0 };
+
+            if (poll(&pfd, 1, RECV_IDLE_MS) <= 0)
+                return;
+            fd = accept(listener, nullptr, nullptr);
+        }
+
+        received = recv_unix(fd, events, size, last);
+
+        if (fd != listener)
+            ::close(fd);
+    });
+
+    produce(sender, events, size);
+    receiver.join();
+
+    report(label, received, size, last - start, sender);
+
+    ::close(listener);
+    unlink(BENCH_SOCKET);
+}
+
+//-------------------------------------------------------------------------
+// ZeroMQ receiver
+//-------------------------------------------------------------------------
+
+static void run_zmq(const char* label, size_t events, size_t size)
+{
+    zmq::context_t ctx(1);
+    zmq::socket_t pull(ctx, ZMQ_PULL);
+    pull.set(zmq::sockopt::rcvtimeo, RECV_IDLE_MS);
+    pull.set(zmq::sockopt::rcvhwm, 65536);
+    pull.bind(BENCH_IPC);
+
+    AIEventExporterConfig config = bench_config(BENCH_IPC, UNIX_SEQPACKET);
+    EventSender sender(config, 1);
+    sender.connect();
+
+    size_t received = 0;
+    uint64_t start = bench_now_ns();
+    uint64_t last = start;
+
+    thread receiver([&]()
+    {
+        zmq::message_t msg;
+
+        while (received < events && pull.recv(msg))
+        {
+            ++received;
+            last = bench_now_ns();
+        }
+    });
+
+    produce(sender, events, size);
+    receiver.join();
+
+    report(label, received, size, last - start, sender);
+}
+
+int main(int argc, char** argv)
+{
+    size_t events = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    size_t size = argc > 2 ? strtoul(argv[2], nullptr, 10) : 256;
+
+    printf("local transport throughput, %zu events of %zu bytes\n", events, size);
+    run_unix(UNIX_SEQPACKET, "unix seqpacket", events, size);
+    run_unix(UNIX_DGRAM, "unix dgram", events, size);
+    run_zmq("zmq ipc", events, size);
+    return 0;
+}
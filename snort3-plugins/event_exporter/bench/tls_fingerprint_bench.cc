@@ -0,0 +1,216 @@
+//--------------------------------------------------------------------------
+// tls_fingerprint_bench.cc - JA3 and JA4 of TLS hellos: known answers and cost
+//
+// Fingerprints the hellos of two real handshakes between an OpenSSL 3.0
+// client and server, one TLS 1.3 and one TLS 1.2, and checks them against
+// fingerprints worked out independently with a reference MD5 and SHA-256.
+// A mismatch fails before anything is timed, so a broken digest or parser
+// cannot pass for a fast one.  Then reports the time per hello.
+//
+//     tls_fingerprint_bench [iterations]
+//--------------------------------------------------------------------------
+
+#include "tls_fingerprint.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "bench_util.h"
+
+using namespace std;
+
+// the first record of each direction as it crossed the wire; the TLS 1.3
+// client pads its hello to 512 bytes
+
+static const uint8_t client_hello_13[] =
+{
+    0x16, 0x03, 0x01, 0x02, 0x00, 0x01, 0x00, 0x01, 0xfc, 0x03, 0x03, 0x0d,
+    0x86, 0xcb, 0x56, 0x74, 0x5f, 0x4d, 0x1f, 0x34, 0x1a, 0xf6, 0x49, 0x9c,
+    0x94, 0x69, 0xe4, 0x6c, 0x6e, 0x1c, 0x6b, 0x03, 0x44, 0x58, 0xe1, 0x50,
+    0xa4, 0x16, 0x1c, 0x0e, 0xbd, 0xa0, 0x02, 0x20, 0x16, 0x6e, 0xec, 0x07,
+    0x40, 0x97, 0xbd, 0xd9, 0x03, 0x46, 0x54, 0x8b, 0xe7, 0xc0, 0x2f, 0x6c,
+    0x32, 0x43, 0x1d, 0x7c, 0xd1, 0xd8, 0xd3, 0x3b, 0x9c, 0x92, 0x90, 0x94,
+    0x4b, 0x91, 0x71, 0xf0, 0x00, 0x24, 0x13, 0x02, 0x13, 0x03, 0x13, 0x01,
+    0xc0, 0x2c, 0xc0, 0x30, 0xc0, 0x2b, 0xc0, 0x2f, 0xcc, 0xa9, 0xcc, 0xa8,
+    0xc0, 0x24, 0xc0, 0x28, 0xc0, 0x23, 0xc0, 0x27, 0x00, 0x9f, 0x00, 0x9e,
+    0x00, 0x6b, 0x00, 0x67, 0x00, 0xff, 0x01, 0x00, 0x01, 0x8f, 0x00, 0x00,
+    0x00, 0x10, 0x00, 0x0e, 0x00, 0x00, 0x0b, 0x65, 0x78, 0x61, 0x6d, 0x70,
+    0x6c, 0x65, 0x2e, 0x63, 0x6f, 0x6d, 0x00, 0x0b, 0x00, 0x04, 0x03, 0x00,
+    0x01, 0x02, 0x00, 0x0a, 0x00, 0x16, 0x00, 0x14, 0x00, 0x1d, 0x00, 0x17,
+    0x00, 0x1e, 0x00, 0x19, 0x00, 0x18, 0x01, 0x00, 0x01, 0x01, 0x01, 0x02,
+    0x01, 0x03, 0x01, 0x04, 0x00, 0x23, 0x00, 0x00, 0x00, 0x10, 0x00, 0x0e,
+    0x00, 0x0c, 0x02, 0x68, 0x32, 0x08, 0x68, 0x74, 0x74, 0x70, 0x2f, 0x31,
+    0x2e, 0x31, 0x00, 0x16, 0x00, 0x00, 0x00, 0x17, 0x00, 0x00, 0x00, 0x0d,
+    0x00, 0x2a, 0x00, 0x28, 0x04, 0x03, 0x05, 0x03, 0x06, 0x03, 0x08, 0x07,
+    0x08, 0x08, 0x08, 0x09, 0x08, 0x0a, 0x08, 0x0b, 0x08, 0x04, 0x08, 0x05,
+    0x08, 0x06, 0x04, 0x01, 0x05, 0x01, 0x06, 0x01, 0x03, 0x03, 0x03, 0x01,
+    0x03, 0x02, 0x04, 0x02, 0x05, 0x02, 0x06, 0x02, 0x00, 0x2b, 0x00, 0x05,
+    0x04, 0x03, 0x04, 0x03, 0x03, 0x00, 0x2d, 0x00, 0x02, 0x01, 0x01, 0x00,
+    0x33, 0x00, 0x26, 0x00, 0x24, 0x00, 0x1d, 0x00, 0x20, 0x90, 0xeb, 0x6a,
+    0xde, 0x82, 0x9e, 0x8d, 0xdc, 0x35, 0x67, 0x86, 0xce, 0xa4, 0x6e, 0x91,
+    0xa1, 0x24, 0xf9, 0xbf, 0x0c, 0xd7, 0xa2, 0x3e, 0x6a, 0xc9, 0x44, 0x8e,
+    0xaf, 0x8b, 0x42, 0x3f, 0x6e, 0x00, 0x15, 0x00, 0xd0, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00
+};
+
+static const uint8_t server_hello_13[] =
+{
+    0x16, 0x03, 0x03, 0x00, 0x7a, 0x02, 0x00, 0x00, 0x76, 0x03, 0x03, 0x67,
+    0x0d, 0xfc, 0x8d, 0x0f, 0xd8, 0xd5, 0x3a, 0xf3, 0x51, 0xa5, 0xea, 0xc6,
+    0x55, 0x9d, 0xd8, 0xeb, 0x99, 0xbf, 0x8c, 0x25, 0xb3, 0x63, 0xeb, 0xb7,
+    0x21, 0x22, 0x1f, 0x06, 0x04, 0xf6, 0xbc, 0x20, 0x16, 0x6e, 0xec, 0x07,
+    0x40, 0x97, 0xbd, 0xd9, 0x03, 0x46, 0x54, 0x8b, 0xe7, 0xc0, 0x2f, 0x6c,
+    0x32, 0x43, 0x1d, 0x7c, 0xd1, 0xd8, 0xd3, 0x3b, 0x9c, 0x92, 0x90, 0x94,
+    0x4b, 0x91, 0x71, 0xf0, 0x13, 0x02, 0x00, 0x00, 0x2e, 0x00, 0x2b, 0x00,
+    0x02, 0x03, 0x04, 0x00, 0x33, 0x00, 0x24, 0x00, 0x1d, 0x00, 0x20, 0xa3,
+    0x79, 0x22, 0x1b, 0x74, 0x25, 0xe9, 0x57, 0xa3, 0x88, 0x59, 0x2a, 0xf9,
+    0x8a, 0x39, 0x8c, 0x47, 0xf7, 0x17, 0x33, 0x49, 0x71, 0x01, 0xf3, 0x61,
+    0xa3, 0x9a, 0xa6, 0x2d, 0x6d, 0xb7, 0x7c
+};
+
+static const uint8_t client_hello_12[] =
+{
+    0x16, 0x03, 0x01, 0x00, 0xc3, 0x01, 0x00, 0x00, 0xbf, 0x03, 0x03, 0x7c,
+    0x38, 0x9e, 0x8e, 0x06, 0x63, 0x32, 0x74, 0x8e, 0xb4, 0x7d, 0x10, 0xee,
+    0xcd, 0x72, 0x51, 0xb6, 0x25, 0x55, 0x62, 0xad, 0xb1, 0x4b, 0xc5, 0x9c,
+    0x75, 0xb1, 0x63, 0x3c, 0x9b, 0x7a, 0x93, 0x00, 0x00, 0x1e, 0xc0, 0x2c,
+    0xc0, 0x30, 0xc0, 0x2b, 0xc0, 0x2f, 0xcc, 0xa9, 0xcc, 0xa8, 0xc0, 0x24,
+    0xc0, 0x28, 0xc0, 0x23, 0xc0, 0x27, 0x00, 0x9f, 0x00, 0x9e, 0x00, 0x6b,
+    0x00, 0x67, 0x00, 0xff, 0x01, 0x00, 0x00, 0x78, 0x00, 0x00, 0x00, 0x10,
+    0x00, 0x0e, 0x00, 0x00, 0x0b, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65,
+    0x2e, 0x63, 0x6f, 0x6d, 0x00, 0x0b, 0x00, 0x04, 0x03, 0x00, 0x01, 0x02,
+    0x00, 0x0a, 0x00, 0x0c, 0x00, 0x0a, 0x00, 0x1d, 0x00, 0x17, 0x00, 0x1e,
+    0x00, 0x19, 0x00, 0x18, 0x00, 0x23, 0x00, 0x00, 0x00, 0x10, 0x00, 0x0e,
+    0x00, 0x0c, 0x02, 0x68, 0x32, 0x08, 0x68, 0x74, 0x74, 0x70, 0x2f, 0x31,
+    0x2e, 0x31, 0x00, 0x16, 0x00, 0x00, 0x00, 0x17, 0x00, 0x00, 0x00, 0x0d,
+    0x00, 0x2a, 0x00, 0x28, 0x04, 0x03, 0x05, 0x03, 0x06, 0x03, 0x08, 0x07,
+    0x08, 0x08, 0x08, 0x09, 0x08, 0x0a, 0x08, 0x0b, 0x08, 0x04, 0x08, 0x05,
+    0x08, 0x06, 0x04, 0x01, 0x05, 0x01, 0x06, 0x01, 0x03, 0x03, 0x03, 0x01,
+    0x03, 0x02, 0x04, 0x02, 0x05, 0x02, 0x06, 0x02
+};
+
+static const uint8_t server_hello_12[] =
+{
+    0x16, 0x03, 0x03, 0x00, 0x4a, 0x02, 0x00, 0x00, 0x46, 0x03, 0x03, 0xb1,
+    0x18, 0x78, 0xde, 0x1d, 0x98, 0x3d, 0x6e, 0xe4, 0x52, 0xd6, 0x4b, 0x8d,
+    0x8c, 0xb9, 0x46, 0xc6, 0x97, 0x6b, 0x9b, 0x66, 0x04, 0x07, 0xd4, 0x44,
+    0x4f, 0x57, 0x4e, 0x47, 0x52, 0x44, 0x01, 0x00, 0xc0, 0x2c, 0x00, 0x00,
+    0x1e, 0xff, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0b, 0x00, 0x04, 0x03, 0x00,
+    0x01, 0x02, 0x00, 0x23, 0x00, 0x00, 0x00, 0x10, 0x00, 0x05, 0x00, 0x03,
+    0x02, 0x68, 0x32, 0x00, 0x17, 0x00, 0x00
+};
+
+struct KnownHellos
+{
+    const char* name;
+    const uint8_t* client;
+    size_t client_len;
+    const uint8_t* server;
+    size_t server_len;
+    TlsFingerprints expected;
+};
+
+static KnownHellos known[] =
+{
+    {
+        "tls 1.3", client_hello_13, sizeof(client_hello_13),
+        server_hello_13, sizeof(server_hello_13),
+        {
+            "304734bb1c086c3453b387400cf83f11",
+            "t13d1812h2_85036bcba153_d41ae481755e",
+            "15af977ce25de452b96affa2addb1036",
+            "t130200_1302_a56c5b993250"
+        }
+    },
+    {
+        "tls 1.2", client_hello_12, sizeof(client_hello_12),
+        server_hello_12, sizeof(server_hello_12),
+        {
+            "104774240db569f8f87b1a28206b25e5",
+            "t12d1508h2_d68b136fe8d9_e7e480e5a997",
+            "e195432758194ce2d482396b82e0d48e",
+            "t1205h2_c02c_1ece00aee4e9"
+        }
+    }
+};
+
+static bool same(const char* what, const char* name, const char* got, const char* want)
+{
+    if (!strcmp(got, want))
+        return true;
+
+    printf("%s %s: got %s, expected %s\n", name, what, got, want);
+    return false;
+}
+
+static bool check(const KnownHellos& k)
+{
+    TlsFingerprints fp;
+
+    if (tls_client_fingerprint(k.client, k.client_len, fp) != TLS_HELLO_DONE ||
+        tls_server_fingerprint(k.server, k.server_len, fp) != TLS_HELLO_DONE)
+    {
+        printf("%s: hellos not fingerprinted\n", k.name);
+        return false;
+    }
+
+    bool ok = same("ja3", k.name, fp.ja3, k.expected.ja3);
+    ok = same("ja4", k.name, fp.ja4, k.expected.ja4) && ok;
+    ok = same("ja3s", k.name, fp.ja3s, k.expected.ja3s) && ok;
+    return same("ja4s", k.name, fp.ja4s, k.expected.ja4s) && ok;
+}
+
+typedef TlsHello (*Fingerprint)(const uint8_t*, size_t, TlsFingerprints&);
+
+static double run(Fingerprint f, const uint8_t* data, size_t len, size_t iterations)
+{
+    TlsFingerprints fp;
+    uint64_t start = bench_now_ns();
+
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        f(data, len, fp);
+        bench_keep(fp);
+    }
+
+    return (double)(bench_now_ns() - start) / iterations;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+
+    for (auto& k : known)
+        if (!check(k))
+            return 1;
+
+    printf("known answers ok\n");
+
+    for (auto& k : known)
+    {
+        double client_ns = run(tls_client_fingerprint, k.client, k.client_len, iterations);
+        double server_ns = run(tls_server_fingerprint, k.server, k.server_len, iterations);
+
+        printf("%-8s client hello %4zu bytes %7.1f ns  server hello %4zu bytes %7.1f ns\n",
+            k.name, k.client_len, client_ns, k.server_len, server_ns);
+    }
+
+    return 0;
+}
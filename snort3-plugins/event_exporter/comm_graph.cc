@@ -0,0 +1,215 @@
+//--------------------------------------------------------------------------
+// comm_graph.cc - Host to host communication graph snapshots
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "comm_graph.h"
+
+#include <chrono>
+#include <map>
+
+using namespace std;
+using json = nlohmann::json;
+
+GraphPegs graph_pegs;
+
+constexpr size_t CommGraph::CHUNK;
+
+// the merged table starts here and doubles as needed
+static const size_t MERGED_CAPACITY = 4096;
+
+static uint64_t now_ms()
+{
+    return chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static size_t edge_hash(const EdgeKey& k)
+{
+    uint64_t h = k.src.lo * 0x9e3779b97f4a7c15ULL;
+    h ^= k.src.hi * 0xc2b2ae3d27d4eb4fULL;
+    h ^= k.dst.lo * 0x165667b19e3779f9ULL;
+    h ^= k.dst.hi * 0xd6e8feb86659fd93ULL;
+    h ^= ((uint64_t)k.port << 8 | k.protocol) * 0xff51afd7ed558ccdULL;
+    return h ^ (h >> 31);
+}
+
+//-------------------------------------------------------------------------
+// EdgeTable
+//-------------------------------------------------------------------------
+
+EdgeTable::EdgeTable(size_t capacity, bool g) : grows(g)
+{
+    size_t n = 16;
+
+    while (n < capacity)
+        n <<= 1;
+
+    slots.reset(new Edge[n]());
+    mask = n - 1;
+}
+
+bool EdgeTable::add(const EdgeKey& k, uint32_t connections, uint64_t packets, uint64_t bytes)
+{
+    for (size_t i = edge_hash(k); ; ++i)
+    {
+        Edge& e = slots[i & mask];
+
+        if (!e.connections)
+        {
+            // a quarter stays free so probes stay short
+            if (used + 1 > (mask + 1) / 4 * 3)
+            {
+                if (!grows)
+                    return false;
+
+                grow();
+                return add(k, connections, packets, bytes);
+            }
+            e = { k, connections, packets, bytes };
+            ++used;
+            return true;
+        }
+
+        if (e.key == k)
+        {
+            e.connections += connections;
+            e.packets += packets;
+            e.bytes += bytes;
+            return true;
+        }
+    }
+}
+
+void EdgeTable::grow()
+{
+    unique_ptr<Edge[]> old(new Edge[(mask + 1) * 2]());
+    old.swap(slots);
+
+    size_t n = mask + 1;
+    mask = n * 2 - 1;
+    used = 0;
+
+    for (size_t i = 0; i < n; ++i)
+        if (old[i].connections)
+            add(old[i].key, old[i].connections, old[i].packets, old[i].bytes);
+}
+
+void EdgeTable::clear()
+{
+    if (!used)
+        return;
+
+    for (size_t i = 0; i <= mask; ++i)
+        slots[i].connections = 0;
+
+    used = 0;
+}
+
+//-------------------------------------------------------------------------
+// CommGraph
+//-------------------------------------------------------------------------
+
+CommGraph::CommGraph(unsigned n, size_t edges)
+    : shards(new Shard[n]), threads(n), spare(new EdgeTable(edges * 4 / 3, false)),
+      merged(MERGED_CAPACITY, true), started(now_ms())
+{
+    for (unsigned i = 0; i < n; ++i)
+        shards[i].table.reset(new EdgeTable(edges * 4 / 3, false));
+}
+
+void CommGraph::add(unsigned thread, const EdgeKey& k, uint64_t packets, uint64_t bytes)
+{
+    if (thread >= threads)
+        return;
+
+    Shard& s = shards[thread];
+    lock_guard<mutex> lock(s.lock);
+
+    if (!s.table->add(k, 1, packets, bytes))
+        s.lost++;
+}
+
+void CommGraph::snapshot(vector<json>& parts)
+{
+    uint64_t lost = 0;
+
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        Shard& s = shards[i];
+
+        // the packet thread only waits for a pointer swap
+        {
+            lock_guard<mutex> lock(s.lock);
+            s.table.swap(spare);
+            lost += s.lost;
+            s.lost = 0;
+        }
+
+        spare->for_each([this](const Edge& e)
+            { merged.add(e.key, e.connections, e.packets, e.bytes); });
+
+        spare->clear();
+    }
+
+    uint64_t ended = now_ms();
+    size_t total = merged.size();
+    size_t count = total ? (total + CHUNK - 1) / CHUNK : 1;
+
+    map<RouteAddr, unsigned> index;
+    json part;
+
+    auto start_part = [&]()
+    {
+        index.clear();
+        part = json();
+        part["type"] = "graph";
+        part["timestamp"] = ended;
+        part["interval_start"] = started;
+        part["interval_end"] = ended;
+        part["part"] = parts.size();
+        part["parts"] = count;
+        part["edges_lost"] = lost;
+        part["nodes"] = json::array();
+        part["edges"] = json::array();
+    };
+
+    auto node = [&](const RouteAddr& a)
+    {
+        auto it = index.find(a);
+
+        if (it != index.end())
+            return it->second;
+
+        unsigned n = index.size();
+        index.emplace(a, n);
+        part["nodes"].push_back(a.to_string());
+        return n;
+    };
+
+    start_part();
+
+    merged.for_each([&](const Edge& e)
+    {
+        if (part["edges"].size() == CHUNK)
+        {
+            parts.emplace_back(std::move(part));
+            start_part();
+        }
+
+        part["edges"].push_back({ node(e.key.src), node(e.key.dst), e.key.port, e.key.protocol,
+            e.connections, e.packets, e.bytes });
+    });
+
+    parts.emplace_back(std::move(part));
+
+    graph_pegs.snapshots.fetch_add(1, memory_order_relaxed);
+    graph_pegs.edges.fetch_add(total, memory_order_relaxed);
+    graph_pegs.edges_lost.fetch_add(lost, memory_order_relaxed);
+
+    merged.clear();
+    started = ended;
+}
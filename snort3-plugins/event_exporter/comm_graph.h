@@ -0,0 +1,141 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// comm_graph.h - Host to host communication graph snapshots
+
+#ifndef COMM_GRAPH_H
+#define COMM_GRAPH_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "event_router.h"
+
+//-------------------------------------------------------------------------
+// Each packet thread adds every flow it ends to an open addressed table of
+// (client, server, server port, protocol) edges with connection, packet
+// and byte counts.  The table is sized at configure time and never grows
+// on the packet thread; edges that do not fit are counted and lost.
+//
+// Once an interval the exporter's timer thread swaps each thread's table for
+// an empty one, merges them and exports the graph in parts of at most
+// CHUNK edges.  Each part lists its hosts once and refers to them by index:
+//
+//     "nodes": [ "10.0.0.5", "10.0.0.9", ... ],
+//     "edges": [ [ src, dst, port, proto, connections, packets, bytes ], ... ]
+//
+// A flow counts in the interval it ends in.
+//-------------------------------------------------------------------------
+
+struct EdgeKey
+{
+    RouteAddr src;
+    RouteAddr dst;
+    uint16_t port;
+    uint8_t protocol;
+
+    bool operator==(const EdgeKey& that) const
+    {
+        return src == that.src && dst == that.dst &&
+            port == that.port && protocol == that.protocol;
+    }
+};
+
+struct Edge
+{
+    EdgeKey key;
+    uint32_t connections;
+    uint64_t packets;
+    uint64_t bytes;
+};
+
+class EdgeTable
+{
+public:
+    // capacity is rounded up to a power of 2; the table holds 3/4 of it
+    EdgeTable(size_t capacity, bool grows);
+
+    // false if the edge is new and the table is full
+    bool add(const EdgeKey&, uint32_t connections, uint64_t packets, uint64_t bytes);
+
+    void clear();
+
+    size_t size() const
+    { return used; }
+
+    template<typename F>
+    void for_each(F f) const
+    {
+        for (size_t i = 0; i <= mask; ++i)
+            if (slots[i].connections)
+                f(slots[i]);
+    }
+
+private:
+    void grow();
+
+    std::unique_ptr<Edge[]> slots;
+    size_t mask;
+    size_t used = 0;
+    const bool grows;
+};
+
+// totals for the module pegs
+struct GraphPegs
+{
+    std::atomic<uint64_t> snapshots { 0 };
+    std::atomic<uint64_t> edges { 0 };
+    std::atomic<uint64_t> edges_lost { 0 };
+};
+
+extern GraphPegs graph_pegs;
+
+class CommGraph
+{
+public:
+    static constexpr size_t CHUNK = 8192;
+
+    // edges is the table size of each packet thread
+    CommGraph(unsigned threads, size_t edges);
+
+    // called from the packet thread at flow end
+    void add(unsigned thread, const EdgeKey&, uint64_t packets, uint64_t bytes);
+
+    // called from one sender thread; the parts of the graph built since
+    // the last snapshot, as records to encode
+    void snapshot(std::vector<nlohmann::json>& parts);
+
+private:
+    struct alignas(64) Shard
+    {
+        std::mutex lock;
+        std::unique_ptr<EdgeTable> table;
+        uint64_t lost = 0;
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    const unsigned threads;
+
+    // under snapshot() only
+    std::unique_ptr<EdgeTable> spare;
+    EdgeTable merged;
+    uint64_t started;
+};
+
+#endif
@@ -0,0 +1,153 @@
+//--------------------------------------------------------------------------
+// dd_sketch.cc - Mergeable quantile sketch with relative accuracy
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dd_sketch.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+constexpr double DDSketch::ALPHA;
+constexpr unsigned DDSketch::MAX_BINS;
+
+double DDSketch::gamma()
+{
+    return (1 + ALPHA) / (1 - ALPHA);
+}
+
+static const double LOG_GAMMA = log(DDSketch::gamma());
+
+int32_t DDSketch::index(double v)
+{
+    return (int32_t)ceil(log(v) / LOG_GAMMA);
+}
+
+void DDSketch::add(double v, float weight)
+{
+    if (v < 1)
+        zero += weight;
+    else
+    {
+        add_bin(index(v), weight);
+        total += weight;
+    }
+}
+
+void DDSketch::add_bin(int32_t i, float weight)
+{
+    if (bins.empty())
+    {
+        offset = i;
+        bins.assign(1, weight);
+        return;
+    }
+
+    int32_t hi = offset + (int32_t)bins.size() - 1;
+
+    if (i < offset)
+    {
+        // too far below the top; it counts in the lowest bin kept
+        i = max(i, hi - (int32_t)MAX_BINS + 1);
+
+        if (i < offset)
+        {
+            bins.insert(bins.begin(), offset - i, 0);
+            offset = i;
+        }
+    }
+    else if (i > hi)
+    {
+        if (i - offset + 1 > (int32_t)MAX_BINS)
+        {
+            // fold the lowest bins into the new lowest
+            int32_t lo = i - (int32_t)MAX_BINS + 1;
+            vector<float> folded(MAX_BINS, 0);
+
+            for (size_t j = 0; j < bins.size(); ++j)
+                folded[max(offset + (int32_t)j, lo) - lo] += bins[j];
+
+            bins.swap(folded);
+            offset = lo;
+        }
+        else
+            bins.resize(i - offset + 1, 0);
+    }
+    bins[i - offset] += weight;
+}
+
+void DDSketch::merge(const DDSketch& that)
+{
+    zero += that.zero;
+    total += that.total;
+
+    for (size_t j = 0; j < that.bins.size(); ++j)
+        if (that.bins[j] > 0)
+            add_bin(that.offset + (int32_t)j, that.bins[j]);
+}
+
+void DDSketch::scale(float f)
+{
+    zero *= f;
+    total *= f;
+
+    for (auto& b : bins)
+        b *= f;
+}
+
+double DDSketch::quantile(double q) const
+{
+    double n = count();
+
+    if (n <= 0)
+        return 0;
+
+    double rank = q * n;
+    double seen = zero;
+
+    if (rank < seen || bins.empty())
+        return 0;
+
+    for (size_t j = 0; j < bins.size(); ++j)
+    {
+        seen += bins[j];
+
+        // the middle of the bin, within ALPHA of anything in it
+        if (seen >= rank)
+            return 2 * pow(gamma(), offset + (int32_t)j) / (gamma() + 1);
+    }
+    return 2 * pow(gamma(), offset + (int32_t)bins.size() - 1) / (gamma() + 1);
+}
+
+SketchCdf::SketchCdf(const DDSketch& s)
+    : offset(s.get_offset()), cum(s.get_bins()), zero(s.get_zero())
+{
+    for (size_t j = 1; j < cum.size(); ++j)
+        cum[j] += cum[j - 1];
+}
+
+double SketchCdf::rank(double v) const
+{
+    double n = count();
+
+    if (n <= 0)
+        return 0;
+
+    if (v < 1 || cum.empty())
+        return zero / n;
+
+    int32_t i = DDSketch::index(v) - offset;
+
+    if (i < 0)
+        return zero / n;
+
+    if (i >= (int32_t)cum.size())
+        return 1;
+
+    return (zero + cum[i]) / n;
+}
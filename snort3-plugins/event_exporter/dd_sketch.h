@@ -0,0 +1,90 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// dd_sketch.h - Mergeable quantile sketch with relative accuracy
+
+#ifndef DD_SKETCH_H
+#define DD_SKETCH_H
+
+#include <cstdint>
+#include <vector>
+
+//-------------------------------------------------------------------------
+// DDSketch: value v >= 1 is counted in bin ceil(log(v) / log(gamma)), with
+// gamma = (1 + ALPHA) / (1 - ALPHA), so any quantile comes back within
+// ALPHA of the true value.  Values below 1 share a bin of their own.  Two
+// sketches merge by adding bins, so sensors and intervals combine exactly.
+// Counts are floats so old data can decay; past MAX_BINS the lowest bins
+// are folded together, losing accuracy only at the bottom.
+//-------------------------------------------------------------------------
+
+class DDSketch
+{
+public:
+    static constexpr double ALPHA = 0.02;
+    static constexpr unsigned MAX_BINS = 1024;
+
+    static double gamma();
+
+    void add(double v, float weight = 1);
+    void merge(const DDSketch&);
+
+    // multiplies every count, for decay
+    void scale(float);
+
+    double count() const
+    { return zero + total; }
+
+    double quantile(double q) const;
+
+    // the index of bins[0], the bins, and the weight below 1
+    int32_t get_offset() const
+    { return offset; }
+
+    const std::vector<float>& get_bins() const
+    { return bins; }
+
+    float get_zero() const
+    { return zero; }
+
+    static int32_t index(double v);
+
+private:
+    void add_bin(int32_t i, float weight);
+
+    int32_t offset = 0;
+    std::vector<float> bins;
+    float zero = 0;
+    double total = 0;
+};
+
+// a sketch turned into cumulative counts, for constant time ranks
+class SketchCdf
+{
+public:
+    SketchCdf() = default;
+    SketchCdf(const DDSketch&);
+
+    double count() const
+    { return zero + (cum.empty() ? 0 : cum.back()); }
+
+    // share of the weight at or below v
+    double rank(double v) const;
+
+private:
+    int32_t offset = 0;
+    std::vector<float> cum;
+    float zero = 0;
+};
+
+#endif
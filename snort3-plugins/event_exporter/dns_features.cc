@@ -0,0 +1,336 @@
+//--------------------------------------------------------------------------
+// dns_features.cc - Query name features for DGA and tunnelling prefilters
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dns_features.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+DnsPegs dns_pegs;
+
+enum ByteClass : uint8_t
+{
+    C_LETTER = 0x01,
+    C_VOWEL = 0x02,
+    C_DIGIT = 0x04,
+    C_HYPHEN = 0x08,
+    C_DOT = 0x10,
+    C_OTHER = 0x20
+};
+
+// a-z, 0-9, hyphen, underscore, then everything else
+static const unsigned SYMBOLS = 39;
+static const uint8_t NO_SYMBOL = 0xff;
+
+// names are at most 255 bytes, so are their counts
+static const size_t MAX_NAME = 255;
+
+struct ScanTables
+{
+    uint8_t cls[256];
+    uint8_t sym[256];
+    float clogc[MAX_NAME + 1];
+
+    ScanTables();
+};
+
+ScanTables::ScanTables()
+{
+    for (unsigned c = 0; c < 256; ++c)
+    {
+        cls[c] = C_OTHER;
+        sym[c] = SYMBOLS - 1;
+    }
+
+    for (unsigned c = 'a'; c <= 'z'; ++c)
+    {
+        cls[c] = cls[c - 'a' + 'A'] = C_LETTER;
+        sym[c] = sym[c - 'a' + 'A'] = c - 'a';
+    }
+
+    for (char c : { 'a', 'e', 'i', 'o', 'u' })
+    {
+        cls[(uint8_t)c] |= C_VOWEL;
+        cls[(uint8_t)c - 'a' + 'A'] |= C_VOWEL;
+    }
+
+    for (unsigned c = '0'; c <= '9'; ++c)
+    {
+        cls[c] = C_DIGIT;
+        sym[c] = 26 + c - '0';
+    }
+
+    cls['-'] = C_HYPHEN;
+    sym['-'] = 36;
+    sym['_'] = 37;
+    cls['.'] = C_DOT;
+
+    clogc[0] = 0;
+
+    for (size_t c = 1; c <= MAX_NAME; ++c)
+        clogc[c] = (float)(c * log2((double)c));
+}
+
+static const ScanTables tables;
+
+static float entropy(float sum_clogc, unsigned n)
+{
+    return n ? max((float)log2((double)n) - sum_clogc / n, 0.0f) : 0;
+}
+
+void dns_query_features(const char* name, size_t len, DnsQueryFeatures& f)
+{
+    const uint8_t* s = (const uint8_t*)name;
+
+    f = DnsQueryFeatures();
+
+    if (len && s[len - 1] == '.')
+        len--;
+
+    len = min(len, MAX_NAME);
+    f.length = len;
+
+    if (!len)
+        return;
+
+    uint8_t uni[SYMBOLS] = { };
+    uint8_t bi[SYMBOLS * SYMBOLS] = { };
+
+    // distinct bigrams, so only those are read back
+    uint16_t touched[MAX_NAME];
+    unsigned bigrams = 0, unigrams = 0;
+
+    // where the last and the one before last label start
+    size_t last = 0, before_last = 0;
+    unsigned label = 0, consonants = 0;
+    uint8_t prev = NO_SYMBOL;
+
+    f.labels = 1;
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        uint8_t c = tables.cls[s[i]];
+
+        if (c & C_DOT)
+        {
+            f.max_label = max<unsigned>(f.max_label, label);
+            f.labels++;
+            before_last = last;
+            last = i + 1;
+            label = consonants = 0;
+            prev = NO_SYMBOL;
+            continue;
+        }
+
+        label++;
+
+        if (c & C_LETTER)
+        {
+            f.letters++;
+
+            if (c & C_VOWEL)
+            {
+                f.vowels++;
+                consonants = 0;
+            }
+            else
+                f.max_consonants = max<unsigned>(f.max_consonants, ++consonants);
+        }
+        else
+        {
+            consonants = 0;
+            f.digits += (c & C_DIGIT) != 0;
+            f.hyphens += (c & C_HYPHEN) != 0;
+            f.other += (c & C_OTHER) != 0;
+        }
+
+        uint8_t sym = tables.sym[s[i]];
+        uni[sym]++;
+        unigrams++;
+
+        if (prev != NO_SYMBOL)
+        {
+            uint16_t b = prev * SYMBOLS + sym;
+
+            if (!bi[b]++)
+                touched[bigrams++] = b;
+        }
+        prev = sym;
+    }
+
+    f.max_label = max<unsigned>(f.max_label, label);
+    f.subdomain = f.labels > 2 ? before_last - 1 : 0;
+
+    float sum = 0;
+
+    for (unsigned i = 0; i < SYMBOLS; ++i)
+        sum += tables.clogc[uni[i]];
+
+    f.entropy = entropy(sum, unigrams);
+
+    unsigned pairs = 0;
+    sum = 0;
+
+    for (unsigned i = 0; i < bigrams; ++i)
+    {
+        pairs += bi[touched[i]];
+        sum += tables.clogc[bi[touched[i]]];
+    }
+
+    f.bigram_entropy = entropy(sum, pairs);
+}
+
+//-------------------------------------------------------------------------
+// answer section
+//-------------------------------------------------------------------------
+
+static const size_t DNS_HEADER = 12;
+static const uint16_t DNS_TYPE_NULL = 10;
+static const uint16_t DNS_TYPE_TXT = 16;
+
+static uint16_t get16(const uint8_t* p)
+{
+    return p[0] << 8 | p[1];
+}
+
+// moves past a name that may end in a compression pointer
+static bool skip_name(const uint8_t* msg, size_t len, size_t& at)
+{
+    while (at < len)
+    {
+        uint8_t n = msg[at];
+
+        if ((n & 0xc0) == 0xc0)
+        {
+            at += 2;
+            return at <= len;
+        }
+
+        // 0x40 and 0x80 are reserved label types
+        if (n & 0xc0)
+            return false;
+
+        at += n + 1;
+
+        if (!n)
+            return true;
+    }
+    return false;
+}
+
+bool dns_answer_sizes(const uint8_t* msg, size_t len, DnsAnswerSizes& a)
+{
+    a = DnsAnswerSizes();
+
+    if (len < DNS_HEADER || !(msg[2] & 0x80))
+        return false;
+
+    unsigned questions = get16(msg + 4);
+    unsigned answers = get16(msg + 6);
+    size_t at = DNS_HEADER;
+
+    // name, type and class
+    while (questions--)
+    {
+        if (!skip_name(msg, len, at) || (at += 4) > len)
+            return false;
+    }
+
+    // name, type, class, ttl, rdlength and rdata
+    while (answers--)
+    {
+        if (!skip_name(msg, len, at) || at + 10 > len)
+            return false;
+
+        uint16_t type = get16(msg + at);
+        size_t rdlen = get16(msg + at + 8);
+
+        at += 10 + rdlen;
+
+        if (at > len)
+            return false;
+
+        if (type == DNS_TYPE_TXT)
+            a.txt_bytes += rdlen;
+        else if (type == DNS_TYPE_NULL)
+            a.null_bytes += rdlen;
+
+        ++a.answers;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// DnsClientRates
+//-------------------------------------------------------------------------
+
+static uint64_t hash_addr(const RouteAddr& a)
+{
+    uint64_t h = a.lo * 0x9e3779b97f4a7c15ULL ^ a.hi * 0xc2b2ae3d27d4eb4fULL;
+    return h ^ (h >> 29);
+}
+
+DnsClientRates::DnsClientRates(uint32_t clients)
+{
+    uint32_t n = 1;
+
+    while (n * WAYS < clients)
+        n <<= 1;
+
+    sets.reset(new Set[n]);
+    set_mask = n - 1;
+
+    for (uint32_t i = 0; i < n; ++i)
+        for (auto& c : sets[i].ways)
+            c.used = false;
+}
+
+float DnsClientRates::count(const RouteAddr& addr, uint64_t ms)
+{
+    Set& s = sets[hash_addr(addr) & set_mask];
+    lock_guard<mutex> lock(s.lock);
+
+    const uint64_t window = ms / WINDOW;
+    Client* c = nullptr;
+
+    for (auto& w : s.ways)
+    {
+        if (w.used && w.addr == addr)
+        {
+            c = &w;
+            break;
+        }
+
+        if (!c || (c->used && (!w.used || w.window < c->window)))
+            c = &w;
+    }
+
+    if (!c->used || !(c->addr == addr))
+    {
+        if (c->used)
+            dns_pegs.clients_evicted.fetch_add(1, memory_order_relaxed);
+
+        *c = { addr, true, window, 0, 0 };
+    }
+
+    // a query stamped a little earlier on another thread counts as now
+    if (window > c->window)
+    {
+        c->previous = window == c->window + 1 ? c->current : 0;
+        c->current = 0;
+        c->window = window;
+    }
+
+    c->current++;
+
+    // the previous bucket weighted by how much of it the window still covers
+    double covered = 1 - (double)(ms % WINDOW) / WINDOW;
+    return (float)((c->previous * covered + c->current) * 1000 / WINDOW);
+}
@@ -0,0 +1,121 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// dns_features.h - Query name features for DGA and tunnelling prefilters
+
+#ifndef DNS_FEATURES_H
+#define DNS_FEATURES_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "event_router.h"
+
+//-------------------------------------------------------------------------
+// One pass over the query name with a byte class table and a symbol table
+// (letters folded to lower case, digits, hyphen, underscore, other) gives
+// the label layout, character class counts, the longest consonant run and
+// unigram and bigram counts; entropies come from a c * log2(c) table, so
+// no log is taken per query.  Bigrams do not cross label boundaries.
+//
+// Generated names are long, digit heavy and near uniform in their letters;
+// tunnels carry long, high entropy subdomains under one registered name.
+//-------------------------------------------------------------------------
+
+struct DnsQueryFeatures
+{
+    uint16_t length = 0;        // without the trailing dot
+    uint8_t labels = 0;
+    uint8_t max_label = 0;
+    uint16_t subdomain = 0;     // bytes before the last two labels
+
+    uint16_t letters = 0;
+    uint16_t vowels = 0;
+    uint16_t digits = 0;
+    uint16_t hyphens = 0;
+    uint16_t other = 0;         // underscores and anything not a hostname byte
+    uint8_t max_consonants = 0; // longest run within a label
+
+    float entropy = 0;          // bits per symbol
+    float bigram_entropy = 0;   // bits per bigram
+};
+
+void dns_query_features(const char* name, size_t len, DnsQueryFeatures&);
+
+//-------------------------------------------------------------------------
+// RDATA sizes of the answer section of a response, read from the message
+// itself; TXT and NULL answers are where tunnels put their downstream
+// data.  Names are skipped, never followed, so compression costs nothing.
+//-------------------------------------------------------------------------
+
+struct DnsAnswerSizes
+{
+    uint16_t answers = 0;
+    uint32_t txt_bytes = 0;     // RDATA of TXT (16) answers
+    uint32_t null_bytes = 0;    // RDATA of NULL (10) answers
+};
+
+// false if msg is not a response or ends before its last answer
+bool dns_answer_sizes(const uint8_t* msg, size_t len, DnsAnswerSizes&);
+
+// totals for the module pegs
+struct DnsPegs
+{
+    std::atomic<uint64_t> queries { 0 };
+    std::atomic<uint64_t> clients_evicted { 0 };
+};
+
+extern DnsPegs dns_pegs;
+
+//-------------------------------------------------------------------------
+// Queries per second per client over a sliding window of two buckets.  A
+// client's queries are spread over the packet threads by source port, so
+// the table is shared; each set of WAYS clients has a lock, and the least
+// recently seen client of a full set makes room.
+//-------------------------------------------------------------------------
+
+class DnsClientRates
+{
+public:
+    DnsClientRates(uint32_t clients);
+
+    // counts a query at ms and returns the client's current rate
+    float count(const RouteAddr& client, uint64_t ms);
+
+private:
+    static constexpr unsigned WAYS = 4;
+    static constexpr uint64_t WINDOW = 10000;   // ms
+
+    struct Client
+    {
+        RouteAddr addr;
+        bool used;
+        uint64_t window;
+        uint32_t current;
+        uint32_t previous;
+    };
+
+    struct alignas(64) Set
+    {
+        std::mutex lock;
+        Client ways[WAYS];
+    };
+
+    std::unique_ptr<Set[]> sets;
+    uint32_t set_mask;
+};
+
+#endif
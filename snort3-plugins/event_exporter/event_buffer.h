@@ -0,0 +1,116 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// event_buffer.h - Reference counted encoded event shared by sinks
+
+#ifndef EVENT_BUFFER_H
+#define EVENT_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+//-------------------------------------------------------------------------
+// An event is encoded once on the packet thread.  When a sender takes it
+// from the ring, the encoded bytes move into an EventBuffer that every sink
+// of that sender shares; the last reference (which may be held by a
+// ZeroMQ I/O thread) frees it.
+//-------------------------------------------------------------------------
+
+class EventBuffer
+{
+public:
+    // the new buffer holds one reference
+    static EventBuffer* create(std::string&& bytes, uint32_t topic)
+    { return new EventBuffer(std::move(bytes), topic); }
+
+    void ref()
+    { refs.fetch_add(1, std::memory_order_relaxed); }
+
+    void unref()
+    {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+
+    const char* data() const
+    { return bytes.data(); }
+
+    size_t size() const
+    { return bytes.size(); }
+
+    // see event_topics.h
+    uint32_t get_topic() const
+    { return topic; }
+
+private:
+    EventBuffer(std::string&& b, uint32_t t) : bytes(std::move(b)), topic(t) { }
+
+    std::atomic<unsigned> refs { 1 };
+    const std::string bytes;
+    const uint32_t topic;
+};
+
+class EventRef
+{
+public:
+    EventRef() = default;
+
+    explicit EventRef(std::string&& bytes, uint32_t topic = 0)
+        : buf(EventBuffer::create(std::move(bytes), topic)) { }
+
+    EventRef(const EventRef& that) : buf(that.buf)
+    {
+        if (buf)
+            buf->ref();
+    }
+
+    EventRef(EventRef&& that) noexcept : buf(that.buf)
+    { that.buf = nullptr; }
+
+    EventRef& operator=(EventRef that) noexcept
+    {
+        std::swap(buf, that.buf);
+        return *this;
+    }
+
+    ~EventRef()
+    {
+        if (buf)
+            buf->unref();
+    }
+
+    // hands the reference to a caller that will unref() it
+    EventBuffer* release()
+    {
+        EventBuffer* b = buf;
+        buf = nullptr;
+        return b;
+    }
+
+    const char* data() const
+    { return buf->data(); }
+
+    size_t size() const
+    { return buf->size(); }
+
+    uint32_t get_topic() const
+    { return buf->get_topic(); }
+
+private:
+    EventBuffer* buf = nullptr;
+};
+
+#endif
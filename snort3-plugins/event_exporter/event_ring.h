@@ -0,0 +1,170 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// event_ring.h - Bounded single producer ring of encoded events
+
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------
+// Rings are filled by one packet thread and constructed by that thread, so
+// their slots are first touched (and placed) on its NUMA node.  Consumers
+// claim contiguous segments with a CAS on the tail, which lets an idle
+// sender steal a segment from a ring assigned to a busy one.  Each slot
+// carries a sequence number so the producer never reuses a slot that a
+// consumer is still sending from.
+//-------------------------------------------------------------------------
+
+class EventRing
+{
+public:
+    struct Segment
+    {
+        size_t begin = 0;
+        size_t end = 0;
+
+        bool empty() const
+        { return begin == end; }
+    };
+
+    EventRing(size_t capacity, int node, unsigned shard)
+        : slots(round_up(capacity)), mask(slots.size() - 1), node(node), shard(shard)
+    {
+        for (size_t i = 0; i < slots.size(); ++i)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    // producer side; routes has a bit set for each sink that gets the event
+    bool push(std::string&& event, uint64_t routes, uint32_t topic = 0)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[h & mask];
+
+        if (slot.seq.load(std::memory_order_acquire) != h)
+            return false;
+
+        slot.event = std::move(event);
+        slot.routes = routes;
+        slot.topic = topic;
+        slot.seq.store(h + 1, std::memory_order_release);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side; any number of consumers may claim concurrently
+    bool claim(size_t max, Segment& seg)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            size_t h = head.load(std::memory_order_acquire);
+
+            if (t == h)
+                return false;
+
+            size_t n = h - t < max ? h - t : max;
+
+            if (tail.compare_exchange_weak(t, t + n, std::memory_order_acq_rel,
+                std::memory_order_relaxed))
+            {
+                seg.begin = t;
+                seg.end = t + n;
+                return true;
+            }
+        }
+    }
+
+    std::string& at(size_t pos)
+    { return slots[pos & mask].event; }
+
+    uint64_t routes_at(size_t pos) const
+    { return slots[pos & mask].routes; }
+
+    uint32_t topic_at(size_t pos) const
+    { return slots[pos & mask].topic; }
+
+    // hand a sent slot back to the producer
+    void release(size_t pos)
+    {
+        Slot& slot = slots[pos & mask];
+        std::string().swap(slot.event);
+        slot.seq.store(pos + slots.size(), std::memory_order_release);
+    }
+
+    // exclusive drain rights, used when segments of one ring must not be
+    // sent concurrently (flow sharding)
+    bool try_lease()
+    { return !leased.exchange(true, std::memory_order_acquire); }
+
+    void end_lease()
+    { leased.store(false, std::memory_order_release); }
+
+    size_t size() const
+    {
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t h = head.load(std::memory_order_acquire);
+        return h > t ? h - t : 0;
+    }
+
+    bool empty() const
+    { return size() == 0; }
+
+    int get_node() const
+    { return node; }
+
+    unsigned get_shard() const
+    { return shard; }
+
+    void close()
+    { closed.store(true, std::memory_order_release); }
+
+    bool is_closed() const
+    { return closed.load(std::memory_order_acquire); }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> seq;
+        std::string event;
+        uint64_t routes = 0;
+        uint32_t topic = 0;
+    };
+
+    static size_t round_up(size_t n)
+    {
+        size_t c = 2;
+        while (c < n)
+            c <<= 1;
+        return c;
+    }
+
+private:
+    std::vector<Slot> slots;
+    const size_t mask;
+    const int node;
+    const unsigned shard;
+
+    alignas(64) std::atomic<size_t> head { 0 };
+    alignas(64) std::atomic<size_t> tail { 0 };
+    std::atomic<bool> leased { false };
+    std::atomic<bool> closed { false };
+};
+
+#endif
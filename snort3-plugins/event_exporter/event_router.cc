@@ -0,0 +1,313 @@
+//--------------------------------------------------------------------------
+// event_router.cc - Per-sink routing filters compiled into a decision table
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "event_router.h"
+
+#include <arpa/inet.h>
+#include <endian.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include "ai_event_exporter.h"
+
+using namespace std;
+
+RouteAddr RouteAddr::from_bytes(const void* p)
+{
+    uint64_t words[2];
+    memcpy(words, p, sizeof(words));
+    return { be64toh(words[0]), be64toh(words[1]) };
+}
+
+string RouteAddr::to_string() const
+{
+    uint64_t words[2] = { htobe64(hi), htobe64(lo) };
+    const uint8_t* bytes = (const uint8_t*)words;
+    char buf[INET6_ADDRSTRLEN];
+
+    if (!hi && (lo >> 32) == 0xffff)
+        inet_ntop(AF_INET, bytes + 12, buf, sizeof(buf));
+    else
+        inet_ntop(AF_INET6, bytes, buf, sizeof(buf));
+
+    return buf;
+}
+
+//-------------------------------------------------------------------------
+// filter parsing
+//-------------------------------------------------------------------------
+
+static vector<string> split_list(const string& list)
+{
+    string s = list;
+    replace(s.begin(), s.end(), ',', ' ');
+
+    istringstream in(s);
+    vector<string> words;
+    string w;
+
+    while (in >> w)
+        words.emplace_back(w);
+
+    return words;
+}
+
+static bool parse_number(const string& s, unsigned long max, unsigned long& v)
+{
+    if (s.empty() || s[0] < '0' || s[0] > '9')
+        return false;
+
+    char* end;
+    v = strtoul(s.c_str(), &end, 10);
+    return !*end && v <= max;
+}
+
+const char* const event_type_names[EVENT_TYPE_MAX] = { "alert", "flow", "flow_end", "beacon", "graph",
+    "baseline", "profile", "dns" };
+
+bool parse_route_types(const string& list, uint32_t& types)
+{
+    types = 0;
+
+    for (auto& w : split_list(list))
+    {
+        unsigned t = 0;
+
+        while (t < EVENT_TYPE_MAX && w != event_type_names[t])
+            ++t;
+
+        if (t == EVENT_TYPE_MAX)
+            return false;
+
+        types |= 1u << t;
+    }
+    return true;
+}
+
+bool parse_route_protocols(const string& list, vector<uint8_t>& protos)
+{
+    static const struct { const char* name; uint8_t proto; } names[] =
+    {
+        { "icmp", 1 }, { "tcp", 6 }, { "udp", 17 }, { "icmp6", 58 },
+    };
+    protos.clear();
+
+    for (auto& w : split_list(list))
+    {
+        unsigned long v;
+        bool known = false;
+
+        for (auto& n : names)
+        {
+            if (w == n.name)
+            {
+                protos.emplace_back(n.proto);
+                known = true;
+            }
+        }
+
+        if (known)
+            continue;
+
+        if (!parse_number(w, UCHAR_MAX, v))
+            return false;
+
+        protos.emplace_back((uint8_t)v);
+    }
+    return true;
+}
+
+bool parse_route_sids(const string& list, vector<pair<uint32_t, uint32_t>>& sids)
+{
+    sids.clear();
+
+    for (auto& w : split_list(list))
+    {
+        size_t colon = w.find(':');
+        unsigned long lo, hi;
+
+        if (!parse_number(w.substr(0, colon), UINT32_MAX, lo))
+            return false;
+
+        hi = lo;
+
+        if (colon != string::npos && !parse_number(w.substr(colon + 1), UINT32_MAX, hi))
+            return false;
+
+        if (!lo || hi < lo)
+            return false;
+
+        sids.emplace_back((uint32_t)lo, (uint32_t)hi);
+    }
+    return true;
+}
+
+bool parse_route_nets(const string& list, vector<pair<RouteAddr, RouteAddr>>& nets)
+{
+    nets.clear();
+
+    for (auto& w : split_list(list))
+    {
+        size_t slash = w.find('/');
+        string ip = w.substr(0, slash);
+        uint8_t bytes[16] = { };
+        unsigned long bits;
+        unsigned offset;
+
+        if (inet_pton(AF_INET, ip.c_str(), bytes + 12) == 1)
+        {
+            bytes[10] = bytes[11] = 0xff;
+            offset = 96;
+        }
+        else if (inet_pton(AF_INET6, ip.c_str(), bytes) == 1)
+            offset = 0;
+        else
+            return false;
+
+        bits = 128 - offset;
+
+        if (slash != string::npos && !parse_number(w.substr(slash + 1), 128 - offset, bits))
+            return false;
+
+        bits += offset;
+
+        RouteAddr lo = RouteAddr::from_bytes(bytes);
+        uint64_t hi_mask = bits >= 64 ? ~0ULL : bits ? ~0ULL << (64 - bits) : 0;
+        uint64_t lo_mask = bits <= 64 ? 0 : bits >= 128 ? ~0ULL : ~0ULL << (128 - bits);
+
+        lo.hi &= hi_mask;
+        lo.lo &= lo_mask;
+
+        nets.emplace_back(lo, RouteAddr { lo.hi | ~hi_mask, lo.lo | ~lo_mask });
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// IntervalTable
+//-------------------------------------------------------------------------
+
+static bool next_key(uint32_t k, uint32_t& next)
+{
+    next = k + 1;
+    return k != UINT32_MAX;
+}
+
+static bool next_key(const RouteAddr& k, RouteAddr& next)
+{
+    next = { k.hi + (k.lo == ~0ULL), k.lo + 1 };
+    return k.hi != ~0ULL || k.lo != ~0ULL;
+}
+
+template<typename Key>
+void IntervalTable<Key>::build(const vector<pair<pair<Key, Key>, unsigned>>& ranges,
+    uint64_t dflt)
+{
+    // every range boundary starts a new interval
+    starts = { Key() };
+
+    for (auto& r : ranges)
+    {
+        Key after;
+        starts.emplace_back(r.first.first);
+
+        if (next_key(r.first.second, after))
+            starts.emplace_back(after);
+    }
+
+    sort(starts.begin(), starts.end());
+    starts.erase(unique(starts.begin(), starts.end()), starts.end());
+
+    masks.assign(starts.size(), dflt);
+
+    for (size_t i = 0; i < starts.size(); ++i)
+    {
+        for (auto& r : ranges)
+        {
+            if (!(starts[i] < r.first.first) && !(r.first.second < starts[i]))
+                masks[i] |= 1ULL << r.second;
+        }
+    }
+}
+
+template<typename Key>
+uint64_t IntervalTable<Key>::find(const Key& k) const
+{
+    // starts[0] is the smallest key, so there is always an interval
+    size_t i = upper_bound(starts.begin(), starts.end(), k) - starts.begin();
+    return masks[i - 1];
+}
+
+template class IntervalTable<uint32_t>;
+template class IntervalTable<RouteAddr>;
+
+//-------------------------------------------------------------------------
+// EventRouter
+//-------------------------------------------------------------------------
+
+void EventRouter::compile(const vector<SinkConfig>& sinks)
+{
+    vector<pair<pair<uint32_t, uint32_t>, unsigned>> sid_ranges;
+    vector<pair<pair<RouteAddr, RouteAddr>, unsigned>> net_ranges;
+    uint64_t sid_any = 0, net_any = 0;
+
+    all = sid_filtered = net_filtered = 0;
+    memset(by_type, 0, sizeof(by_type));
+    memset(by_priority, 0, sizeof(by_priority));
+    memset(by_protocol, 0, sizeof(by_protocol));
+
+    for (unsigned i = 0; i < sinks.size() && i < MAX_SINKS; ++i)
+    {
+        const RouteFilter& f = sinks[i].filter;
+        const uint64_t bit = 1ULL << i;
+
+        all |= bit;
+
+        for (unsigned t = 0; t < EVENT_TYPE_MAX; ++t)
+            if (!f.types || (f.types & (1u << t)))
+                by_type[t] |= bit;
+
+        for (unsigned p = 0; p < 256; ++p)
+            if (!f.max_priority || (p && p <= f.max_priority))
+                by_priority[p] |= bit;
+
+        if (f.protocols.empty())
+        {
+            for (auto& m : by_protocol)
+                m |= bit;
+        }
+        else
+        {
+            for (uint8_t p : f.protocols)
+                by_protocol[p] |= bit;
+        }
+
+        if (f.sids.empty())
+            sid_any |= bit;
+        else
+            sid_filtered |= bit;
+
+        for (auto& r : f.sids)
+            sid_ranges.push_back({ r, i });
+
+        if (f.nets.empty())
+            net_any |= bit;
+        else
+            net_filtered |= bit;
+
+        for (auto& r : f.nets)
+            net_ranges.push_back({ r, i });
+    }
+
+    by_sid.build(sid_ranges, sid_any);
+    by_net.build(net_ranges, net_any);
+}
@@ -0,0 +1,159 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// event_router.h - Per-sink routing filters compiled into a decision table
+
+#ifndef EVENT_ROUTER_H
+#define EVENT_ROUTER_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct SinkConfig;
+
+enum EventType : uint8_t
+{
+    EVENT_ALERT,
+    EVENT_FLOW,
+    EVENT_FLOW_END,
+    EVENT_BEACON,
+    EVENT_GRAPH,
+    EVENT_BASELINE,
+    EVENT_PROFILE,
+    EVENT_DNS,
+    EVENT_TYPE_MAX
+};
+
+// as in the sink types option and the type field of exported records
+extern const char* const event_type_names[EVENT_TYPE_MAX];
+
+// 128 bit address, IPv4 mapped into ::ffff:0:0/96, compared as an integer
+struct RouteAddr
+{
+    uint64_t hi;
+    uint64_t lo;
+
+    bool operator<(const RouteAddr& that) const
+    { return hi < that.hi || (hi == that.hi && lo < that.lo); }
+
+    bool operator==(const RouteAddr& that) const
+    { return hi == that.hi && lo == that.lo; }
+
+    // from 16 bytes in network order, as kept by SfIp
+    static RouteAddr from_bytes(const void*);
+
+    // dotted quad for mapped IPv4, else IPv6
+    std::string to_string() const;
+};
+
+//-------------------------------------------------------------------------
+// A sink's filter is a conjunction over dimensions, each an any-of list;
+// an empty list accepts everything.  Events without a priority or sid
+// (flows) carry 0 and never match a sink that filters on them.  The net
+// list matches if either end of the event is inside one of the prefixes.
+//-------------------------------------------------------------------------
+
+struct RouteFilter
+{
+    uint32_t types = 0;             // bit per EventType; 0 = all
+    uint8_t max_priority = 0;       // 1 is highest; 0 = any
+    std::vector<uint8_t> protocols;
+    std::vector<std::pair<uint32_t, uint32_t>> sids;
+    std::vector<std::pair<RouteAddr, RouteAddr>> nets;
+
+    bool empty() const
+    { return !types && !max_priority && protocols.empty() && sids.empty() && nets.empty(); }
+};
+
+// parsers for the sink filter options; each returns false if malformed
+bool parse_route_types(const std::string&, uint32_t&);
+bool parse_route_protocols(const std::string&, std::vector<uint8_t>&);
+bool parse_route_sids(const std::string&, std::vector<std::pair<uint32_t, uint32_t>>&);
+bool parse_route_nets(const std::string&, std::vector<std::pair<RouteAddr, RouteAddr>>&);
+
+// what routing looks at for one event
+struct RouteKey
+{
+    EventType type;
+    uint8_t priority;
+    uint8_t protocol;
+    uint32_t sid;
+    RouteAddr src;
+    RouteAddr dst;
+};
+
+//-------------------------------------------------------------------------
+// Filters are compiled into one table per dimension that maps a value to
+// the bitmask of sinks accepting it: direct lookups for type, priority and
+// protocol, and sorted interval tables for sids and addresses.  Routing an
+// event costs the same few lookups and ANDs however many filters there
+// are; only the interval searches grow, logarithmically, with the number
+// of distinct range boundaries.
+//-------------------------------------------------------------------------
+
+template<typename Key>
+class IntervalTable
+{
+public:
+    // ranges are inclusive; every key outside all ranges maps to dflt
+    void build(const std::vector<std::pair<std::pair<Key, Key>, unsigned>>& ranges,
+        uint64_t dflt);
+
+    uint64_t find(const Key&) const;
+
+private:
+    std::vector<Key> starts;
+    std::vector<uint64_t> masks;
+};
+
+class EventRouter
+{
+public:
+    static const unsigned MAX_SINKS = 64;
+
+    // sinks in the order the sender numbers them
+    void compile(const std::vector<SinkConfig>&);
+
+    uint64_t route(const RouteKey& k) const
+    {
+        uint64_t m = by_type[k.type] & by_priority[k.priority] & by_protocol[k.protocol];
+
+        if (m & sid_filtered)
+            m &= by_sid.find(k.sid);
+
+        if (m & net_filtered)
+            m &= by_net.find(k.src) | by_net.find(k.dst);
+
+        return m;
+    }
+
+    // every sink; what an unfiltered configuration routes everything to
+    uint64_t get_all() const
+    { return all; }
+
+private:
+    uint64_t all = 0;
+    uint64_t sid_filtered = 0;
+    uint64_t net_filtered = 0;
+
+    uint64_t by_type[EVENT_TYPE_MAX] = { };
+    uint64_t by_priority[256] = { };
+    uint64_t by_protocol[256] = { };
+
+    IntervalTable<uint32_t> by_sid;
+    IntervalTable<RouteAddr> by_net;
+};
+
+#endif
@@ -0,0 +1,1196 @@
+//--------------------------------------------------------------------------
+// event_sender.cc - NUMA-aware I/O threads that drain packet thread rings
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "event_sender.h"
+
+#include "log/messages.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <nlohmann/json.hpp>
+
+#include "ai_event_exporter.h"
+#include "event_sink.h"
+
+using namespace snort;
+using namespace std;
+using json = nlohmann::json;
+
+// events handed to the sink per ring before moving to the next ring
+static const size_t DRAIN_BATCH = 512;
+
+// a ring must hold at least this many events before other senders steal
+static const size_t STEAL_THRESHOLD = DRAIN_BATCH / 2;
+
+// how long to back off when a sink cannot take more
+static const chrono::milliseconds RETRY_INTERVAL(1);
+
+//-------------------------------------------------------------------------
+// NUMA helpers
+//-------------------------------------------------------------------------
+
+static bool parse_cpu(const char* s, char** end, unsigned& cpu)
+{
+    if (*s < '0' || *s > '9')
+        return false;
+
+    unsigned long v = strtoul(s, end, 10);
+
+    if (v >= CPU_SETSIZE)
+        return false;
+
+    cpu = (unsigned)v;
+    return true;
+}
+
+bool parse_cpu_list(const string& list, vector<unsigned>& cpus)
+{
+    cpus.clear();
+    const char* s = list.c_str();
+
+    while (*s)
+    {
+        while (*s == ' ' || *s == ',')
+            ++s;
+
+        if (!*s)
+            break;
+
+        char* end;
+        unsigned lo, hi;
+
+        if (!parse_cpu(s, &end, lo))
+            return false;
+
+        hi = lo;
+
+        if (*end == '-' && !parse_cpu(end + 1, &end, hi))
+            return false;
+
+        if (hi < lo || (*end && *end != ',' && *end != ' '))
+            return false;
+
+        for (unsigned c = lo; c <= hi; ++c)
+            cpus.emplace_back(c);
+
+        s = end;
+    }
+    return true;
+}
+
+static int node_dir_id(const char* name)
+{
+    if (strncmp(name, "node", 4) || name[4] < '0' || name[4] > '9')
+        return -1;
+
+    return atoi(name + 4);
+}
+
+unsigned numa_node_count()
+{
+    DIR* dir = opendir("/sys/devices/system/node");
+
+    if (!dir)
+        return 1;
+
+    int max_node = 0;
+
+    while (dirent* de = readdir(dir))
+    {
+        int id = node_dir_id(de->d_name);
+
+        if (id > max_node)
+            max_node = id;
+    }
+    closedir(dir);
+    return max_node + 1;
+}
+
+int numa_node_of_cpu(unsigned cpu)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", cpu);
+
+    DIR* dir = opendir(path);
+
+    if (!dir)
+        return 0;
+
+    int node = 0;
+
+    while (dirent* de = readdir(dir))
+    {
+        int id = node_dir_id(de->d_name);
+
+        if (id >= 0)
+        {
+            node = id;
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+int numa_current_node()
+{
+    unsigned cpu = 0, node = 0;
+
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr))
+        return 0;
+
+    return (int)node;
+}
+
+static vector<unsigned> numa_node_cpus(int node)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+    ifstream in(path);
+    string list;
+    vector<unsigned> cpus;
+
+    if (getline(in, list))
+        parse_cpu_list(list, cpus);
+
+    return cpus;
+}
+
+static void replace_tag(string& ep, const string& tag, unsigned value)
+{
+    size_t pos = ep.find(tag);
+
+    if (pos != string::npos)
+        ep.replace(pos, tag.size(), to_string(value));
+}
+
+static string sender_endpoint(const string& endpoint, int node, unsigned index)
+{
+    string ep = endpoint;
+    replace_tag(ep, "{node}", node < 0 ? 0 : node);
+    replace_tag(ep, "{sender}", index);
+    return ep;
+}
+
+static unsigned shard_of(uint64_t key, unsigned shards)
+{
+    // flow IDs are sequential per thread; mix before reducing
+    key *= 0x9e3779b97f4a7c15ULL;
+    return (unsigned)((key >> 32) % shards);
+}
+
+//-------------------------------------------------------------------------
+// PollBackoff
+//-------------------------------------------------------------------------
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+void PollBackoff::pause()
+{
+    if (spins > MAX_SPINS)
+    {
+        sched_yield();
+        return;
+    }
+
+    for (unsigned i = 0; i < spins; ++i)
+        cpu_relax();
+
+    spins <<= 1;
+}
+
+//-------------------------------------------------------------------------
+// SenderThread
+//-------------------------------------------------------------------------
+
+SenderThread::SenderThread(EventSender& es, unsigned i, int n, const vector<unsigned>& c)
+    : owner(es), index(i), node(n), cpus(c)
+{
+}
+
+SenderThread::~SenderThread()
+{
+    stop();
+}
+
+void SenderThread::add_sink(EventSink* s, SinkBackpressure policy, size_t limit)
+{
+    outputs.emplace_back(new SinkCursor(s, policy, limit));
+    outputs.back()->open();
+}
+
+void SenderThread::start()
+{
+    // the sinks were opened on the main thread; starting the thread is the
+    // full barrier zeromq requires before a socket migrates
+    call_once(started, [this]() { thread = new std::thread(&SenderThread::run, this); });
+}
+
+void SenderThread::stop()
+{
+    if (!thread)
+        return;
+
+    stopping.store(true, memory_order_release);
+    wake();
+    thread->join();
+
+    delete thread;
+    thread = nullptr;
+}
+
+void SenderThread::wake()
+{
+    {
+        lock_guard<mutex> lock(wait_mutex);
+        idle.store(false, memory_order_relaxed);
+    }
+    wait_cond.notify_one();
+}
+
+void SenderThread::set_affinity()
+{
+    char name[16];
+    snprintf(name, sizeof(name), "ai_export_%u", index);
+    pthread_setname_np(pthread_self(), name);
+
+    if (cpus.empty())
+        return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (unsigned c : cpus)
+        CPU_SET(c, &set);
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+        WarningMessage("AI Event Exporter: could not pin sender %u\n", index);
+}
+
+bool SenderThread::blocked() const
+{
+    for (auto& out : outputs)
+        if (out->blocking())
+            return true;
+
+    return false;
+}
+
+uint64_t SenderThread::get_delivered() const
+{
+    uint64_t n = 0;
+
+    for (auto& out : outputs)
+        n += out->get_sent();
+
+    return n;
+}
+
+size_t SenderThread::ring_depth() const
+{
+    size_t n = 0;
+
+    for (auto& slot : owner.active)
+    {
+        EventRing* ring = slot.load(memory_order_acquire);
+
+        if (ring && ring->get_shard() == index)
+            n += ring->size();
+    }
+    return n;
+}
+
+// records made by the sender threads themselves
+static string encode(const json& j, EventEncoding encoding)
+{
+    if (encoding == ENCODING_MSGPACK)
+    {
+        vector<uint8_t> packed = json::to_msgpack(j);
+        return string(packed.begin(), packed.end());
+    }
+    return j.dump();
+}
+
+void SenderThread::heartbeat()
+{
+    auto now = chrono::steady_clock::now();
+    size_t rings = ring_depth();
+    vector<EventSink::LaneMark> marks;
+
+    for (auto& out : outputs)
+    {
+        json j;
+
+        j["type"] = "heartbeat";
+        j["timestamp"] = chrono::duration_cast<chrono::milliseconds>(
+            chrono::system_clock::now().time_since_epoch()).count();
+        j["sender"] = index;
+        j["uptime_ms"] = chrono::duration_cast<chrono::milliseconds>(now - owner.started).count();
+        j["ring_depth"] = rings;
+        j["queue_depth"] = out->depth();
+        j["sent"] = out->get_sent();
+        j["dropped"] = out->get_dropped();
+
+        // [stream, lane, last sequence number sent]
+        marks.clear();
+        out->get_sink()->get_lane_marks(marks);
+        j["sequences"] = json::array();
+
+        for (auto& m : marks)
+            j["sequences"].push_back({ m.stream, m.lane, m.seq });
+
+        out->heartbeat(EventRef(encode(j, owner.config.encoding), HEARTBEAT_TOPIC));
+    }
+}
+
+void SenderThread::snapshot()
+{
+    const uint32_t topic = make_topic(EVENT_GRAPH, 0, 0);
+    uint64_t routes = owner.type_routes[EVENT_GRAPH].load(memory_order_relaxed) &
+        owner.topics.wanted(topic);
+
+    // taken even when nobody wants it, so the next one covers one interval
+    vector<json> parts;
+    owner.graph->snapshot(parts);
+
+    if (!routes)
+        return;
+
+    for (auto& part : parts)
+        offer(EventRef(encode(part, owner.config.encoding), topic), routes);
+}
+
+void SenderThread::update_baselines()
+{
+    const uint32_t topic = make_topic(EVENT_BASELINE, 0, 0);
+    uint64_t routes = owner.type_routes[EVENT_BASELINE].load(memory_order_relaxed) &
+        owner.topics.wanted(topic);
+
+    // packet threads rank against the new version whether or not it is sent
+    vector<json> records;
+    owner.baselines->update(records);
+
+    if (!routes)
+        return;
+
+    for (auto& record : records)
+        offer(EventRef(encode(record, owner.config.encoding), topic), routes);
+}
+
+void SenderThread::dump_profiles()
+{
+    const uint32_t topic = make_topic(EVENT_PROFILE, 0, 0);
+    uint64_t routes = owner.type_routes[EVENT_PROFILE].load(memory_order_relaxed) &
+        owner.topics.wanted(topic);
+
+    if (!routes)
+        return;
+
+    vector<json> parts;
+    owner.profiles->snapshot(parts);
+
+    for (auto& part : parts)
+        offer(EventRef(encode(part, owner.config.encoding), topic), routes);
+}
+
+void SenderThread::make_records(EventType type)
+{
+    {
+        lock_guard<mutex> lock(sink_mutex);
+
+        if (type == EVENT_GRAPH)
+            snapshot();
+
+        else if (type == EVENT_BASELINE)
+            update_baselines();
+
+        else if (type == EVENT_PROFILE)
+            dump_profiles();
+    }
+
+    // the sender pumps them out on its next pass
+    wake();
+}
+
+void SenderThread::offer(const EventRef& event, uint64_t routes)
+{
+    for (unsigned i = 0; i < outputs.size(); ++i)
+        if (routes & (1ULL << i))
+            outputs[i]->offer(event);
+}
+
+size_t SenderThread::pump()
+{
+    size_t n = 0;
+
+    for (auto& out : outputs)
+        n += out->pump();
+
+    return n;
+}
+
+void SenderThread::flush()
+{
+    for (auto& out : outputs)
+        out->flush();
+}
+
+size_t SenderThread::send_segment(Pending& work)
+{
+    EventRing& ring = *work.ring;
+    EventRing::Segment& seg = work.seg;
+    SenderThread& via = *work.via;
+    size_t n = 0;
+
+    {
+        lock_guard<mutex> lock(via.sink_mutex);
+        via.pump();
+
+        // keep the rest of the segment in the ring while a blocking sink
+        // catches up
+        while (!seg.empty() && !via.blocked())
+        {
+            // encoded once, shared by every sink it is routed to
+            uint64_t routes = ring.routes_at(seg.begin);
+            EventRef event(std::move(ring.at(seg.begin)), ring.topic_at(seg.begin));
+            ring.release(seg.begin++);
+            via.offer(event, routes);
+
+            owner.sent.fetch_add(1, memory_order_relaxed);
+            ++n;
+        }
+        via.flush();
+    }
+
+    if (seg.empty())
+    {
+        if (work.leased)
+            ring.end_lease();
+
+        work = Pending();
+    }
+    else if (&work != &pending)
+        pending = work;
+
+    return n;
+}
+
+size_t SenderThread::drain(EventRing& ring)
+{
+    Pending work;
+    work.ring = &ring;
+    work.via = this;
+
+    // with flow sharding a ring is drained by one sender at a time and
+    // always onto its shard's sink, so each flow stays in order
+    if (owner.flow_sharding)
+    {
+        if (!ring.try_lease())
+            return 0;
+
+        work.leased = true;
+        work.via = owner.senders[ring.get_shard()].get();
+    }
+
+    if (!ring.claim(DRAIN_BATCH, work.seg))
+    {
+        if (work.leased)
+            ring.end_lease();
+
+        return 0;
+    }
+    return send_segment(work);
+}
+
+size_t SenderThread::steal()
+{
+    EventRing* victim = nullptr;
+    size_t most = STEAL_THRESHOLD - 1;
+
+    for (auto& slot : owner.active)
+    {
+        EventRing* ring = slot.load(memory_order_acquire);
+
+        if (!ring || ring->get_shard() == index)
+            continue;
+
+        size_t n = ring->size();
+
+        if (n > most)
+        {
+            most = n;
+            victim = ring;
+        }
+    }
+
+    if (!victim)
+        return 0;
+
+    size_t n = drain(*victim);
+    owner.stolen.fetch_add(n, memory_order_relaxed);
+    return n;
+}
+
+void SenderThread::run()
+{
+    set_affinity();
+
+    const chrono::milliseconds flush_interval(owner.config.flush_interval);
+    chrono::steady_clock::time_point deadline;
+    bool draining = false;
+    uint64_t delivered = 0;
+    PollBackoff backoff;
+
+    const chrono::milliseconds heartbeat_interval(owner.config.heartbeat_interval);
+    auto next_heartbeat = chrono::steady_clock::now() + heartbeat_interval;
+
+    while (true)
+    {
+        size_t sent = 0;
+
+        if (pending.ring)
+            sent += send_segment(pending);
+
+        if (!pending.ring)
+        {
+            for (auto& slot : owner.active)
+            {
+                EventRing* ring = slot.load(memory_order_acquire);
+
+                if (!ring || ring->get_shard() != index)
+                    continue;
+
+                sent += drain(*ring);
+
+                if (pending.ring)
+                    break;
+            }
+
+            if (!sent && !pending.ring)
+                sent += steal();
+        }
+
+        bool backlog = pending.ring != nullptr;
+
+        bool stop = stopping.load(memory_order_acquire);
+
+        if ((!sent || stop) && !backlog)
+        {
+            // sinks may still hold queued events or a partial batch; idle
+            // wakeups push them on
+            lock_guard<mutex> lock(sink_mutex);
+            sent += pump();
+            flush();
+
+            for (auto& out : outputs)
+                backlog = backlog || out->backlogged();
+        }
+
+        for (auto& slot : owner.active)
+        {
+            EventRing* ring = slot.load(memory_order_acquire);
+
+            if (ring && ring->get_shard() == index && !ring->empty())
+                backlog = true;
+        }
+
+        chrono::steady_clock::duration wait = backlog ? RETRY_INTERVAL : flush_interval;
+
+        // from the I/O thread, so a consumer hears from an idle sensor and
+        // a stalled one stops sending them
+        if (heartbeat_interval.count())
+        {
+            auto now = chrono::steady_clock::now();
+
+            if (now >= next_heartbeat)
+            {
+                lock_guard<mutex> lock(sink_mutex);
+                heartbeat();
+                next_heartbeat = now + heartbeat_interval;
+            }
+            wait = min(wait, next_heartbeat - now);
+        }
+
+        if (stop)
+        {
+            if (!draining)
+            {
+                deadline = chrono::steady_clock::now() +
+                    chrono::milliseconds(owner.config.shutdown_drain);
+                delivered = get_delivered();
+                draining = true;
+            }
+
+            if (!backlog || chrono::steady_clock::now() >= deadline)
+                break;
+        }
+
+        if (owner.busy_poll)
+        {
+            if (sent)
+                backoff.reset();
+            else
+                backoff.pause();
+
+            continue;
+        }
+
+        if (sent && !pending.ring)
+            continue;
+
+        unique_lock<mutex> lock(wait_mutex);
+        idle.store(true, memory_order_relaxed);
+
+        wait_cond.wait_for(lock, wait, [this]()
+            { return !idle.load(memory_order_relaxed) || stopping.load(memory_order_relaxed); });
+
+        idle.store(false, memory_order_relaxed);
+    }
+
+    spill(deadline);
+
+    // what the sinks took from the moment the drain began
+    owner.drained.fetch_add(get_delivered() - delivered, memory_order_relaxed);
+}
+
+void SenderThread::spill(chrono::steady_clock::time_point deadline)
+{
+    // one copy of each event, with the routes of every sink that still
+    // needs it; sinks hand back what they hold first since it is oldest
+    vector<SpooledEvent> left;
+    unordered_map<const char*, size_t> seen;
+
+    auto add = [&](EventRef&& event, uint64_t routes)
+    {
+        auto it = seen.emplace(event.data(), left.size());
+
+        if (it.second)
+            left.push_back({ std::move(event), routes });
+        else
+            left[it.first->second].routes |= routes;
+    };
+
+    {
+        lock_guard<mutex> lock(sink_mutex);
+
+        for (unsigned i = 0; i < outputs.size(); ++i)
+        {
+            vector<EventRef> events;
+            outputs[i]->close(deadline, events);
+
+            for (auto& event : events)
+                add(std::move(event), 1ULL << i);
+        }
+    }
+
+    auto take = [&](EventRing& ring, EventRing::Segment& seg)
+    {
+        for (; !seg.empty(); ++seg.begin)
+        {
+            uint64_t routes = ring.routes_at(seg.begin);
+            add(EventRef(std::move(ring.at(seg.begin)), ring.topic_at(seg.begin)), routes);
+            ring.release(seg.begin);
+        }
+    };
+
+    if (pending.ring)
+    {
+        take(*pending.ring, pending.seg);
+
+        // a stolen segment must not keep another sender's ring leased
+        if (pending.leased)
+            pending.ring->end_lease();
+
+        pending = Pending();
+    }
+
+    for (auto& slot : owner.active)
+    {
+        EventRing* ring = slot.load(memory_order_acquire);
+        EventRing::Segment seg;
+
+        if (ring && ring->get_shard() == index && ring->claim(SIZE_MAX, seg))
+            take(*ring, seg);
+    }
+
+    if (!left.empty())
+        owner.spool(index, left);
+}
+
+//-------------------------------------------------------------------------
+// EventSender
+//-------------------------------------------------------------------------
+
+EventSender::EventSender(const AIEventExporterConfig& c, unsigned max_threads)
+    : config(c), senders_per_node(c.sender_threads),
+      flow_sharding(c.sharding == SHARD_BY_FLOW),
+      busy_poll(c.latency_mode == LATENCY_BUSY_POLL),
+      spool_run(EventSpool::run_id()), started(chrono::steady_clock::now())
+{
+    vector<unsigned> pinned;
+    parse_cpu_list(config.sender_cpus, pinned);
+
+    unsigned nodes = config.numa_senders ? numa_node_count() : 1;
+
+    for (unsigned n = 0; n < nodes; ++n)
+    {
+        int node = nodes > 1 ? (int)n : -1;
+        vector<unsigned> cpus;
+
+        if (pinned.empty())
+        {
+            if (node >= 0)
+                cpus = numa_node_cpus(node);
+        }
+        else
+        {
+            for (unsigned cpu : pinned)
+                if (node < 0 || numa_node_of_cpu(cpu) == node)
+                    cpus.emplace_back(cpu);
+        }
+
+        for (unsigned k = 0; k < senders_per_node; ++k)
+        {
+            vector<unsigned> mine = cpus;
+
+            // explicitly listed CPUs are handed out one per sender
+            if (!pinned.empty() && !cpus.empty())
+                mine = { cpus[k % cpus.size()] };
+
+            senders.emplace_back(new SenderThread(*this, senders.size(), node, mine));
+        }
+    }
+
+    if (busy_poll && pinned.empty())
+        WarningMessage("AI Event Exporter: busy_poll senders spin on a core; "
+            "pin them with sender_cpus\n");
+
+    rings_per_thread = flow_sharding ? senders.size() : 1;
+    rings.resize(max_threads * rings_per_thread);
+    active = vector<atomic<EventRing*>>(rings.size());
+
+    for (auto& slot : active)
+        slot.store(nullptr, memory_order_relaxed);
+
+    wake_threshold = config.buffer_size / 10;
+
+    if (!wake_threshold)
+        wake_threshold = 1;
+
+    if (config.rate_limit.enabled())
+        limiter.reset(new RateLimiter(config.rate_limit, max_threads));
+
+    if (config.graph_interval)
+        graph.reset(new CommGraph(max_threads, config.graph_edges));
+
+    if (config.baselines.enabled())
+        baselines.reset(new FlowBaselines(config.baselines, max_threads));
+
+    if (config.profiles.enabled())
+        profiles.reset(new HostProfiles(config.profiles));
+}
+
+EventSender::~EventSender()
+{
+    stop();
+    senders.clear();
+
+    if (context)
+    {
+        context->close();
+        delete context;
+    }
+}
+
+void EventSender::connect()
+{
+    sinks.clear();
+
+    if (!config.endpoint.empty())
+        sinks.push_back({ config.endpoint, config.backpressure, RouteFilter() });
+
+    sinks.insert(sinks.end(), config.sinks.begin(), config.sinks.end());
+
+    if (sinks.empty())
+        throw runtime_error("no endpoint or sinks configured");
+
+    for (unsigned i = 0; i < sinks.size(); ++i)
+    {
+        if (!EventSink::is_pub(sinks[i].endpoint, config))
+            continue;
+
+        // each sender binds its own publisher; two on one address fail
+        unordered_set<string> bound;
+
+        for (auto& s : senders)
+            if (!bound.insert(sender_endpoint(sinks[i].endpoint, s->get_node(),
+                s->get_index())).second)
+                throw runtime_error(sinks[i].endpoint + ": each of the " +
+                    to_string(senders.size()) + " sender threads binds a pub endpoint; "
+                    "put {sender} or {node} in it");
+
+        topics.set_filtered(i);
+    }
+
+    context = new zmq::context_t(1);
+
+    for (auto& s : senders)
+    {
+        for (unsigned i = 0; i < sinks.size(); ++i)
+        {
+            const SinkConfig& sink = sinks[i];
+            string ep = sender_endpoint(sink.endpoint, s->get_node(), s->get_index());
+
+            // a blocking sink's backlog is the ring; one segment of slack
+            // is enough.  a dropping sink gets its own ring's worth.
+            size_t limit = sink.backpressure == BACKPRESSURE_BLOCK ?
+                DRAIN_BATCH : config.buffer_size;
+
+            s->add_sink(EventSink::create(ep, s->get_index(), config, *context, topics, i),
+                sink.backpressure, limit);
+        }
+    }
+
+    // what earlier runs could not deliver goes out before anything new.
+    // an instance this reload replaces spools only after this, under its
+    // own names, so its files wait for the next reload or start.
+    if (!config.spool_dir.empty())
+        replay();
+
+    if (!timer && (limiter || graph || baselines || profiles))
+    {
+        // its records go out through the first sender, rings or not
+        senders.front()->start();
+        timer = new std::thread(&EventSender::run_timers, this);
+    }
+}
+
+void EventSender::run_timers()
+{
+    pthread_setname_np(pthread_self(), "ai_export_tmr");
+
+    SenderThread& first = *senders.front();
+    auto now = chrono::steady_clock::now();
+    auto next_refill = now;
+
+    const chrono::seconds graph_interval(graph ? config.graph_interval : 0);
+    auto next_snapshot = now + graph_interval;
+
+    const chrono::seconds baseline_interval(baselines ? config.baselines.interval : 0);
+    auto next_baseline = now + baseline_interval;
+
+    // how often a dump_profiles request is looked for
+    const chrono::milliseconds poll_interval(config.flush_interval);
+
+    unique_lock<mutex> lock(timer_mutex);
+
+    while (!timer_stopping)
+    {
+        now = chrono::steady_clock::now();
+        auto next = now + poll_interval;
+
+        if (limiter)
+        {
+            if (now >= next_refill)
+            {
+                limiter->refill(now);
+                next_refill = now + RateLimiter::REFILL_INTERVAL;
+            }
+            next = min(next, next_refill);
+        }
+
+        if (graph_interval.count())
+        {
+            if (now >= next_snapshot)
+            {
+                first.make_records(EVENT_GRAPH);
+                next_snapshot = now + graph_interval;
+            }
+            next = min(next, next_snapshot);
+        }
+
+        if (baseline_interval.count())
+        {
+            if (now >= next_baseline)
+            {
+                first.make_records(EVENT_BASELINE);
+                next_baseline = now + baseline_interval;
+            }
+            next = min(next, next_baseline);
+        }
+
+        // on request from the dump_profiles command
+        if (profiles && HostProfiles::snapshot_requested())
+            first.make_records(EVENT_PROFILE);
+
+        timer_cond.wait_until(lock, next, [this]() { return timer_stopping; });
+    }
+}
+
+void EventSender::stop_timers()
+{
+    if (!timer)
+        return;
+
+    {
+        lock_guard<mutex> lock(timer_mutex);
+        timer_stopping = true;
+    }
+    timer_cond.notify_one();
+    timer->join();
+
+    delete timer;
+    timer = nullptr;
+}
+
+void SenderThread::replay(const vector<SpooledEvent>& events)
+{
+    lock_guard<mutex> lock(sink_mutex);
+
+    for (auto& e : events)
+        offer(e.event, e.routes);
+
+    // the sinks keep what they could not take; the thread pushes it on
+    start();
+}
+
+void EventSender::replay()
+{
+    vector<string> names;
+
+    for (auto& sink : sinks)
+        names.emplace_back(sink.endpoint);
+
+    for (auto& file : EventSpool::find(config.spool_dir))
+    {
+        const string& path = file.second;
+        vector<string> spooled_sinks;
+        vector<SpooledEvent> events;
+        string error;
+
+        if (!EventSpool::read(path, spooled_sinks, events, error))
+            WarningMessage("AI Event Exporter: %s\n", error.c_str());
+
+        // sinks are matched by endpoint; events for sinks that are gone
+        // have nowhere to go
+        vector<uint64_t> to(spooled_sinks.size(), 0);
+
+        for (unsigned i = 0; i < spooled_sinks.size(); ++i)
+            for (unsigned j = 0; j < names.size(); ++j)
+                if (spooled_sinks[i] == names[j])
+                    to[i] |= 1ULL << j;
+
+        vector<SpooledEvent> replayed;
+        uint64_t gone = 0;
+
+        for (auto& e : events)
+        {
+            uint64_t routes = 0;
+
+            for (unsigned i = 0; i < to.size(); ++i)
+                if (e.routes & (1ULL << i))
+                    routes |= to[i];
+
+            if (routes)
+                replayed.push_back({ std::move(e.event), routes });
+            else
+                ++gone;
+        }
+
+        // a spool is replayed once, whatever happens to it
+        remove(path.c_str());
+
+        senders[file.first % senders.size()]->replay(replayed);
+
+        LogMessage("AI Event Exporter: replayed %zu spooled events from %s\n",
+            replayed.size(), path.c_str());
+
+        if (gone)
+            WarningMessage("AI Event Exporter: %lu spooled events were for sinks no longer "
+                "configured\n", gone);
+    }
+}
+
+void EventSender::spool(unsigned sender, const vector<SpooledEvent>& events)
+{
+    if (config.spool_dir.empty())
+    {
+        lost.fetch_add(events.size(), memory_order_relaxed);
+        return;
+    }
+
+    vector<string> names;
+
+    for (auto& sink : sinks)
+        names.emplace_back(sink.endpoint);
+
+    string error;
+
+    if (!EventSpool::write(EventSpool::path(config.spool_dir, spool_run, sender), names, events, error))
+    {
+        ErrorMessage("AI Event Exporter: %s\n", error.c_str());
+        lost.fetch_add(events.size(), memory_order_relaxed);
+        return;
+    }
+    spooled.fetch_add(events.size(), memory_order_relaxed);
+}
+
+void EventSender::get_sink_stats(unsigned sink, uint64_t& sent, uint64_t& dropped,
+    uint64_t& held) const
+{
+    sent = dropped = held = 0;
+
+    for (auto& s : senders)
+    {
+        if (const SinkCursor* out = s->get_sink(sink))
+        {
+            sent += out->get_sent();
+            dropped += out->get_dropped();
+            held += out->get_held();
+        }
+    }
+}
+
+void EventSender::attach(unsigned thread)
+{
+    if ((size_t)thread * rings_per_thread >= rings.size())
+        return;
+
+    int node = senders.front()->get_node() < 0 ? -1 : numa_current_node();
+    unsigned first = node < 0 ? 0 : node * senders_per_node;
+
+    if (first >= senders.size())
+        first = 0;
+
+    for (unsigned r = 0; r < rings_per_thread; ++r)
+    {
+        unsigned idx = thread * rings_per_thread + r;
+
+        // by flow, ring r feeds sender r; by node, spread this node's
+        // packet threads over its senders
+        unsigned shard = flow_sharding ? r : first + thread % senders_per_node;
+
+        // allocated here so the ring's pages are first touched on this thread's node
+        if (!rings[idx])
+            rings[idx].reset(new EventRing(config.buffer_size, node, shard));
+
+        active[idx].store(rings[idx].get(), memory_order_release);
+        senders[shard]->start();
+    }
+}
+
+void EventSender::detach(unsigned thread)
+{
+    for (unsigned r = 0; r < rings_per_thread; ++r)
+    {
+        unsigned idx = thread * rings_per_thread + r;
+
+        if (idx < rings.size() && rings[idx])
+            rings[idx]->close();
+    }
+}
+
+void EventSender::wake(const EventRing& ring)
+{
+    SenderThread* s = senders[ring.get_shard()].get();
+
+    if (s->is_idle())
+    {
+        s->wake();
+        return;
+    }
+
+    // the owner is busy; let an idle peer steal from it
+    for (auto& peer : senders)
+    {
+        if (peer.get() != s && peer->is_idle())
+        {
+            peer->wake();
+            break;
+        }
+    }
+}
+
+bool EventSender::send(unsigned thread, string&& event, uint64_t key, uint64_t routes,
+    uint32_t topic)
+{
+    unsigned idx = thread * rings_per_thread;
+
+    if (rings_per_thread > 1)
+        idx += shard_of(key, rings_per_thread);
+
+    EventRing* ring = idx < active.size() ? active[idx].load(memory_order_relaxed) : nullptr;
+
+    const EventType type = (EventType)(topic & 0xff);
+    const size_t bytes = event.size();
+
+    // held back by the rate limit; counted there, not as a drop
+    if (limiter && !limiter->take(thread, type, bytes))
+        return false;
+
+    if (!ring || ring->is_closed() || !ring->push(std::move(event), routes, topic))
+    {
+        // a dropped event spends no tokens, so a full ring does not also
+        // starve the events after it
+        if (limiter)
+            limiter->give_back(thread, type, bytes);
+
+        dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    // busy polling senders never sleep and flush every event immediately
+    if (!busy_poll && ring->size() >= wake_threshold)
+        wake(*ring);
+
+    return true;
+}
+
+void EventSender::stop()
+{
+    // no new records once the drain begins
+    stop_timers();
+
+    for (auto& s : senders)
+        s->stop();
+
+    uint64_t d = get_drained(), s = get_spooled(), l = get_lost();
+
+    if (d || s || l)
+        call_once(reported, [d, s, l]()
+        {
+            LogMessage("AI Event Exporter: shutdown drained %lu events, spooled %lu, lost %lu\n",
+                d, s, l);
+        });
+}
@@ -0,0 +1,290 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// event_sender.h - NUMA-aware I/O threads that drain packet thread rings
+
+#ifndef EVENT_SENDER_H
+#define EVENT_SENDER_H
+
+#include <zmq.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ai_event_exporter.h"
+#include "comm_graph.h"
+#include "event_ring.h"
+#include "event_spool.h"
+#include "flow_baselines.h"
+#include "host_profiles.h"
+#include "rate_limiter.h"
+#include "event_topics.h"
+
+class EventSender;
+class EventSink;
+class SinkCursor;
+
+//-------------------------------------------------------------------------
+// NUMA helpers
+//-------------------------------------------------------------------------
+
+// parse a cpu list such as "2,4-7"; returns false if malformed
+bool parse_cpu_list(const std::string&, std::vector<unsigned>&);
+
+unsigned numa_node_count();
+int numa_node_of_cpu(unsigned cpu);
+int numa_current_node();
+
+//-------------------------------------------------------------------------
+// Busy poll backoff: spin with a cpu pause hint, doubling the spin length
+// on every empty poll, and yield the core only once the spin is maxed out.
+// The sender never sleeps, so a new event is picked up within a few
+// hundred nanoseconds.
+//-------------------------------------------------------------------------
+
+class PollBackoff
+{
+public:
+    void reset()
+    { spins = 1; }
+
+    void pause();
+
+private:
+    static const unsigned MAX_SPINS = 1024;
+    unsigned spins = 1;
+};
+
+//-------------------------------------------------------------------------
+// Senders are grouped by NUMA node and each owns its own set of sinks.  A
+// sender drains the rings assigned to it (its shard) and, when it has
+// nothing of its own to do, steals segments from the fullest ring of
+// another sender.
+//-------------------------------------------------------------------------
+
+class SenderThread
+{
+public:
+    SenderThread(EventSender&, unsigned index, int node, const std::vector<unsigned>& cpus);
+    ~SenderThread();
+
+    // opens the sink; sinks are added in configuration order
+    void add_sink(EventSink*, SinkBackpressure, size_t limit);
+    void start();
+    void stop();
+    void wake();
+
+    bool is_idle() const
+    { return idle.load(std::memory_order_relaxed); }
+
+    unsigned get_index() const
+    { return index; }
+
+    int get_node() const
+    { return node; }
+
+    const SinkCursor* get_sink(unsigned i) const
+    { return i < outputs.size() ? outputs[i].get() : nullptr; }
+
+    // called from connect() before the thread starts
+    void replay(const std::vector<SpooledEvent>&);
+
+    // from the timer thread: makes the graph snapshot, baseline update or
+    // profile dump and queues it on this sender's sinks
+    void make_records(EventType);
+
+private:
+    struct Pending
+    {
+        EventRing* ring = nullptr;
+        EventRing::Segment seg;
+        SenderThread* via = nullptr;
+        bool leased = false;
+    };
+
+    void run();
+    void set_affinity();
+    size_t drain(EventRing&);
+    size_t steal();
+    size_t send_segment(Pending&);
+    void spill(std::chrono::steady_clock::time_point deadline);
+    uint64_t get_delivered() const;
+    size_t ring_depth() const;
+
+    // under sink_mutex
+    void offer(const EventRef&, uint64_t routes);
+    void heartbeat();
+    void snapshot();
+    void update_baselines();
+    void dump_profiles();
+    bool blocked() const;
+    size_t pump();
+    void flush();
+
+private:
+    EventSender& owner;
+    const unsigned index;
+    const int node;
+    std::vector<unsigned> cpus;
+
+    std::vector<std::unique_ptr<SinkCursor>> outputs;
+    std::mutex sink_mutex;
+
+    std::thread* thread = nullptr;
+    std::once_flag started;
+    Pending pending;
+
+    std::mutex wait_mutex;
+    std::condition_variable wait_cond;
+    std::atomic<bool> idle { false };
+    std::atomic<bool> stopping { false };
+};
+
+class EventSender
+{
+public:
+    EventSender(const AIEventExporterConfig&, unsigned max_threads);
+    ~EventSender();
+
+    // called from configure(); throws on sink errors
+    void connect();
+
+    // called from tinit() / tterm() on the packet thread
+    void attach(unsigned thread);
+    void detach(unsigned thread);
+
+    // called from the packet thread that owns the ring; the key selects
+    // the shard when sharding by flow, routes has a bit set for each entry
+    // of get_sinks() that gets the event, and topic is its PUB topic
+    bool send(unsigned thread, std::string&&, uint64_t key, uint64_t routes,
+        uint32_t topic = 0);
+
+    void stop();
+
+    uint64_t get_sent() const
+    { return sent.load(std::memory_order_relaxed); }
+
+    uint64_t get_dropped() const
+    { return dropped.load(std::memory_order_relaxed); }
+
+    uint64_t get_stolen() const
+    { return stolen.load(std::memory_order_relaxed); }
+
+    // deliveries to sinks after stop() began, events written to the spool
+    // when the drain ran out of time, and events lost because they could
+    // not be spooled
+    uint64_t get_drained() const
+    { return drained.load(std::memory_order_relaxed); }
+
+    uint64_t get_spooled() const
+    { return spooled.load(std::memory_order_relaxed); }
+
+    uint64_t get_lost() const
+    { return lost.load(std::memory_order_relaxed); }
+
+    // the primary endpoint, if any, followed by the configured sinks
+    const std::vector<SinkConfig>& get_sinks() const
+    { return sinks; }
+
+    // null unless graph_interval is set; packet threads add their flows
+    CommGraph* get_graph()
+    { return graph.get(); }
+
+    // null unless baseline_interval is set; packet threads add ended flows
+    FlowBaselines* get_baselines()
+    { return baselines.get(); }
+
+    // null unless profile_hosts is set; packet threads update it at flow end
+    HostProfiles* get_profiles()
+    { return profiles.get(); }
+
+    // the sinks the records a sender thread makes itself (graph snapshots,
+    // baselines, profile snapshots) are routed to, from configure()
+    void set_routes(EventType type, uint64_t routes)
+    { type_routes[type].store(routes, std::memory_order_relaxed); }
+
+    // subscriptions of the PUB sinks among get_sinks()
+    const TopicSubscriptions& get_topics() const
+    { return topics; }
+
+    // totals over all senders for one entry of get_sinks()
+    void get_sink_stats(unsigned sink, uint64_t& sent, uint64_t& dropped, uint64_t& held) const;
+
+private:
+    friend class SenderThread;
+
+    void wake(const EventRing&);
+
+    // refills the limiter and has the first sender make its records
+    void run_timers();
+    void stop_timers();
+
+    void replay();
+    void spool(unsigned sender, const std::vector<SpooledEvent>&);
+
+private:
+    const AIEventExporterConfig& config;
+    zmq::context_t* context = nullptr;
+    std::vector<SinkConfig> sinks;
+    TopicSubscriptions topics;
+
+    // outlives the senders; refilled by the timer thread
+    std::unique_ptr<RateLimiter> limiter;
+
+    // snapshots, baselines and profile dumps are made on the timer thread
+    // and sent by the first sender thread, which runs whether or not a
+    // ring is sharded to it
+    std::unique_ptr<CommGraph> graph;
+    std::unique_ptr<FlowBaselines> baselines;
+    std::unique_ptr<HostProfiles> profiles;
+    std::atomic<uint64_t> type_routes[EVENT_TYPE_MAX] = { };
+
+    std::vector<std::unique_ptr<SenderThread>> senders;
+    std::vector<std::unique_ptr<EventRing>> rings;
+    std::vector<std::atomic<EventRing*>> active;
+
+    // a thread of its own, so neither a sender that never starts nor one
+    // held by a blocking sink stops the refill or the periodic records
+    std::thread* timer = nullptr;
+    std::mutex timer_mutex;
+    std::condition_variable timer_cond;
+    bool timer_stopping = false;
+
+    unsigned senders_per_node;
+    unsigned rings_per_thread;
+    bool flow_sharding;
+    bool busy_poll;
+    size_t wake_threshold;
+
+    std::atomic<uint64_t> sent { 0 };
+    std::atomic<uint64_t> dropped { 0 };
+    std::atomic<uint64_t> stolen { 0 };
+    std::atomic<uint64_t> drained { 0 };
+    std::atomic<uint64_t> spooled { 0 };
+    std::atomic<uint64_t> lost { 0 };
+    std::once_flag reported;
+
+    // names this instance's spool files apart from those of the instance a
+    // reload replaces, which may still be draining
+    const std::string spool_run;
+
+    const std::chrono::steady_clock::time_point started;
+};
+
+#endif
@@ -0,0 +1,161 @@
+//--------------------------------------------------------------------------
+// event_sink.cc - Destinations that sender threads write events to
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "event_sink.h"
+
+#include "log/messages.h"
+
+#include "file_sink.h"
+#include "unix_sink.h"
+#include "zmq_sink.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace snort;
+using namespace std;
+
+SinkPegs sink_pegs;
+
+static bool has_scheme(const string& endpoint, const char* scheme)
+{
+    return endpoint.compare(0, strlen(scheme), scheme) == 0;
+}
+
+bool EventSink::is_pub(const string& endpoint, const AIEventExporterConfig& config)
+{
+    return config.zmq_socket_type == ZMQ_SOCKET_PUB && !has_scheme(endpoint, "file://") &&
+        !has_scheme(endpoint, "unix://");
+}
+
+EventSink* EventSink::create(const string& endpoint, unsigned sender,
+    const AIEventExporterConfig& config, zmq::context_t& context, TopicSubscriptions& topics,
+    unsigned sink)
+{
+    if (has_scheme(endpoint, "file://"))
+        return new FileSink(endpoint, endpoint.substr(7), sender, config);
+
+    if (has_scheme(endpoint, "unix://"))
+        return new UnixSink(endpoint, endpoint.substr(7), config);
+
+    if (is_pub(endpoint, config))
+        return new ZmqSink(endpoint, config, context, &topics, sink);
+
+    return new ZmqSink(endpoint, config, context);
+}
+
+//-------------------------------------------------------------------------
+// SinkCursor
+//-------------------------------------------------------------------------
+
+SinkCursor::SinkCursor(EventSink* s, SinkBackpressure p, size_t n)
+    : sink(s), policy(p), limit(n)
+{
+}
+
+SinkCursor::~SinkCursor()
+{
+    delete sink;
+}
+
+void SinkCursor::open()
+{
+    sink->open();
+}
+
+bool SinkCursor::write(const EventRef& event)
+{
+    try
+    {
+        bool taken = sink->write(event);
+
+        if (taken)
+            sent.fetch_add(1, memory_order_relaxed);
+
+        batched.store(sink->unsent(), memory_order_relaxed);
+
+        if (!taken)
+            return false;
+    }
+    catch (const exception& e)
+    {
+        ErrorMessage("Failed to send event to %s: %s\n", sink->get_endpoint().c_str(), e.what());
+        dropped.fetch_add(1, memory_order_relaxed);
+    }
+    return true;
+}
+
+void SinkCursor::offer(const EventRef& event)
+{
+    // nothing ahead of it, so try the sink before queueing
+    if (queue.empty() && write(event))
+        return;
+
+    if (policy == BACKPRESSURE_DROP && queue.size() >= limit)
+    {
+        dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    queue.emplace_back(event);
+    held.fetch_add(1, memory_order_relaxed);
+}
+
+size_t SinkCursor::pump()
+{
+    size_t n = 0;
+
+    while (!queue.empty() && write(queue.front()))
+    {
+        queue.pop_front();
+        ++n;
+    }
+    return n;
+}
+
+void SinkCursor::heartbeat(const EventRef& event)
+{
+    try
+    {
+        sink->write(event);
+        batched.store(sink->unsent(), memory_order_relaxed);
+    }
+    catch (const exception& e)
+    {
+        ErrorMessage("Failed to send heartbeat to %s: %s\n", sink->get_endpoint().c_str(),
+            e.what());
+    }
+}
+
+void SinkCursor::flush()
+{
+    try
+    {
+        sink->flush();
+        batched.store(sink->unsent(), memory_order_relaxed);
+    }
+    catch (const exception& e)
+    {
+        ErrorMessage("Failed to flush events to %s: %s\n", sink->get_endpoint().c_str(), e.what());
+    }
+}
+
+void SinkCursor::close(chrono::steady_clock::time_point deadline, vector<EventRef>& left)
+{
+    pump();
+    sink->close(deadline);
+
+    // what never left the sink's batch is spooled, not sent
+    sent.fetch_sub(sink->unsent(), memory_order_relaxed);
+    batched.store(0, memory_order_relaxed);
+    sink->take_unconfirmed(left);
+
+    for (auto& event : queue)
+        left.emplace_back(std::move(event));
+
+    queue.clear();
+}
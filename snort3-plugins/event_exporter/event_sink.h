@@ -0,0 +1,188 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// event_sink.h - Destinations that sender threads write events to
+
+#ifndef EVENT_SINK_H
+#define EVENT_SINK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "ai_event_exporter.h"
+#include "event_buffer.h"
+
+class TopicSubscriptions;
+
+namespace zmq
+{
+class context_t;
+}
+
+// totals kept by sinks on the sender threads and reported as module pegs
+struct SinkPegs
+{
+    std::atomic<uint64_t> alerts_acked { 0 };
+    std::atomic<uint64_t> alerts_retransmitted { 0 };
+};
+
+extern SinkPegs sink_pegs;
+
+//-------------------------------------------------------------------------
+// A sink belongs to one sender thread and is only used under that sender's
+// sink lock, so implementations need no locking of their own.  The scheme
+// of the endpoint picks the implementation:
+//
+//     tcp://, ipc://, inproc://, ...   ZeroMQ PUSH or PUB socket
+//     file:///path/prefix              rotating local archive
+//     unix:///path/to/socket           unix datagram socket
+//-------------------------------------------------------------------------
+
+class EventSink
+{
+public:
+    virtual ~EventSink() = default;
+
+    // called on the main thread from configure(); throws on failure
+    virtual void open() = 0;
+
+    // returns false if the event cannot be taken now; it is offered again
+    virtual bool write(const EventRef& event) = 0;
+
+    // called after each drained segment and when the sender wakes idle
+    virtual void flush() { }
+
+    // true while accepted events are still waiting for the transport
+    virtual bool backlogged() const
+    { return false; }
+
+    // called on the sender thread before it exits; waits for the
+    // transport to take what it accepted no later than the deadline
+    virtual void close(std::chrono::steady_clock::time_point) { }
+
+    // accepted events the consumer has not confirmed (unacked alerts) or
+    // the transport never took, taken after close() so they can be spooled
+    virtual void take_unconfirmed(std::vector<EventRef>&) { }
+
+    // accepted events still waiting in a batch of the sink's own, which
+    // take_unconfirmed() would hand back; they do not count as sent yet
+    virtual size_t unsent() const
+    { return 0; }
+
+    // the last sequence number sent in each lane, as (stream, lane, seq)
+    struct LaneMark
+    {
+        uint32_t stream;
+        uint32_t lane;
+        uint64_t seq;
+    };
+
+    virtual void get_lane_marks(std::vector<LaneMark>&) const { }
+
+    const std::string& get_endpoint() const
+    { return endpoint; }
+
+    // sink is the entry of the sender's sink list, for PUB subscriptions
+    static EventSink* create(const std::string& endpoint, unsigned sender,
+        const AIEventExporterConfig&, zmq::context_t&, TopicSubscriptions&, unsigned sink);
+
+    // true for a ZeroMQ endpoint when zmq_socket_type is pub
+    static bool is_pub(const std::string& endpoint, const AIEventExporterConfig&);
+
+protected:
+    EventSink(const std::string& ep) : endpoint(ep) { }
+
+    const std::string endpoint;
+};
+
+//-------------------------------------------------------------------------
+// A sender fans every event out to all of its sinks.  Each sink reads
+// through its own cursor, a queue of the shared events it has not taken
+// yet.  Once a cursor is limit events behind, a blocking sink stops the
+// sender from taking more off the rings while a dropping sink loses what
+// it cannot take; either way the other sinks keep going.
+//-------------------------------------------------------------------------
+
+class SinkCursor
+{
+public:
+    SinkCursor(EventSink*, SinkBackpressure, size_t limit);
+    ~SinkCursor();
+
+    void open();
+
+    // queue an event behind whatever the sink has not taken yet
+    void offer(const EventRef&);
+
+    // write queued events until the sink refuses one; returns the count
+    size_t pump();
+
+    void flush();
+
+    // written ahead of anything queued and never queued itself; a
+    // heartbeat the sink cannot take now is skipped
+    void heartbeat(const EventRef&);
+
+    size_t depth() const
+    { return queue.size(); }
+
+    const EventSink* get_sink() const
+    { return sink; }
+
+    // hands back what the sink never took or never confirmed
+    void close(std::chrono::steady_clock::time_point deadline, std::vector<EventRef>& left);
+
+    bool blocking() const
+    { return policy == BACKPRESSURE_BLOCK && queue.size() >= limit; }
+
+    bool backlogged() const
+    { return !queue.empty() || sink->backlogged(); }
+
+    // read from other threads too; batched may briefly run ahead of sent
+    uint64_t get_sent() const
+    {
+        uint64_t s = sent.load(std::memory_order_relaxed);
+        uint64_t b = batched.load(std::memory_order_relaxed);
+        return s > b ? s - b : 0;
+    }
+
+    uint64_t get_dropped() const
+    { return dropped.load(std::memory_order_relaxed); }
+
+    // events the sink refused at first and that had to wait in the queue
+    uint64_t get_held() const
+    { return held.load(std::memory_order_relaxed); }
+
+private:
+    bool write(const EventRef&);
+
+private:
+    EventSink* sink;
+    const SinkBackpressure policy;
+    const size_t limit;
+
+    std::deque<EventRef> queue;
+
+    std::atomic<uint64_t> sent { 0 };
+    std::atomic<uint64_t> dropped { 0 };
+    std::atomic<uint64_t> held { 0 };
+
+    // of sent, the events still in the sink's batch
+    std::atomic<uint64_t> batched { 0 };
+};
+
+#endif
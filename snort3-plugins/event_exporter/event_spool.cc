@@ -0,0 +1,210 @@
+//--------------------------------------------------------------------------
+// event_spool.cc - Events left over at shutdown, kept for the next start
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "event_spool.h"
+
+#include <dirent.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+
+static const char MAGIC[8] = { 'A', 'I', 'S', 'P', 'O', 'O', 'L', '1' };
+
+static const char* PREFIX = "ai_event_exporter.";
+static const char* SUFFIX = ".spool";
+
+// a spool file is never larger than the rings; anything beyond is corrupt
+static const uint32_t MAX_LENGTH = 64 * 1024 * 1024;
+
+string EventSpool::run_id()
+{
+    static atomic<unsigned> count { 0 };
+
+    // the start time leads, fixed width, so names sort oldest first
+    uint64_t us = chrono::duration_cast<chrono::microseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+
+    char id[64];
+    snprintf(id, sizeof(id), "%016" PRIx64 "-%ld-%u", us, (long)getpid(),
+        count.fetch_add(1, memory_order_relaxed));
+    return id;
+}
+
+string EventSpool::path(const string& dir, const string& run, unsigned sender)
+{
+    return dir + "/" + PREFIX + run + "." + to_string(sender) + SUFFIX;
+}
+
+// the sender index of a <prefix><run>.<sender><suffix> name, or -1
+static long spool_index(const char* name)
+{
+    size_t p = strlen(PREFIX), s = strlen(SUFFIX), n = strlen(name);
+
+    if (n <= p + s || strncmp(name, PREFIX, p) || strcmp(name + n - s, SUFFIX))
+        return -1;
+
+    const char* dot = nullptr;
+
+    for (const char* c = name + p; c < name + n - s; ++c)
+        if (*c == '.')
+            dot = c;
+
+    // a run id comes before the sender
+    if (!dot || dot == name + p || !isdigit((unsigned char)dot[1]))
+        return -1;
+
+    char* end;
+    long i = strtol(dot + 1, &end, 10);
+    return end == name + n - s ? i : -1;
+}
+
+vector<pair<unsigned, string>> EventSpool::find(const string& dir)
+{
+    vector<pair<unsigned, string>> found;
+    DIR* d = opendir(dir.c_str());
+
+    if (!d)
+        return found;
+
+    while (dirent* de = readdir(d))
+    {
+        long i = spool_index(de->d_name);
+
+        if (i >= 0)
+            found.emplace_back((unsigned)i, dir + "/" + de->d_name);
+    }
+    closedir(d);
+
+    // oldest run first
+    sort(found.begin(), found.end(),
+        [](const pair<unsigned, string>& a, const pair<unsigned, string>& b)
+        { return a.second < b.second; });
+
+    return found;
+}
+
+template<typename T>
+static void put(ofstream& out, T v)
+{ out.write((const char*)&v, sizeof(v)); }
+
+template<typename T>
+static bool get(ifstream& in, T& v)
+{ return (bool)in.read((char*)&v, sizeof(v)); }
+
+bool EventSpool::write(const string& path, const vector<string>& sinks,
+    const vector<SpooledEvent>& events, string& error)
+{
+    string tmp = path + ".tmp";
+    ofstream out(tmp, ios::binary | ios::trunc);
+
+    if (!out)
+    {
+        error = "can't create " + tmp + ": " + strerror(errno);
+        return false;
+    }
+
+    out.write(MAGIC, sizeof(MAGIC));
+    put(out, (uint32_t)sinks.size());
+
+    for (auto& s : sinks)
+    {
+        put(out, (uint32_t)s.size());
+        out.write(s.data(), s.size());
+    }
+
+    for (auto& e : events)
+    {
+        put(out, e.routes);
+        put(out, e.event.get_topic());
+        put(out, (uint32_t)e.event.size());
+        out.write(e.event.data(), e.event.size());
+    }
+
+    out.close();
+
+    if (!out || rename(tmp.c_str(), path.c_str()))
+    {
+        error = "can't write " + path + ": " + strerror(errno);
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool read_string(ifstream& in, string& s)
+{
+    uint32_t n;
+
+    if (!get(in, n) || n > MAX_LENGTH)
+        return false;
+
+    s.resize(n);
+    return n == 0 || (bool)in.read(&s[0], n);
+}
+
+bool EventSpool::read(const string& path, vector<string>& sinks,
+    vector<SpooledEvent>& events, string& error)
+{
+    ifstream in(path, ios::binary);
+
+    if (!in)
+    {
+        error = "can't open " + path;
+        return false;
+    }
+
+    char magic[sizeof(MAGIC)];
+    uint32_t count;
+
+    // routes is a 64 bit mask
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) ||
+        !get(in, count) || count > 64)
+    {
+        error = path + ": not a spool file";
+        return false;
+    }
+
+    sinks.resize(count);
+
+    for (auto& s : sinks)
+    {
+        if (!read_string(in, s))
+        {
+            error = path + ": truncated header";
+            return false;
+        }
+    }
+
+    uint64_t routes;
+
+    while (get(in, routes))
+    {
+        uint32_t topic;
+        string bytes;
+
+        if (!get(in, topic) || !read_string(in, bytes))
+        {
+            error = path + ": truncated event";
+            return false;
+        }
+        events.push_back({ EventRef(std::move(bytes), topic), routes });
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// event_spool.h - Events left over at shutdown, kept for the next start
+
+#ifndef EVENT_SPOOL_H
+#define EVENT_SPOOL_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "event_buffer.h"
+
+//-------------------------------------------------------------------------
+// When the shutdown drain runs out of time, each sender writes what its
+// rings and sinks still hold to one spool file, and the next start replays
+// every file in the directory, oldest first, before taking new events.
+// File names carry the run that wrote them as well as the sender, so an
+// inspector retired by a reload never writes over a file another one left:
+//
+//     ai_event_exporter.<start time>-<pid>-<count>.<sender>.spool
+//
+// A file names the sinks it was written for, so events only go back to
+// sinks that are still configured:
+//
+//     "AISPOOL1", uint32_t sink count,
+//         per sink: uint32_t length, endpoint
+//     per event: uint64_t routes, uint32_t topic, uint32_t length, event
+//
+// in host byte order; the spool never leaves the sensor.
+//-------------------------------------------------------------------------
+
+struct SpooledEvent
+{
+    EventRef event;
+    uint64_t routes;
+};
+
+class EventSpool
+{
+public:
+    // a name for one exporter instance that no other, in this process or
+    // an earlier one, has used
+    static std::string run_id();
+
+    // the spool file of one sender of a run
+    static std::string path(const std::string& dir, const std::string& run, unsigned sender);
+
+    // the spool files in dir and the senders that wrote them, oldest first
+    static std::vector<std::pair<unsigned, std::string>> find(const std::string& dir);
+
+    // written under a temporary name and renamed, so a crash mid-write
+    // never leaves a torn file to replay
+    static bool write(const std::string& path, const std::vector<std::string>& sinks,
+        const std::vector<SpooledEvent>&, std::string& error);
+
+    static bool read(const std::string& path, std::vector<std::string>& sinks,
+        std::vector<SpooledEvent>&, std::string& error);
+};
+
+#endif
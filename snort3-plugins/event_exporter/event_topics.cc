@@ -0,0 +1,90 @@
+//--------------------------------------------------------------------------
+// event_topics.cc - Topic prefixes and subscriptions for PUB sinks
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "event_topics.h"
+
+#include <algorithm>
+
+using namespace std;
+
+uint64_t TopicMasks::find_exact(uint32_t topic) const
+{
+    auto it = lower_bound(exact.begin(), exact.end(), make_pair(topic, (uint64_t)0));
+    return it != exact.end() && it->first == topic ? it->second : 0;
+}
+
+void TopicSubscriptions::update(unsigned sink, const string& prefix, bool subscribe)
+{
+    lock_guard<mutex> lock(update_mutex);
+    auto key = make_pair(prefix, sink);
+
+    if (subscribe)
+        ++counts[key];
+
+    else
+    {
+        auto it = counts.find(key);
+
+        if (it == counts.end())
+            return;
+
+        if (!--it->second)
+            counts.erase(it);
+    }
+    compile();
+}
+
+void TopicSubscriptions::compile()
+{
+    auto m = make_shared<TopicMasks>();
+
+    for (auto& c : counts)
+    {
+        const string& prefix = c.first.first;
+        const uint64_t bit = 1ULL << c.first.second;
+
+        // longer prefixes and unknown types match nothing we publish
+        if (prefix.size() > TOPIC_SIZE || (!prefix.empty() && (uint8_t)prefix[0] >= EVENT_TYPE_MAX))
+            continue;
+
+        uint8_t t[TOPIC_SIZE] = { };
+        copy(prefix.begin(), prefix.end(), t);
+
+        switch (prefix.size())
+        {
+        case 0:
+            m->any |= bit;
+            break;
+        case 1:
+            m->by_type[t[0]] |= bit;
+            break;
+        case 2:
+            m->by_priority[t[0]][t[1]] |= bit;
+            break;
+        default:
+            m->exact.emplace_back(make_topic((EventType)t[0], t[1], t[2]), bit);
+            break;
+        }
+    }
+
+    // one entry per topic, its sinks ORed together
+    sort(m->exact.begin(), m->exact.end());
+
+    size_t out = 0;
+
+    for (size_t i = 0; i < m->exact.size(); ++i)
+    {
+        if (out && m->exact[out - 1].first == m->exact[i].first)
+            m->exact[out - 1].second |= m->exact[i].second;
+        else
+            m->exact[out++] = m->exact[i];
+    }
+    m->exact.resize(out);
+
+    masks.swap(m);
+}
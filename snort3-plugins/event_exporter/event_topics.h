@@ -0,0 +1,133 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// event_topics.h - Topic prefixes and subscriptions for PUB sinks
+
+#ifndef EVENT_TOPICS_H
+#define EVENT_TOPICS_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "event_router.h"
+#include "swap_handle.h"
+
+//-------------------------------------------------------------------------
+// On a PUB socket every event is sent as two frames: a three byte topic
+// (event type, priority, IP protocol) and the encoded event.  Subscribers
+// filter by topic prefix, most general first:
+//
+//     ""              everything
+//     "\x00"          alerts
+//     "\x00\x01"      priority 1 alerts
+//     "\x01\x00\x06"  TCP flows
+//
+// libzmq matches subscriptions on the publisher, so a subscriber is only
+// sent the classes it asked for.
+//-------------------------------------------------------------------------
+
+static const size_t TOPIC_SIZE = 3;
+
+// heartbeats go out under a type of their own, outside the event types, so
+// subscribers take them with a "\xfe" prefix
+static const uint8_t HEARTBEAT_TYPE = 0xfe;
+static const uint32_t HEARTBEAT_TOPIC = HEARTBEAT_TYPE;
+
+// packed into the low three bytes, in frame order
+static inline uint32_t make_topic(EventType type, uint8_t priority, uint8_t protocol)
+{ return type | (uint32_t)priority << 8 | (uint32_t)protocol << 16; }
+
+static inline void topic_bytes(uint32_t topic, uint8_t bytes[TOPIC_SIZE])
+{
+    bytes[0] = topic & 0xff;
+    bytes[1] = (topic >> 8) & 0xff;
+    bytes[2] = (topic >> 16) & 0xff;
+}
+
+//-------------------------------------------------------------------------
+// What the subscribers of all PUB sinks currently want, compiled like the
+// routing tables into sink bitmasks: one per subscription depth, so a
+// lookup is three direct loads plus a search only if someone subscribed to
+// full three byte topics.
+//-------------------------------------------------------------------------
+
+class TopicMasks
+{
+public:
+    uint64_t match(uint32_t topic) const
+    {
+        unsigned type = topic & 0xff;
+        unsigned priority = (topic >> 8) & 0xff;
+
+        uint64_t m = any | by_type[type] | by_priority[type][priority];
+
+        if (!exact.empty())
+            m |= find_exact(topic);
+
+        return m;
+    }
+
+private:
+    friend class TopicSubscriptions;
+
+    uint64_t find_exact(uint32_t topic) const;
+
+    uint64_t any = 0;
+    uint64_t by_type[EVENT_TYPE_MAX] = { };
+    uint64_t by_priority[EVENT_TYPE_MAX][256] = { };
+    std::vector<std::pair<uint32_t, uint64_t>> exact;   // sorted by topic
+};
+
+//-------------------------------------------------------------------------
+// Sender threads report subscribe and unsubscribe messages from their XPUB
+// sockets; a sink is wanted while any of its sockets has a subscriber for
+// the topic.  Packet threads ask before encoding, so a class of event that
+// nobody subscribed to is never encoded at all.
+//-------------------------------------------------------------------------
+
+class TopicSubscriptions
+{
+public:
+    // called from connect() before the senders start
+    void set_filtered(unsigned sink)
+    { filtered |= 1ULL << sink; }
+
+    // the sinks that want an event of this topic; sinks that are not PUB
+    // sockets always do
+    uint64_t wanted(uint32_t topic) const
+    {
+        if (!filtered)
+            return ~0ULL;
+
+        const TopicMasks* m = masks.get();
+        return ~filtered | (m ? m->match(topic) : 0);
+    }
+
+    // called from sender threads as subscribers come and go
+    void update(unsigned sink, const std::string& prefix, bool subscribe);
+
+private:
+    void compile();
+
+    uint64_t filtered = 0;
+
+    std::mutex update_mutex;
+    std::map<std::pair<std::string, unsigned>, unsigned> counts;
+    SwapHandle<TopicMasks> masks;
+};
+
+#endif
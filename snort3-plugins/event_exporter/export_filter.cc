@@ -0,0 +1,386 @@
+//--------------------------------------------------------------------------
+// export_filter.cc - BPF style pre-export filter over the 5-tuple
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "export_filter.h"
+
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <stdexcept>
+
+using namespace std;
+
+static const size_t MAX_INSNS = 4096;
+
+//-------------------------------------------------------------------------
+// The parser builds a small syntax tree, then emits it back to front: each
+// node is compiled knowing where to go on true and on false, which is all
+// short-circuit and/or/not need.
+//-------------------------------------------------------------------------
+
+class FilterParser
+{
+public:
+    FilterParser(const string& expr, ExportFilter& f) : filter(f)
+    { tokenize(expr); }
+
+    void run();
+
+private:
+    enum Kind { AND, OR, NOT, TEST };
+
+    struct Node
+    {
+        Kind kind;
+        int a = -1;
+        int b = -1;
+        bool either = false;
+        ExportFilter::Insn test { };
+    };
+
+    void tokenize(const string&);
+
+    bool at_end() const
+    { return pos >= tokens.size(); }
+
+    const string& peek() const
+    { return tokens[pos]; }
+
+    bool accept(const char* a, const char* b = nullptr);
+    const string& next(const char* what);
+    [[noreturn]] void fail(const string& why) const;
+
+    int add(Node n)
+    {
+        nodes.emplace_back(n);
+        return (int)nodes.size() - 1;
+    }
+
+    int parse_or();
+    int parse_and();
+    int parse_not();
+    int parse_term();
+
+    static ExportFilter::Value to_value(const RouteAddr& a)
+    { return (ExportFilter::Value)a.hi << 64 | a.lo; }
+
+    int net_test(ExportFilter::Field src, bool either, const string&);
+    int port_test(ExportFilter::Field src, bool either, const string&, bool range);
+
+    uint16_t push(const ExportFilter::Insn&, uint16_t t, uint16_t f);
+    uint16_t emit(int node, uint16_t t, uint16_t f);
+
+private:
+    ExportFilter& filter;
+    vector<string> tokens;
+    size_t pos = 0;
+    vector<Node> nodes;
+};
+
+void FilterParser::tokenize(const string& expr)
+{
+    size_t i = 0;
+
+    while (i < expr.size())
+    {
+        char c = expr[i];
+
+        if (isspace((unsigned char)c))
+            ++i;
+
+        else if (c == '(' || c == ')' || c == '!')
+            tokens.emplace_back(1, expr[i++]);
+
+        else if (!expr.compare(i, 2, "&&") || !expr.compare(i, 2, "||"))
+        {
+            tokens.emplace_back(expr, i, 2);
+            i += 2;
+        }
+        else
+        {
+            size_t start = i;
+
+            while (i < expr.size() && !isspace((unsigned char)expr[i]) && expr[i] != '(' &&
+                expr[i] != ')' && expr[i] != '!' && expr.compare(i, 2, "&&") &&
+                expr.compare(i, 2, "||"))
+                ++i;
+
+            tokens.emplace_back(expr, start, i - start);
+        }
+    }
+}
+
+void FilterParser::fail(const string& why) const
+{
+    if (at_end())
+        throw runtime_error(why + " at end of expression");
+
+    throw runtime_error(why + " at '" + peek() + "'");
+}
+
+bool FilterParser::accept(const char* a, const char* b)
+{
+    if (!at_end() && (peek() == a || (b && peek() == b)))
+    {
+        ++pos;
+        return true;
+    }
+    return false;
+}
+
+const string& FilterParser::next(const char* what)
+{
+    if (at_end())
+        fail(string("expected ") + what);
+
+    return tokens[pos++];
+}
+
+int FilterParser::parse_or()
+{
+    int left = parse_and();
+
+    while (accept("or", "||"))
+    {
+        Node n;
+        n.kind = OR;
+        n.a = left;
+        n.b = parse_and();
+        left = add(n);
+    }
+    return left;
+}
+
+int FilterParser::parse_and()
+{
+    int left = parse_not();
+
+    while (accept("and", "&&"))
+    {
+        Node n;
+        n.kind = AND;
+        n.a = left;
+        n.b = parse_not();
+        left = add(n);
+    }
+    return left;
+}
+
+int FilterParser::parse_not()
+{
+    if (accept("not", "!"))
+    {
+        Node n;
+        n.kind = NOT;
+        n.a = parse_not();
+        return add(n);
+    }
+
+    if (accept("("))
+    {
+        int inner = parse_or();
+
+        if (!accept(")"))
+            fail("expected ')'");
+
+        return inner;
+    }
+    return parse_term();
+}
+
+int FilterParser::net_test(ExportFilter::Field src, bool either, const string& prefix)
+{
+    vector<pair<RouteAddr, RouteAddr>> nets;
+
+    if (!parse_route_nets(prefix, nets) || nets.size() != 1)
+        throw runtime_error("bad address or prefix '" + prefix + "'");
+
+    Node n;
+    n.kind = TEST;
+    n.either = either;
+    n.test.field = src;
+    n.test.lo = to_value(nets[0].first);
+    n.test.span = to_value(nets[0].second) - n.test.lo;
+    return add(n);
+}
+
+static bool parse_port(const string& s, unsigned long& v)
+{
+    if (s.empty() || !isdigit((unsigned char)s[0]))
+        return false;
+
+    char* end;
+    v = strtoul(s.c_str(), &end, 10);
+    return !*end && v <= USHRT_MAX;
+}
+
+int FilterParser::port_test(ExportFilter::Field src, bool either, const string& arg,
+    bool range)
+{
+    unsigned long lo, hi;
+    size_t dash = range ? arg.find('-') : string::npos;
+
+    if (range && dash == string::npos)
+        throw runtime_error("bad port range '" + arg + "'");
+
+    if (!parse_port(arg.substr(0, dash), lo) ||
+        (range && !parse_port(arg.substr(dash + 1), hi)))
+        throw runtime_error("bad port '" + arg + "'");
+
+    if (!range)
+        hi = lo;
+
+    if (hi < lo)
+        throw runtime_error("bad port range '" + arg + "'");
+
+    Node n;
+    n.kind = TEST;
+    n.either = either;
+    n.test.field = src;
+    n.test.lo = lo;
+    n.test.span = hi - lo;
+    return add(n);
+}
+
+int FilterParser::parse_term()
+{
+    bool either = true;
+    bool dst = false;
+
+    if (accept("src"))
+        either = false;
+    else if (accept("dst"))
+        either = false, dst = true;
+
+    const string& word = next("a term");
+
+    if (word == "host" || word == "net")
+        return net_test(dst ? ExportFilter::DST_ADDR : ExportFilter::SRC_ADDR, either,
+            next("an address"));
+
+    if (word == "port" || word == "portrange")
+        return port_test(dst ? ExportFilter::DST_PORT : ExportFilter::SRC_PORT, either,
+            next("a port"), word == "portrange");
+
+    if (!either)
+    {
+        --pos;
+        fail("expected host, net, port or portrange");
+    }
+
+    if (word == "ip" || word == "ip6")
+    {
+        // IPv4 is kept mapped into ::ffff:0:0/96
+        int v4 = net_test(ExportFilter::SRC_ADDR, false, "::ffff:0:0/96");
+
+        if (word == "ip")
+            return v4;
+
+        Node n;
+        n.kind = NOT;
+        n.a = v4;
+        return add(n);
+    }
+
+    vector<uint8_t> protos;
+    const string& name = word == "proto" ? next("a protocol") : word;
+
+    if (name.empty() || !parse_route_protocols(name, protos) || protos.size() != 1 ||
+        (word != "proto" && isdigit((unsigned char)name[0])))
+    {
+        --pos;
+        fail("unknown term");
+    }
+
+    Node n;
+    n.kind = TEST;
+    n.test.field = ExportFilter::PROTOCOL;
+    n.test.lo = protos[0];
+    return add(n);
+}
+
+uint16_t FilterParser::push(const ExportFilter::Insn& insn, uint16_t t, uint16_t f)
+{
+    if (filter.prog.size() >= MAX_INSNS)
+        throw runtime_error("expression too long");
+
+    filter.prog.emplace_back(insn);
+    filter.prog.back().jt = t;
+    filter.prog.back().jf = f;
+    return (uint16_t)(filter.prog.size() - 1);
+}
+
+uint16_t FilterParser::emit(int node, uint16_t t, uint16_t f)
+{
+    const Node& n = nodes[node];
+
+    switch (n.kind)
+    {
+    case AND:
+        return emit(n.a, emit(n.b, t, f), f);
+
+    case OR:
+        return emit(n.a, t, emit(n.b, t, f));
+
+    case NOT:
+        return emit(n.a, f, t);
+
+    case TEST:
+        break;
+    }
+
+    if (!n.either)
+        return push(n.test, t, f);
+
+    // either end: the src test falls through to the dst test
+    ExportFilter::Insn other = n.test;
+    other.field = n.test.field == ExportFilter::SRC_ADDR ?
+        ExportFilter::DST_ADDR : ExportFilter::DST_PORT;
+
+    return push(n.test, t, push(other, t, f));
+}
+
+void FilterParser::run()
+{
+    if (tokens.empty())
+        return;
+
+    int root = parse_or();
+
+    if (!at_end())
+        fail("unexpected token");
+
+    // the exits are never evaluated, only jumped to
+    ExportFilter::Insn exit { };
+    push(exit, 0, 0);
+    push(exit, 0, 0);
+
+    filter.entry = emit(root, ExportFilter::ACCEPT, ExportFilter::REJECT);
+}
+
+//-------------------------------------------------------------------------
+// ExportFilter
+//-------------------------------------------------------------------------
+
+bool ExportFilter::compile(const string& expr, string& error)
+{
+    prog.clear();
+    entry = 0;
+
+    try
+    {
+        FilterParser(expr, *this).run();
+    }
+    catch (const exception& e)
+    {
+        prog.clear();
+        error = e.what();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,120 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// export_filter.h - BPF style pre-export filter over the 5-tuple
+
+#ifndef EXPORT_FILTER_H
+#define EXPORT_FILTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "event_router.h"
+
+// what the filter looks at; addresses as in routing
+struct FilterKey
+{
+    RouteAddr src;
+    RouteAddr dst;
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint8_t protocol;
+};
+
+//-------------------------------------------------------------------------
+// A tcpdump-like expression; traffic that matches is exported:
+//
+//     expr  := expr or expr | expr and expr | not expr | ( expr ) | term
+//     term  := [src|dst] host ADDR | [src|dst] net PREFIX
+//            | [src|dst] port N | [src|dst] portrange N-M
+//            | proto NAME|N | tcp | udp | icmp | icmp6 | ip | ip6
+//
+// and/or/not may also be written &&, ||, !.  Without src or dst a term
+// matches either end.  The expression is compiled, like classic BPF, into
+// a flat array of tests that each jump to one of two successors, so
+// and/or short-circuit and evaluation is a tight loop without recursion
+// or allocation.
+//-------------------------------------------------------------------------
+
+class ExportFilter
+{
+public:
+    // an empty expression matches everything; returns false and sets
+    // error if the expression is malformed
+    bool compile(const std::string& expr, std::string& error);
+
+    bool empty() const
+    { return prog.empty(); }
+
+    bool match(const FilterKey& k) const
+    {
+        if (prog.empty())
+            return true;
+
+        // every test is a range check on one of these, so the loop body is
+        // one subtract and compare with no dispatch on the kind of test
+        const Value v[FIELD_MAX] =
+        {
+            (Value)k.src.hi << 64 | k.src.lo,
+            (Value)k.dst.hi << 64 | k.dst.lo,
+            k.src_port,
+            k.dst_port,
+            k.protocol,
+        };
+        unsigned pc = entry;
+
+        while (pc > REJECT)
+        {
+            const Insn& i = prog[pc];
+            pc = v[i.field] - i.lo <= i.span ? i.jt : i.jf;
+        }
+        return pc == ACCEPT;
+    }
+
+    // number of tests, for show()
+    size_t size() const
+    { return prog.empty() ? 0 : prog.size() - 2; }
+
+private:
+    __extension__ typedef unsigned __int128 Value;
+
+    enum Field : uint8_t
+    {
+        SRC_ADDR,
+        DST_ADDR,
+        SRC_PORT,
+        DST_PORT,
+        PROTOCOL,
+        FIELD_MAX
+    };
+
+    // prog[ACCEPT] and prog[REJECT] are the two exits
+    enum : uint16_t { ACCEPT, REJECT };
+
+    struct Insn
+    {
+        Value lo;
+        Value span;         // hi - lo
+        uint16_t jt;
+        uint16_t jf;
+        Field field;
+    };
+
+    friend class FilterParser;
+
+    std::vector<Insn> prog;
+    uint16_t entry = 0;
+};
+
+#endif
@@ -0,0 +1,523 @@
+//--------------------------------------------------------------------------
+// file_sink.cc - Rotating local event archive
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "file_sink.h"
+
+#include "log/messages.h"
+
+#include <endian.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "ai_event_exporter.h"
+
+using namespace snort;
+using namespace std;
+
+static const size_t BUFFER_SIZE = 256 * 1024;
+static const unsigned BUFFER_COUNT = 8;
+static const size_t BLOCK_SIZE = 4096;
+static const size_t FRAME_HEADER = sizeof(uint32_t);
+
+// how often the rotator retries a failed open
+static const chrono::seconds OPEN_RETRY(1);
+
+//-------------------------------------------------------------------------
+// FileRotator
+//-------------------------------------------------------------------------
+
+FileRotator::FileRotator(const string& b, unsigned s, bool d)
+    : base(b), sender(s), direct(d)
+{
+}
+
+FileRotator::~FileRotator()
+{
+    if (thread)
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        cond.notify_one();
+        thread->join();
+        delete thread;
+    }
+
+    for (int fd : retired)
+        ::close(fd);
+
+    for (const auto& s : stamping)
+        stamp(s);
+
+    // the pre-opened file was never written
+    if (next_fd >= 0)
+    {
+        ::close(next_fd);
+        unlink(next_path.c_str());
+    }
+}
+
+int FileRotator::open_file(string& path, unsigned& seq)
+{
+    int flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+
+    if (direct)
+        flags |= O_DIRECT;
+
+    while (true)
+    {
+        seq = sequence++;
+        path = base + "." + to_string(sender) + "." + to_string(seq) + ".next";
+
+        int fd = ::open(path.c_str(), flags, 0640);
+
+        if (fd >= 0 || errno != EEXIST)
+            return fd;
+    }
+}
+
+void FileRotator::stamp(const Stamp& s)
+{
+    char when[32];
+    struct tm tm;
+    strftime(when, sizeof(when), "%Y%m%d-%H%M%S", gmtime_r(&s.at, &tm));
+
+    // the sequence keeps names unique within a second and orders the
+    // files; link() rather than rename() so an older run's file is kept
+    unsigned seq = s.seq;
+
+    while (true)
+    {
+        string path = base + "." + to_string(sender) + "." + when + "." +
+            to_string(seq) + ".evt";
+
+        if (!link(s.path.c_str(), path.c_str()))
+        {
+            unlink(s.path.c_str());
+            return;
+        }
+
+        if (errno != EEXIST)
+        {
+            ErrorMessage("AI Event Exporter: cannot rename %s: %s\n", s.path.c_str(),
+                strerror(errno));
+            return;
+        }
+        seq = sequence++;
+    }
+}
+
+int FileRotator::open_first()
+{
+    string path;
+    unsigned seq;
+    int fd = open_file(path, seq);
+
+    if (fd < 0)
+        throw runtime_error("cannot create " + path + ": " + strerror(errno));
+
+    stamp({ path, seq, time(nullptr) });
+
+    thread = new std::thread(&FileRotator::run, this);
+    return fd;
+}
+
+int FileRotator::take_next()
+{
+    unique_lock<mutex> guard(lock, try_to_lock);
+
+    if (!guard.owns_lock() || next_fd < 0)
+        return -1;
+
+    // named for now, when the sink starts writing it, not for when it
+    // was opened
+    stamping.push_back({ next_path, next_seq, time(nullptr) });
+
+    int fd = next_fd;
+    next_fd = -1;
+    cond.notify_one();
+    return fd;
+}
+
+void FileRotator::retire(int fd)
+{
+    {
+        lock_guard<mutex> guard(lock);
+        retired.emplace_back(fd);
+    }
+    cond.notify_one();
+}
+
+void FileRotator::run()
+{
+    unique_lock<mutex> guard(lock);
+
+    while (!stopping)
+    {
+        while (!stamping.empty())
+        {
+            Stamp s = stamping.front();
+            stamping.pop_front();
+
+            guard.unlock();
+            stamp(s);
+            guard.lock();
+        }
+
+        while (!retired.empty())
+        {
+            int fd = retired.front();
+            retired.pop_front();
+
+            guard.unlock();
+            fdatasync(fd);
+            ::close(fd);
+            guard.lock();
+        }
+
+        if (next_fd < 0)
+        {
+            string path;
+            unsigned seq;
+
+            guard.unlock();
+            int fd = open_file(path, seq);
+            guard.lock();
+
+            if (fd >= 0)
+            {
+                next_fd = fd;
+                next_path = path;
+                next_seq = seq;
+            }
+            else
+                ErrorMessage("AI Event Exporter: cannot create %s: %s\n", path.c_str(),
+                    strerror(errno));
+        }
+
+        cond.wait_for(guard, OPEN_RETRY, [this]()
+            { return stopping || !stamping.empty() || !retired.empty() || next_fd < 0; });
+    }
+}
+
+//-------------------------------------------------------------------------
+// FileSink
+//-------------------------------------------------------------------------
+
+FileSink::FileSink(const string& ep, const string& path, unsigned sender,
+    const AIEventExporterConfig& config)
+    : EventSink(ep), direct(config.file_direct_io),
+      rotate_size((uint64_t)config.file_rotate_size << 20),
+      rotate_interval(config.file_rotate_interval),
+      flush_age(config.flush_interval < 1000 ? 1 : config.flush_interval / 1000),
+      rotator(path, sender, config.file_direct_io)
+{
+}
+
+FileSink::~FileSink()
+{
+    if (fd >= 0)
+        ::close(fd);
+
+    for (auto& b : buffers)
+        free(b.data);
+
+#ifdef HAVE_LIBURING
+    if (uring)
+        io_uring_queue_exit(&ring);
+#endif
+}
+
+void FileSink::open()
+{
+    fd = rotator.open_first();
+    opened = time(nullptr);
+
+#ifdef HAVE_LIBURING
+    uring = io_uring_queue_init(BUFFER_COUNT * 2, &ring, 0) == 0;
+
+    if (!uring)
+        WarningMessage("AI Event Exporter: io_uring unavailable, archiving with pwritev\n");
+#endif
+
+    LogMessage("AI Event Exporter: archiving to %s\n", endpoint.c_str());
+}
+
+void FileSink::setup_buffers()
+{
+    // allocated by the sender thread, so the buffers live on its node
+    buffers.resize(BUFFER_COUNT);
+
+    for (auto& b : buffers)
+    {
+        void* p = nullptr;
+
+        if (posix_memalign(&p, BLOCK_SIZE, BUFFER_SIZE))
+            throw bad_alloc();
+
+        b.data = (uint8_t*)p;
+    }
+
+#ifdef HAVE_LIBURING
+    if (uring)
+    {
+        struct iovec iov[BUFFER_COUNT];
+
+        for (unsigned i = 0; i < BUFFER_COUNT; ++i)
+        {
+            iov[i].iov_base = buffers[i].data;
+            iov[i].iov_len = BUFFER_SIZE;
+        }
+
+        if (io_uring_register_buffers(&ring, iov, BUFFER_COUNT))
+        {
+            WarningMessage("AI Event Exporter: cannot register archive buffers, "
+                "archiving with pwritev\n");
+            io_uring_queue_exit(&ring);
+            uring = false;
+        }
+    }
+#endif
+}
+
+bool FileSink::next_buffer()
+{
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (unsigned i = 1; i <= BUFFER_COUNT; ++i)
+        {
+            unsigned idx = (current + i) % BUFFER_COUNT;
+
+            if (!buffers[idx].busy)
+            {
+                current = idx;
+                return true;
+            }
+        }
+        reap(false);
+    }
+    return false;
+}
+
+void FileSink::submit(unsigned idx)
+{
+    Buffer& b = buffers[idx];
+
+    if (b.busy || !b.used)
+        return;
+
+    if (direct)
+    {
+        // zero-length frame pads to the block boundary; keep room for it
+        size_t padded = (b.used + FRAME_HEADER + BLOCK_SIZE - 1) & ~(BLOCK_SIZE - 1);
+        memset(b.data + b.used, 0, padded - b.used);
+        b.used = padded;
+    }
+
+    uint64_t at = offset;
+    offset += b.used;
+    b.fd = fd;
+    b.busy = true;
+
+#ifdef HAVE_LIBURING
+    if (uring)
+    {
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+
+        if (!sqe)
+        {
+            io_uring_submit(&ring);
+            reap(true);
+            sqe = io_uring_get_sqe(&ring);
+        }
+
+        io_uring_prep_write_fixed(sqe, fd, b.data, b.used, at, idx);
+        io_uring_sqe_set_data(sqe, (void*)(uintptr_t)idx);
+        io_uring_submit(&ring);
+        ++in_flight;
+        return;
+    }
+#endif
+
+    struct iovec iov = { b.data, b.used };
+    ssize_t n = pwritev(fd, &iov, 1, at);
+    complete(idx, n < 0 ? -errno : (int)n);
+}
+
+void FileSink::complete(unsigned idx, int result)
+{
+    Buffer& b = buffers[idx];
+
+    if (result < 0 || (size_t)result != b.used)
+    {
+        if (!write_errors++)
+            ErrorMessage("AI Event Exporter: archive write failed: %s\n",
+                result < 0 ? strerror(-result) : "short write");
+    }
+
+    b.used = 0;
+    b.fd = -1;
+    b.busy = false;
+}
+
+void FileSink::reap(bool all)
+{
+#ifdef HAVE_LIBURING
+    while (uring && in_flight)
+    {
+        struct io_uring_cqe* cqe;
+        int rc = all ? io_uring_wait_cqe(&ring, &cqe) : io_uring_peek_cqe(&ring, &cqe);
+
+        if (rc)
+            break;
+
+        unsigned idx = (unsigned)(uintptr_t)io_uring_cqe_get_data(cqe);
+        int result = cqe->res;
+
+        io_uring_cqe_seen(&ring, cqe);
+        --in_flight;
+        complete(idx, result);
+    }
+#else
+    (void)all;
+#endif
+
+    release_retired();
+}
+
+void FileSink::release_retired()
+{
+    for (auto it = retiring.begin(); it != retiring.end(); )
+    {
+        bool writing = false;
+
+        for (auto& b : buffers)
+            writing = writing || (b.busy && b.fd == *it);
+
+        if (writing)
+            ++it;
+        else
+        {
+            rotator.retire(*it);
+            it = retiring.erase(it);
+        }
+    }
+}
+
+void FileSink::maybe_rotate(time_t now)
+{
+    bool due = (rotate_size && offset >= rotate_size) ||
+        (rotate_interval && now - opened >= (time_t)rotate_interval);
+
+    if (!due)
+        return;
+
+    // the helper thread keeps the next file open; if it is not ready yet
+    // keep writing this one rather than waiting
+    int next = rotator.take_next();
+
+    if (next < 0)
+        return;
+
+    submit(current);
+    next_buffer();
+
+    retiring.emplace_back(fd);
+    fd = next;
+    offset = 0;
+    opened = now;
+
+    release_retired();
+}
+
+bool FileSink::write(const EventRef& event)
+{
+    size_t need = FRAME_HEADER + event.size();
+
+    // leave room for a padding frame in direct mode
+    if (need + FRAME_HEADER > BUFFER_SIZE)
+    {
+        if (!write_errors++)
+            ErrorMessage("AI Event Exporter: %zu byte event too large to archive\n",
+                event.size());
+        return true;
+    }
+
+    if (buffers.empty())
+        setup_buffers();
+
+    if (buffers[current].busy && !next_buffer())
+        return false;
+
+    Buffer* b = &buffers[current];
+
+    if (b->used + need + FRAME_HEADER > BUFFER_SIZE)
+    {
+        submit(current);
+        maybe_rotate(time(nullptr));
+
+        if (buffers[current].busy && !next_buffer())
+            return false;
+
+        b = &buffers[current];
+    }
+
+    if (!b->used)
+        filled_since = time(nullptr);
+
+    uint32_t len = htole32((uint32_t)event.size());
+    memcpy(b->data + b->used, &len, FRAME_HEADER);
+    memcpy(b->data + b->used + FRAME_HEADER, event.data(), event.size());
+    b->used += need;
+
+    return true;
+}
+
+void FileSink::flush()
+{
+    if (buffers.empty())
+        return;
+
+    reap(false);
+
+    time_t now = time(nullptr);
+    Buffer& b = buffers[current];
+
+    // archives favour full buffers; partial ones go out once they age
+    if (!b.busy && b.used && now - filled_since >= (time_t)flush_age)
+    {
+        submit(current);
+        next_buffer();
+    }
+
+    maybe_rotate(now);
+}
+
+void FileSink::close(chrono::steady_clock::time_point)
+{
+    if (fd < 0)
+        return;
+
+    if (!buffers.empty())
+    {
+        submit(current);
+        reap(true);
+    }
+
+    retiring.emplace_back(fd);
+    fd = -1;
+    release_retired();
+}
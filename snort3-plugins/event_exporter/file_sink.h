@@ -0,0 +1,150 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// file_sink.h - Rotating local event archive
+
+#ifndef FILE_SINK_H
+#define FILE_SINK_H
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event_sink.h"
+
+//-------------------------------------------------------------------------
+// Archive files hold length-prefixed frames:
+//
+//     uint32_t length (little endian), length bytes of encoded event
+//
+// A zero length is padding; the reader skips to the next 4 KiB boundary.
+// Padding is only written with file_direct_io, where every write must be
+// block aligned.
+//
+// Frames are packed into page-aligned buffers that are registered with
+// io_uring and written asynchronously at reserved offsets; without
+// liburing the same buffers go out with pwritev().  Opening the next file
+// and closing finished ones happens on a helper thread so rotation never
+// blocks the sender.  The next file waits under a neutral .next name and
+// is renamed for the time the sink starts writing it.
+//-------------------------------------------------------------------------
+
+class FileRotator
+{
+public:
+    FileRotator(const std::string& base, unsigned sender, bool direct);
+    ~FileRotator();
+
+    // open the first file on the calling thread; throws on failure
+    int open_first();
+
+    // returns a ready descriptor for the next file or -1 if not ready yet
+    int take_next();
+
+    void retire(int fd);
+
+private:
+    struct Stamp
+    {
+        std::string path;
+        unsigned seq;
+        time_t at;
+    };
+
+    void run();
+    int open_file(std::string& path, unsigned& seq);
+    void stamp(const Stamp&);
+
+private:
+    const std::string base;
+    const unsigned sender;
+    const bool direct;
+    unsigned sequence = 0;
+
+    std::thread* thread = nullptr;
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<int> retired;
+    std::deque<Stamp> stamping;
+    int next_fd = -1;
+    std::string next_path;
+    unsigned next_seq = 0;
+    bool stopping = false;
+};
+
+class FileSink : public EventSink
+{
+public:
+    FileSink(const std::string& endpoint, const std::string& path, unsigned sender,
+        const AIEventExporterConfig&);
+    ~FileSink() override;
+
+    void open() override;
+    bool write(const EventRef& event) override;
+    void flush() override;
+    void close(std::chrono::steady_clock::time_point) override;
+
+private:
+    struct Buffer
+    {
+        uint8_t* data = nullptr;
+        size_t used = 0;
+        int fd = -1;
+        bool busy = false;
+    };
+
+    void setup_buffers();
+    bool next_buffer();
+    void submit(unsigned idx);
+    void reap(bool wait);
+    void complete(unsigned idx, int result);
+    void maybe_rotate(time_t now);
+    void release_retired();
+
+private:
+    const bool direct;
+    const uint64_t rotate_size;
+    const uint32_t rotate_interval;
+    const uint32_t flush_age;
+
+    FileRotator rotator;
+
+    std::vector<Buffer> buffers;
+    unsigned current = 0;
+    time_t filled_since = 0;
+
+    int fd = -1;
+    uint64_t offset = 0;
+    time_t opened = 0;
+    std::vector<int> retiring;
+
+    unsigned in_flight = 0;
+    uint64_t write_errors = 0;
+
+#ifdef HAVE_LIBURING
+    struct io_uring ring;
+    bool uring = false;
+#endif
+};
+
+#endif
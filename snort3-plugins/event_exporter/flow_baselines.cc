@@ -0,0 +1,259 @@
+//--------------------------------------------------------------------------
+// flow_baselines.cc - Per-port and per-host quantile baselines of flows
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "flow_baselines.h"
+
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using json = nlohmann::json;
+
+BaselinePegs baseline_pegs;
+
+const char* const FlowBaselines::metric_names[METRIC_MAX] =
+    { "bytes", "duration_ms", "packet_size" };
+
+// samples a packet thread can buffer between updates
+static const size_t MAX_SAMPLES = 65536;
+
+// a baseline needs this much weight before flows are ranked against it,
+// and is forgotten when it decays below the floor
+static const double MIN_RANKED = 20;
+static const double MIN_KEPT = 0.5;
+
+// port or host baselines per export record
+static const size_t PER_RECORD = 64;
+
+static const double QUANTILES[] = { 0.5, 0.9, 0.99 };
+
+static uint64_t now_ms()
+{
+    return chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+}
+
+FlowBaselines::FlowBaselines(const BaselineConfig& c, unsigned n)
+    : config(c), shards(new Shard[n]), threads(n), last_update(now_ms())
+{
+    vector<pair<RouteAddr, RouteAddr>> nets;
+
+    if (!parse_route_nets(config.nets, nets))
+        throw runtime_error("baseline_nets: bad prefix list");
+
+    inside.build(nets);
+
+    for (unsigned i = 0; i < n; ++i)
+        shards[i].samples.reserve(MAX_SAMPLES / 16);
+}
+
+void FlowBaselines::add(unsigned thread, const FlowSample& s)
+{
+    if (thread >= threads)
+        return;
+
+    Shard& sh = shards[thread];
+    lock_guard<mutex> lock(sh.lock);
+
+    if (sh.samples.size() < MAX_SAMPLES)
+        sh.samples.push_back(s);
+    else
+        sh.lost++;
+}
+
+bool FlowBaselines::rank(const FlowSample& s, FlowRanks& r) const
+{
+    const Published* p = published.get();
+
+    if (!p)
+        return false;
+
+    auto port = p->ports.find(s.port);
+
+    if ((r.port = port != p->ports.end()))
+        for (unsigned m = 0; m < METRIC_MAX; ++m)
+            r.port_rank[m] = port->second.metric[m].rank(s.values[m]);
+
+    // a flow is ranked against its client if that is internal, else its server
+    r.host_addr = internal(s.client) ? s.client : s.server;
+    auto host = internal(r.host_addr) ? p->hosts.find(r.host_addr) : p->hosts.end();
+
+    if ((r.host = host != p->hosts.end()))
+        for (unsigned m = 0; m < METRIC_MAX; ++m)
+            r.host_rank[m] = host->second.metric[m].rank(s.values[m]);
+
+    return r.port || r.host;
+}
+
+void FlowBaselines::add_sample(Sketches& k, const FlowSample& s)
+{
+    for (unsigned m = 0; m < METRIC_MAX; ++m)
+        k.metric[m].add(s.values[m]);
+}
+
+void FlowBaselines::decay(float f)
+{
+    for (auto it = ports.begin(); it != ports.end(); )
+    {
+        for (auto& m : it->second.metric)
+            m.scale(f);
+
+        it = it->second.metric[0].count() < MIN_KEPT ? ports.erase(it) : next(it);
+    }
+
+    for (auto it = hosts.begin(); it != hosts.end(); )
+    {
+        for (auto& m : it->second.metric)
+            m.scale(f);
+
+        it = it->second.metric[0].count() < MIN_KEPT ? hosts.erase(it) : next(it);
+    }
+}
+
+void FlowBaselines::publish()
+{
+    auto p = make_shared<Published>();
+
+    for (auto& k : ports)
+        if (k.second.metric[0].count() >= MIN_RANKED)
+            for (unsigned m = 0; m < METRIC_MAX; ++m)
+                p->ports[k.first].metric[m] = SketchCdf(k.second.metric[m]);
+
+    for (auto& k : hosts)
+        if (k.second.metric[0].count() >= MIN_RANKED)
+            for (unsigned m = 0; m < METRIC_MAX; ++m)
+                p->hosts[k.first].metric[m] = SketchCdf(k.second.metric[m]);
+
+    published.swap(p);
+}
+
+// counts are decayed floats; two decimals are plenty
+static double rounded(double v)
+{ return round(v * 100) / 100; }
+
+static json sketch_json(const DDSketch& s)
+{
+    json j;
+
+    for (double q : QUANTILES)
+        j["p" + to_string((int)round(q * 100))] = rounded(s.quantile(q));
+
+    j["offset"] = s.get_offset();
+    j["zero"] = rounded(s.get_zero());
+    j["bins"] = json::array();
+
+    for (float b : s.get_bins())
+        j["bins"].push_back(rounded(b));
+
+    return j;
+}
+
+void FlowBaselines::export_records(vector<json>& records, uint64_t started, uint64_t ended)
+{
+    size_t keys = ports.size() + hosts.size();
+    size_t parts = keys ? (keys + PER_RECORD - 1) / PER_RECORD : 1;
+    json record;
+
+    auto start = [&]()
+    {
+        record = json();
+        record["type"] = "baseline";
+        record["timestamp"] = ended;
+        record["interval_start"] = started;
+        record["interval_end"] = ended;
+        record["part"] = records.size();
+        record["parts"] = parts;
+        record["gamma"] = DDSketch::gamma();
+        record["halflife"] = config.halflife;
+        record["baselines"] = json::array();
+    };
+
+    auto add = [&](json&& b, const Sketches& k)
+    {
+        if (record["baselines"].size() == PER_RECORD)
+        {
+            records.emplace_back(std::move(record));
+            start();
+        }
+
+        b["count"] = rounded(k.metric[0].count());
+
+        for (unsigned m = 0; m < METRIC_MAX; ++m)
+            b["metrics"][metric_names[m]] = sketch_json(k.metric[m]);
+
+        record["baselines"].push_back(std::move(b));
+    };
+
+    start();
+
+    for (auto& k : ports)
+        add({ { "scope", "port" }, { "port", k.first } }, k.second);
+
+    for (auto& k : hosts)
+        add({ { "scope", "host" }, { "host", k.first.to_string() } }, k.second);
+
+    records.emplace_back(std::move(record));
+}
+
+void FlowBaselines::update(vector<json>& records)
+{
+    uint64_t started = last_update;
+    uint64_t lost = 0, skipped = 0;
+
+    last_update = now_ms();
+
+    // older weight halves every half-life, whatever the interval
+    double secs = (last_update - started) / 1000.0;
+    decay((float)pow(0.5, secs / max(config.halflife, 1u)));
+
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        Shard& s = shards[i];
+
+        // the packet thread only waits for a buffer swap
+        {
+            lock_guard<mutex> lock(s.lock);
+            s.samples.swap(taken);
+            lost += s.lost;
+            s.lost = 0;
+        }
+
+        for (auto& sample : taken)
+        {
+            add_sample(ports[sample.port], sample);
+
+            for (const RouteAddr* a : { &sample.client, &sample.server })
+            {
+                if (!internal(*a))
+                    continue;
+
+                auto h = hosts.find(*a);
+
+                if (h == hosts.end())
+                {
+                    if (hosts.size() >= config.hosts)
+                    {
+                        skipped++;
+                        continue;
+                    }
+                    h = hosts.emplace(*a, Sketches()).first;
+                }
+                add_sample(h->second, sample);
+            }
+        }
+        taken.clear();
+    }
+
+    publish();
+    export_records(records, started, last_update);
+
+    baseline_pegs.updates.fetch_add(1, memory_order_relaxed);
+    baseline_pegs.samples_lost.fetch_add(lost, memory_order_relaxed);
+    baseline_pegs.hosts_skipped.fetch_add(skipped, memory_order_relaxed);
+}
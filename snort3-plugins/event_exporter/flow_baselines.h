@@ -0,0 +1,161 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// flow_baselines.h - Per-port and per-host quantile baselines of flows
+
+#ifndef FLOW_BASELINES_H
+#define FLOW_BASELINES_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "dd_sketch.h"
+#include "event_router.h"
+#include "net_trie.h"
+#include "swap_handle.h"
+
+//-------------------------------------------------------------------------
+// Baselines of flow bytes, duration and mean packet size, as DDSketches
+// per server port and per internal host (an end inside baseline_nets).
+//
+// Packet threads only append a sample per ended flow to a buffer of their
+// own.  Once an interval the timer thread takes the buffers, decays
+// the sketches by the half-life, adds the samples, exports the sketches
+// and publishes their cumulative counts.  Packet threads rank each flow
+// against the published version: one lookup and one bin read per metric.
+//-------------------------------------------------------------------------
+
+struct BaselineConfig
+{
+    uint32_t interval = 0;      // seconds, 0 = off
+    uint32_t halflife = 3600;   // seconds
+    uint32_t hosts = 4096;
+    std::string nets;
+
+    bool enabled() const
+    { return interval > 0; }
+};
+
+enum BaselineMetric
+{
+    METRIC_BYTES,
+    METRIC_DURATION,
+    METRIC_PACKET_SIZE,
+    METRIC_MAX
+};
+
+struct FlowSample
+{
+    RouteAddr client;
+    RouteAddr server;
+    uint16_t port;
+    float values[METRIC_MAX];
+};
+
+// percentile ranks, 0 to 1, against the current baselines
+struct FlowRanks
+{
+    bool port = false;
+    bool host = false;
+    float port_rank[METRIC_MAX];
+    float host_rank[METRIC_MAX];
+    RouteAddr host_addr;
+};
+
+// totals for the module pegs
+struct BaselinePegs
+{
+    std::atomic<uint64_t> updates { 0 };
+    std::atomic<uint64_t> samples_lost { 0 };
+    std::atomic<uint64_t> hosts_skipped { 0 };
+};
+
+extern BaselinePegs baseline_pegs;
+
+class FlowBaselines
+{
+public:
+    // throws if nets does not parse
+    FlowBaselines(const BaselineConfig&, unsigned threads);
+
+    static const char* const metric_names[METRIC_MAX];
+
+    // called from the packet thread at flow end
+    void add(unsigned thread, const FlowSample&);
+    bool rank(const FlowSample&, FlowRanks&) const;
+
+    // called from one sender thread; the export records of the new baselines
+    void update(std::vector<nlohmann::json>& records);
+
+private:
+    struct Sketches
+    {
+        DDSketch metric[METRIC_MAX];
+    };
+
+    struct Cdfs
+    {
+        SketchCdf metric[METRIC_MAX];
+    };
+
+    struct AddrHash
+    {
+        size_t operator()(const RouteAddr& a) const
+        { return (a.hi * 0x9e3779b97f4a7c15ULL) ^ (a.lo * 0xc2b2ae3d27d4eb4fULL); }
+    };
+
+    struct Published
+    {
+        std::unordered_map<uint16_t, Cdfs> ports;
+        std::unordered_map<RouteAddr, Cdfs, AddrHash> hosts;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex lock;
+        std::vector<FlowSample> samples;
+        uint64_t lost = 0;
+    };
+
+    bool internal(const RouteAddr& a) const
+    { return !inside.empty() && inside.contains(a); }
+
+    void add_sample(Sketches&, const FlowSample&);
+    void decay(float);
+    void publish();
+    void export_records(std::vector<nlohmann::json>&, uint64_t started, uint64_t ended);
+
+    BaselineConfig config;
+    NetTrie inside;
+
+    std::unique_ptr<Shard[]> shards;
+    const unsigned threads;
+
+    // under update() only
+    std::vector<FlowSample> taken;
+    std::map<uint16_t, Sketches> ports;
+    std::map<RouteAddr, Sketches> hosts;
+    uint64_t last_update;
+
+    SwapHandle<Published> published;
+};
+
+#endif
@@ -0,0 +1,373 @@
+//--------------------------------------------------------------------------
+// host_profiles.cc - Per-host behaviour profiles kept in the data plane
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "host_profiles.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+using json = nlohmann::json;
+
+ProfilePegs profile_pegs;
+
+const char* const HostProfiles::metric_names[PROFILE_METRIC_MAX] =
+    { "bytes_out", "bytes_in", "peers", "new_ports", "active_hour" };
+
+static atomic<bool> snapshot_request { false };
+
+// per flow for bytes, per active hour for peers and new ports
+static const double FLOW_ALPHA = 1.0 / 64;
+static const double HOUR_ALPHA = 1.0 / 24;
+
+// smaller flows never deviate, whatever the host's usual
+static const uint64_t MIN_BYTES = 64 * 1024;
+
+// active hours a host needs before its hourly baselines are tested, and
+// seconds before a new hour of the day is anything but learning
+static const uint32_t MIN_HOURS = 24;
+static const uint64_t LEARNING = 24 * 3600;
+
+// deviations below these (log2 bytes, counts) are noise, not spread
+static const double MIN_LOG_SD = 0.5;
+static const double MIN_COUNT_SD = 1;
+
+// profiles per snapshot record
+static const size_t PER_PART = 256;
+
+static uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 33);
+}
+
+static uint64_t hash_addr(const RouteAddr& a)
+{ return mix(a.lo ^ mix(a.hi)); }
+
+//-------------------------------------------------------------------------
+// HyperLogLog over 64 registers, about 13% standard error
+//-------------------------------------------------------------------------
+
+static bool hll_add(uint8_t* regs, uint64_t h)
+{
+    unsigned i = h >> 58;
+    uint8_t rank = __builtin_clzll(h << 6 | 1ULL << 5) + 1;
+
+    if (rank <= regs[i])
+        return false;
+
+    regs[i] = rank;
+    return true;
+}
+
+static uint32_t hll_count(const uint8_t* regs, unsigned m)
+{
+    double sum = 0;
+    unsigned zeros = 0;
+
+    for (unsigned i = 0; i < m; ++i)
+    {
+        sum += ldexp(1.0, -regs[i]);
+        zeros += !regs[i];
+    }
+
+    double e = 0.709 * m * m / sum;
+
+    // linear counting while most registers are empty
+    if (e <= 2.5 * m && zeros)
+        e = m * log((double)m / zeros);
+
+    return (uint32_t)lround(e);
+}
+
+//-------------------------------------------------------------------------
+// HostProfiles
+//-------------------------------------------------------------------------
+
+void HostProfiles::Ewma::add(double x, double alpha, uint64_t n)
+{
+    double a = max(alpha, 1.0 / (n + 1));
+    double diff = x - mean;
+    double incr = a * diff;
+
+    mean += incr;
+    var = (1 - a) * (var + diff * incr);
+}
+
+double HostProfiles::Ewma::sd(double floor) const
+{
+    return max(sqrt(max((double)var, 0.0)), floor);
+}
+
+HostProfiles::HostProfiles(const ProfileConfig& c) : config(c)
+{
+    vector<pair<RouteAddr, RouteAddr>> nets;
+
+    if (!parse_route_nets(config.nets, nets))
+        throw runtime_error("profile_nets: bad prefix list");
+
+    inside.build(nets);
+
+    uint32_t n = 1;
+
+    while (n * WAYS < config.hosts)
+        n <<= 1;
+
+    sets.reset(new Set[n]);
+    set_mask = n - 1;
+
+    for (uint32_t i = 0; i < n; ++i)
+        for (auto& p : sets[i].ways)
+            p.used = false;
+}
+
+HostProfiles::Profile& HostProfiles::find(Set& s, const RouteAddr& host, uint64_t time)
+{
+    Profile* victim = nullptr;
+
+    for (auto& p : s.ways)
+    {
+        if (p.used && p.host == host)
+            return p;
+
+        if (!victim || (victim->used && (!p.used || p.last < victim->last)))
+            victim = &p;
+    }
+
+    if (victim->used)
+        profile_pegs.evicted.fetch_add(1, memory_order_relaxed);
+
+    Profile& p = *victim;
+
+    p = Profile();
+    p.host = host;
+    p.used = true;
+    p.first = p.last = time;
+    p.hour = (uint32_t)(time / 3600);
+
+    return p;
+}
+
+void HostProfiles::roll_hour(Profile& p, uint32_t hour)
+{
+    p.peers.add(hll_count(p.hour_peers, REGISTERS), HOUR_ALPHA, p.hours);
+    p.new_ports.add(p.hour_new_ports, HOUR_ALPHA, p.hours);
+    p.hours++;
+
+    memset(p.hour_peers, 0, sizeof(p.hour_peers));
+    p.hour_new_ports = 0;
+    p.reported = 0;
+    p.hour = hour;
+}
+
+bool HostProfiles::observe(const ProfileFlow& f, ProfileDeviation& d)
+{
+    Set& s = sets[hash_addr(f.host) & set_mask];
+    lock_guard<mutex> lock(s.lock);
+
+    Profile& p = find(s, f.host, f.time);
+    uint32_t hour = (uint32_t)(f.time / 3600);
+
+    // a flow of an earlier hour, ended late on another thread, counts in
+    // the current one
+    if (hour > p.hour && p.flows)
+        roll_hour(p, hour);
+
+    const bool mature = p.flows >= config.min_flows;
+    const bool hourly = mature && p.hours >= MIN_HOURS;
+    d.metrics = 0;
+
+    auto check = [&](ProfileMetric m, double value, double expected, double z)
+    {
+        if (z < config.zscore || (p.reported & (1u << m)))
+            return;
+
+        p.reported |= 1u << m;
+        d.metrics |= 1u << m;
+        d.value[m] = value;
+        d.expected[m] = expected;
+        d.zscore[m] = z;
+    };
+
+    // bytes, against the profile before this flow
+    double out = log2(1.0 + f.bytes_out), in = log2(1.0 + f.bytes_in);
+
+    if (mature && f.bytes_out >= MIN_BYTES)
+        check(PROFILE_BYTES_OUT, f.bytes_out, exp2(p.out.mean) - 1,
+            (out - p.out.mean) / p.out.sd(MIN_LOG_SD));
+
+    if (mature && f.bytes_in >= MIN_BYTES)
+        check(PROFILE_BYTES_IN, f.bytes_in, exp2(p.in.mean) - 1,
+            (in - p.in.mean) / p.in.sd(MIN_LOG_SD));
+
+    p.out.add(out, FLOW_ALPHA, p.flows);
+    p.in.add(in, FLOW_ALPHA, p.flows);
+
+    // peers, tested only when this hour's count may have grown
+    uint64_t peer = hash_addr(f.peer);
+    hll_add(p.all_peers, peer);
+
+    if (hll_add(p.hour_peers, peer) && hourly)
+    {
+        uint32_t n = hll_count(p.hour_peers, REGISTERS);
+        check(PROFILE_PEERS, n, p.peers.mean, (n - p.peers.mean) / p.peers.sd(MIN_COUNT_SD));
+    }
+
+    // ports the host connected to as a client, or served on
+    uint64_t h = mix((uint64_t)f.client << 16 | f.port);
+    unsigned b0 = h & (PORT_WORDS * 64 - 1), b1 = (h >> 16) & (PORT_WORDS * 64 - 1);
+    uint64_t m0 = 1ULL << (b0 & 63), m1 = 1ULL << (b1 & 63);
+
+    if ((p.ports[b0 >> 6] & m0) == 0 || (p.ports[b1 >> 6] & m1) == 0)
+    {
+        p.ports[b0 >> 6] |= m0;
+        p.ports[b1 >> 6] |= m1;
+
+        if (p.hour_new_ports < UINT16_MAX)
+            p.hour_new_ports++;
+
+        if (hourly)
+            check(PROFILE_NEW_PORTS, p.hour_new_ports, p.new_ports.mean,
+                (p.hour_new_ports - p.new_ports.mean) / p.new_ports.sd(MIN_COUNT_SD));
+    }
+
+    // an hour of the day the host was never active in; reported, not scored
+    uint32_t bit = 1u << (hour % 24);
+
+    if (!(p.active_hours & bit))
+    {
+        if (mature && f.time >= p.first + LEARNING)
+            check(PROFILE_ACTIVE_HOUR, hour % 24, 0, HUGE_VAL);
+
+        p.active_hours |= bit;
+    }
+
+    p.flows++;
+    p.last = max(p.last, f.time);
+
+    if (!d.metrics)
+        return false;
+
+    view(p, d.profile);
+    profile_pegs.deviations.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+void HostProfiles::view(const Profile& p, ProfileView& v) const
+{
+    v.host = p.host;
+    v.first_seen = p.first;
+    v.last_seen = p.last;
+    v.flows = p.flows;
+    v.hours = p.hours;
+    v.active_hours = p.active_hours;
+
+    v.bytes_out = exp2(p.out.mean) - 1;
+    v.bytes_out_spread = exp2(p.out.sd(0));
+    v.bytes_in = exp2(p.in.mean) - 1;
+    v.bytes_in_spread = exp2(p.in.sd(0));
+
+    v.peers = hll_count(p.all_peers, REGISTERS);
+    v.hour_peers = hll_count(p.hour_peers, REGISTERS);
+    v.peers_mean = p.peers.mean;
+    v.peers_sd = p.peers.sd(0);
+
+    v.hour_new_ports = p.hour_new_ports;
+    v.new_ports_mean = p.new_ports.mean;
+    v.new_ports_sd = p.new_ports.sd(0);
+}
+
+// two decimals are as much as an EWMA can tell apart
+static double rounded(double v)
+{ return round(v * 100) / 100; }
+
+json HostProfiles::to_json(const ProfileView& v)
+{
+    json j;
+
+    j["host"] = v.host.to_string();
+    j["first_seen"] = v.first_seen * 1000;
+    j["last_seen"] = v.last_seen * 1000;
+    j["flows"] = v.flows;
+    j["hours"] = v.hours;
+    j["active_hours"] = v.active_hours;
+
+    j["bytes_out"] = { { "typical", lround(v.bytes_out) },
+        { "spread", rounded(v.bytes_out_spread) } };
+    j["bytes_in"] = { { "typical", lround(v.bytes_in) },
+        { "spread", rounded(v.bytes_in_spread) } };
+
+    j["peers"] = v.peers;
+    j["peers_per_hour"] = { { "mean", rounded(v.peers_mean) }, { "sd", rounded(v.peers_sd) },
+        { "current", v.hour_peers } };
+    j["new_ports_per_hour"] = { { "mean", rounded(v.new_ports_mean) },
+        { "sd", rounded(v.new_ports_sd) }, { "current", v.hour_new_ports } };
+
+    return j;
+}
+
+void HostProfiles::snapshot(vector<json>& parts)
+{
+    vector<ProfileView> views;
+
+    // one set locked at a time, so packet threads barely notice
+    for (uint32_t i = 0; i <= set_mask; ++i)
+    {
+        lock_guard<mutex> lock(sets[i].lock);
+
+        for (auto& p : sets[i].ways)
+        {
+            if (!p.used)
+                continue;
+
+            views.emplace_back();
+            view(p, views.back());
+        }
+    }
+
+    uint64_t now = chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    size_t count = views.empty() ? 1 : (views.size() + PER_PART - 1) / PER_PART;
+    size_t i = 0;
+
+    do
+    {
+        json part;
+
+        part["type"] = "profile";
+        part["kind"] = "snapshot";
+        part["timestamp"] = now;
+        part["part"] = parts.size();
+        part["parts"] = count;
+        part["profiles"] = json::array();
+
+        for (size_t n = 0; n < PER_PART && i < views.size(); ++n)
+            part["profiles"].push_back(to_json(views[i++]));
+
+        parts.emplace_back(std::move(part));
+    }
+    while (i < views.size());
+
+    profile_pegs.snapshots.fetch_add(1, memory_order_relaxed);
+}
+
+void HostProfiles::request_snapshot()
+{
+    snapshot_request.store(true, memory_order_relaxed);
+}
+
+bool HostProfiles::snapshot_requested()
+{
+    return snapshot_request.exchange(false, memory_order_relaxed);
+}
@@ -0,0 +1,205 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// host_profiles.h - Per-host behaviour profiles kept in the data plane
+
+#ifndef HOST_PROFILES_H
+#define HOST_PROFILES_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "event_router.h"
+#include "net_trie.h"
+
+//-------------------------------------------------------------------------
+// Every ended flow updates the profile of each of its ends that is inside
+// profile_nets:
+//
+//   bytes out, in   EWMA mean and variance of log2 bytes per flow
+//   peers           HyperLogLog of distinct peers, ever and this hour
+//   new ports       ports (as client or server) not in the host's port
+//                   filter, counted per hour
+//   active hours    bit per UTC hour of the day the host had flows in
+//
+// Peers and new ports per active hour have EWMA baselines of their own,
+// folded in when the host's first flow of a later hour ends.  Once a host
+// has min_flows flows, a flow or hour zscore deviations above its baseline,
+// or activity in an hour of the day never seen after a day of learning,
+// is reported, at most once per kind per host and hour.
+//
+// The table is shared by the packet threads; each set of WAYS hosts has a
+// lock, and the least recently seen host of a full set makes room.
+//-------------------------------------------------------------------------
+
+struct ProfileConfig
+{
+    uint32_t hosts = 0;             // table size, 0 = off
+    std::string nets;
+    double zscore = 4;
+    uint32_t min_flows = 100;
+
+    bool enabled() const
+    { return hosts > 0; }
+};
+
+enum ProfileMetric
+{
+    PROFILE_BYTES_OUT,
+    PROFILE_BYTES_IN,
+    PROFILE_PEERS,
+    PROFILE_NEW_PORTS,
+    PROFILE_ACTIVE_HOUR,
+    PROFILE_METRIC_MAX
+};
+
+struct ProfileView
+{
+    RouteAddr host;
+    uint64_t first_seen;            // s
+    uint64_t last_seen;
+    uint64_t flows;
+    uint32_t hours;                 // active hours folded into the baselines
+    uint32_t active_hours;          // bit per UTC hour of the day
+
+    // geometric means and spreads (a factor) of bytes per flow
+    double bytes_out;
+    double bytes_out_spread;
+    double bytes_in;
+    double bytes_in_spread;
+
+    uint32_t peers;                 // distinct, estimated
+    uint32_t hour_peers;
+    double peers_mean;              // per active hour
+    double peers_sd;
+
+    uint32_t hour_new_ports;
+    double new_ports_mean;
+    double new_ports_sd;
+};
+
+struct ProfileDeviation
+{
+    uint32_t metrics;               // bit per ProfileMetric
+    double value[PROFILE_METRIC_MAX];
+    double expected[PROFILE_METRIC_MAX];
+    double zscore[PROFILE_METRIC_MAX];
+    ProfileView profile;
+};
+
+// what one end of an ended flow did
+struct ProfileFlow
+{
+    RouteAddr host;
+    RouteAddr peer;
+    uint16_t port;                  // server port
+    bool client;
+    uint64_t bytes_out;
+    uint64_t bytes_in;
+    uint64_t time;                  // s, packet time
+};
+
+// totals for the module pegs
+struct ProfilePegs
+{
+    std::atomic<uint64_t> deviations { 0 };
+    std::atomic<uint64_t> evicted { 0 };
+    std::atomic<uint64_t> snapshots { 0 };
+};
+
+extern ProfilePegs profile_pegs;
+
+class HostProfiles
+{
+public:
+    // throws if nets does not parse
+    HostProfiles(const ProfileConfig&);
+
+    static const char* const metric_names[PROFILE_METRIC_MAX];
+
+    bool internal(const RouteAddr& a) const
+    { return !inside.empty() && inside.contains(a); }
+
+    // called from the packet thread for each internal end of a flow; true
+    // with the deviations if any are newly reported
+    bool observe(const ProfileFlow&, ProfileDeviation&);
+
+    // all profiles, as "profile" snapshot records
+    void snapshot(std::vector<nlohmann::json>& parts);
+
+    // from the dump_profiles command on the main thread; the timer
+    // thread takes the request
+    static void request_snapshot();
+    static bool snapshot_requested();
+
+    static nlohmann::json to_json(const ProfileView&);
+
+private:
+    static constexpr unsigned WAYS = 4;
+    static constexpr unsigned REGISTERS = 64;
+    static constexpr unsigned PORT_WORDS = 16;
+
+    struct Ewma
+    {
+        float mean;
+        float var;
+
+        // the first 1 / alpha samples are averaged evenly
+        void add(double x, double alpha, uint64_t n);
+        double sd(double floor) const;
+    };
+
+    struct Profile
+    {
+        RouteAddr host;
+        bool used;
+        uint64_t first;
+        uint64_t last;
+        uint64_t flows;
+        uint32_t hour;              // since the epoch
+        uint32_t hours;
+        uint32_t active_hours;
+        uint32_t reported;          // metrics reported this hour
+        uint16_t hour_new_ports;
+        Ewma out;
+        Ewma in;
+        Ewma peers;
+        Ewma new_ports;
+        uint8_t all_peers[REGISTERS];
+        uint8_t hour_peers[REGISTERS];
+        uint64_t ports[PORT_WORDS];
+    };
+
+    struct alignas(64) Set
+    {
+        std::mutex lock;
+        Profile ways[WAYS];
+    };
+
+    Profile& find(Set&, const RouteAddr&, uint64_t time);
+    void roll_hour(Profile&, uint32_t hour);
+    void view(const Profile&, ProfileView&) const;
+
+    ProfileConfig config;
+    NetTrie inside;
+    std::unique_ptr<Set[]> sets;
+    uint32_t set_mask;
+};
+
+#endif
@@ -0,0 +1,214 @@
+//--------------------------------------------------------------------------
+// net_trie.cc - Radix trie for large include and exclude prefix lists
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "net_trie.h"
+
+#include <algorithm>
+#include <fstream>
+
+using namespace std;
+
+//-------------------------------------------------------------------------
+// NetTrie
+//-------------------------------------------------------------------------
+
+uint32_t NetTrie::add(Value key, unsigned bits, bool terminal)
+{
+    Node n;
+    n.key = key & mask(bits);
+    n.child[0] = n.child[1] = NONE;
+    n.bits = (uint8_t)bits;
+    n.terminal = terminal;
+
+    nodes.emplace_back(n);
+    return (uint32_t)(nodes.size() - 1);
+}
+
+unsigned NetTrie::common_bits(Value a, Value b)
+{
+    uint64_t hi = (uint64_t)(a >> 64) ^ (uint64_t)(b >> 64);
+    uint64_t lo = (uint64_t)a ^ (uint64_t)b;
+
+    if (hi)
+        return __builtin_clzll(hi);
+
+    return lo ? 64 + __builtin_clzll(lo) : 128;
+}
+
+void NetTrie::insert(Value key, unsigned bits)
+{
+    // links are indices, since adding a node may move the others
+    uint32_t parent = NONE;
+    unsigned side = 0;
+    uint32_t i = root;
+
+    auto link = [&](uint32_t to)
+    {
+        if (parent == NONE)
+            root = to;
+        else
+            nodes[parent].child[side] = to;
+    };
+
+    while (true)
+    {
+        if (i == NONE)
+        {
+            link(add(key, bits, true));
+            ++prefixes;
+            return;
+        }
+
+        unsigned common = min({ bits, (unsigned)nodes[i].bits, common_bits(key, nodes[i].key) });
+
+        if (common == nodes[i].bits)
+        {
+            // already covered
+            if (nodes[i].terminal)
+                return;
+
+            // prefixes are inserted shortest first, so this node is a
+            // branch point on the way to a longer prefix
+            parent = i;
+            side = bit(key, common);
+            i = nodes[i].child[side];
+            continue;
+        }
+
+        // split the edge into i at the first differing bit
+        uint32_t branch = add(key, common, false);
+        uint32_t leaf = add(key, bits, true);
+
+        nodes[branch].child[bit(nodes[i].key, common)] = i;
+        nodes[branch].child[bit(key, common)] = leaf;
+        link(branch);
+        ++prefixes;
+        return;
+    }
+}
+
+uint32_t NetTrie::descend(Value v, unsigned depth) const
+{
+    // walk as far as the first depth bits of v decide
+    uint32_t i = root;
+
+    while (i != NONE && nodes[i].bits <= depth)
+    {
+        const Node& n = nodes[i];
+
+        if ((v ^ n.key) & mask(n.bits))
+            return NONE;
+
+        if (n.terminal)
+            return HIT;
+
+        if (n.bits == depth)
+            break;
+
+        i = n.child[bit(v, n.bits)];
+    }
+    return i;
+}
+
+void NetTrie::build(const vector<pair<RouteAddr, RouteAddr>>& ranges)
+{
+    vector<pair<unsigned, Value>> sorted;
+
+    for (auto& r : ranges)
+    {
+        // a prefix range has all host bits clear in lo and set in hi
+        unsigned host = __builtin_popcountll(r.first.hi ^ r.second.hi) +
+            __builtin_popcountll(r.first.lo ^ r.second.lo);
+
+        sorted.emplace_back(128 - host, (Value)r.first.hi << 64 | r.first.lo);
+    }
+
+    // shortest first, so a covered prefix is dropped before it is stored
+    sort(sorted.begin(), sorted.end(), [](const pair<unsigned, Value>& a,
+        const pair<unsigned, Value>& b) { return a.first < b.first; });
+
+    nodes.clear();
+    nodes.reserve(2 * sorted.size());
+    root = NONE;
+    prefixes = 0;
+
+    for (auto& p : sorted)
+        insert(p.second, p.first);
+
+    nodes.shrink_to_fit();
+
+    const Value v4 = (Value)0xffff << 32;
+
+    for (unsigned c = 0; c < STARTS; ++c)
+    {
+        start_v4[c] = descend(v4 | (Value)c << (32 - STRIDE), 96 + STRIDE);
+        start_v6[c] = descend((Value)c << (128 - STRIDE), STRIDE);
+    }
+}
+
+//-------------------------------------------------------------------------
+// NetLists
+//-------------------------------------------------------------------------
+
+static bool load_list(const string& inline_list, const string& file,
+    vector<pair<RouteAddr, RouteAddr>>& nets, string& error)
+{
+    vector<pair<RouteAddr, RouteAddr>> line_nets;
+
+    if (!parse_route_nets(inline_list, nets))
+    {
+        error = "bad prefix in '" + inline_list + "'";
+        return false;
+    }
+
+    if (file.empty())
+        return true;
+
+    ifstream in(file);
+
+    if (!in)
+    {
+        error = "can't open " + file;
+        return false;
+    }
+
+    string line;
+    unsigned num = 0;
+
+    while (getline(in, line))
+    {
+        ++num;
+        line.erase(min(line.find('#'), line.size()));
+
+        if (!parse_route_nets(line, line_nets))
+        {
+            error = file + ":" + to_string(num) + ": bad prefix";
+            return false;
+        }
+        nets.insert(nets.end(), line_nets.begin(), line_nets.end());
+    }
+    return true;
+}
+
+shared_ptr<const NetLists> NetLists::load(const NetListConfig& config, string& error)
+{
+    vector<pair<RouteAddr, RouteAddr>> nets;
+    auto lists = make_shared<NetLists>();
+
+    if (!load_list(config.include_nets, config.include_nets_file, nets, error))
+        return nullptr;
+
+    lists->include.build(nets);
+
+    if (!load_list(config.exclude_nets, config.exclude_nets_file, nets, error))
+        return nullptr;
+
+    lists->exclude.build(nets);
+
+    return lists;
+}
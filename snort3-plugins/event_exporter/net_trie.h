@@ -0,0 +1,161 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// net_trie.h - Radix trie for large include and exclude prefix lists
+
+#ifndef NET_TRIE_H
+#define NET_TRIE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "event_router.h"
+#include "swap_handle.h"
+
+//-------------------------------------------------------------------------
+// A path compressed binary trie over 128 bit addresses (IPv4 mapped as in
+// routing).  Only membership matters, so a prefix covered by a shorter one
+// is never stored and the walk stops at the first prefix that contains the
+// address: a lookup touches at most one node per branching bit, about
+// log2(prefixes) nodes, instead of scanning the whole list.  The first
+// STRIDE bits of each family (after ::ffff:0:0/96 for IPv4) are resolved
+// by a direct table of where the walk would be at that depth, which skips
+// the densest levels of the trie.
+//-------------------------------------------------------------------------
+
+class NetTrie
+{
+public:
+    // ranges as returned by parse_route_nets
+    void build(const std::vector<std::pair<RouteAddr, RouteAddr>>&);
+
+    bool empty() const
+    { return root == NONE; }
+
+    bool contains(const RouteAddr& a) const
+    {
+        const Value v = (Value)a.hi << 64 | a.lo;
+        uint32_t i;
+
+        if (!a.hi && (a.lo >> 32) == 0xffff)
+            i = start_v4[(a.lo >> (32 - STRIDE)) & (STARTS - 1)];
+        else
+            i = start_v6[a.hi >> (64 - STRIDE)];
+
+        if (i == HIT)
+            return true;
+
+        while (i != NONE)
+        {
+            const Node& n = nodes[i];
+
+            if ((v ^ n.key) & mask(n.bits))
+                return false;
+
+            if (n.terminal)
+                return true;
+
+            i = n.child[bit(v, n.bits)];
+        }
+        return false;
+    }
+
+    // stored prefixes, after dropping covered ones
+    size_t size() const
+    { return prefixes; }
+
+private:
+    __extension__ typedef unsigned __int128 Value;
+
+    static constexpr uint32_t NONE = UINT32_MAX;    // miss
+    static constexpr uint32_t HIT = UINT32_MAX - 1;
+
+    static constexpr unsigned STRIDE = 12;
+    static constexpr unsigned STARTS = 1 << STRIDE;
+
+    struct Node
+    {
+        Value key;              // bits beyond the prefix are zero
+        uint32_t child[2];
+        uint8_t bits;           // 0 to 128; a 128 bit prefix has no children
+        bool terminal;
+    };
+
+    static Value mask(unsigned bits)
+    { return bits ? ~(Value)0 << (128 - bits) : 0; }
+
+    static unsigned bit(Value v, unsigned pos)
+    { return pos < 128 ? (unsigned)(v >> (127 - pos)) & 1 : 0; }
+
+    static unsigned common_bits(Value, Value);
+
+    uint32_t add(Value key, unsigned bits, bool terminal);
+    void insert(Value key, unsigned bits);
+    uint32_t descend(Value, unsigned depth) const;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> start_v4 = std::vector<uint32_t>(STARTS, NONE);
+    std::vector<uint32_t> start_v6 = std::vector<uint32_t>(STARTS, NONE);
+    uint32_t root = NONE;
+    size_t prefixes = 0;
+};
+
+//-------------------------------------------------------------------------
+// The include and exclude lists are compiled together and replaced as a
+// unit when the configuration is reloaded or reload_nets is run.
+//-------------------------------------------------------------------------
+
+struct NetListConfig
+{
+    std::string include_nets;
+    std::string exclude_nets;
+    std::string include_nets_file;
+    std::string exclude_nets_file;
+};
+
+class NetLists
+{
+public:
+    // returns null and sets error if a list or file is malformed
+    static std::shared_ptr<const NetLists> load(const NetListConfig&, std::string& error);
+
+    bool empty() const
+    { return include.empty() && exclude.empty(); }
+
+    // excluded if either end is excluded, else included if either end is
+    // included or there is no include list
+    bool allow(const RouteAddr& src, const RouteAddr& dst) const
+    {
+        if (!exclude.empty() && (exclude.contains(src) || exclude.contains(dst)))
+            return false;
+
+        return include.empty() || include.contains(src) || include.contains(dst);
+    }
+
+    size_t get_include_size() const
+    { return include.size(); }
+
+    size_t get_exclude_size() const
+    { return exclude.size(); }
+
+private:
+    NetTrie include;
+    NetTrie exclude;
+};
+
+typedef SwapHandle<NetLists> NetListsHandle;
+
+#endif
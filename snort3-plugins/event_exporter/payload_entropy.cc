@@ -0,0 +1,196 @@
+//--------------------------------------------------------------------------
+// payload_entropy.cc - Byte histogram features of a flow's first payload
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "payload_entropy.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+// c * log2(c) for every count a sample can have
+static float clogc[MAX_PAYLOAD_SAMPLE + 1];
+
+static bool fill_clogc()
+{
+    clogc[0] = 0;
+
+    for (size_t c = 1; c <= MAX_PAYLOAD_SAMPLE; ++c)
+        clogc[c] = (float)(c * log2((double)c));
+
+    return true;
+}
+
+static const bool clogc_filled = fill_clogc();
+
+//-------------------------------------------------------------------------
+// scalar
+//-------------------------------------------------------------------------
+
+void payload_features_scalar(const uint8_t* data, size_t n, PayloadFeatures& f)
+{
+    uint32_t hist[256] = { };
+
+    for (size_t i = 0; i < n; ++i)
+        hist[data[i]]++;
+
+    double h = 0;
+    unsigned distinct = 0, printable = 0, high = 0;
+
+    for (unsigned b = 0; b < 256; ++b)
+    {
+        if (!hist[b])
+            continue;
+
+        double p = (double)hist[b] / n;
+        h -= p * log2(p);
+        distinct++;
+
+        if ((b >= 0x20 && b < 0x7f) || b == '\t' || b == '\r' || b == '\n')
+            printable += hist[b];
+
+        else if (b >= 0x80)
+            high += hist[b];
+    }
+
+    f.bytes = (uint16_t)n;
+    f.distinct = distinct;
+    f.printable = printable;
+    f.zero = hist[0];
+    f.high = high;
+    f.entropy = (float)h;
+}
+
+//-------------------------------------------------------------------------
+// AVX2
+//-------------------------------------------------------------------------
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("avx2")))
+static inline uint32_t sum_epi32(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx2")))
+void payload_features_avx2(const uint8_t* data, size_t n, PayloadFeatures& f)
+{
+    // counts fit 16 bits since n <= MAX_PAYLOAD_SAMPLE
+    alignas(32) uint16_t sub[4][256] = { };
+    alignas(32) uint16_t counts[256];
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, data + i, sizeof(w));
+
+        sub[0][w & 0xff]++;
+        sub[1][(w >> 8) & 0xff]++;
+        sub[2][(w >> 16) & 0xff]++;
+        sub[3][(w >> 24) & 0xff]++;
+        sub[0][(w >> 32) & 0xff]++;
+        sub[1][(w >> 40) & 0xff]++;
+        sub[2][(w >> 48) & 0xff]++;
+        sub[3][w >> 56]++;
+    }
+
+    for (; i < n; ++i)
+        sub[i & 3][data[i]]++;
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i printable = zero, high = zero;
+    __m256 sum = _mm256_setzero_ps();
+    unsigned empty = 0;
+
+    for (unsigned b = 0; b < 256; b += 16)
+    {
+        __m256i c = _mm256_add_epi16(
+            _mm256_add_epi16(_mm256_load_si256((const __m256i*)&sub[0][b]),
+                _mm256_load_si256((const __m256i*)&sub[1][b])),
+            _mm256_add_epi16(_mm256_load_si256((const __m256i*)&sub[2][b]),
+                _mm256_load_si256((const __m256i*)&sub[3][b])));
+
+        _mm256_store_si256((__m256i*)&counts[b], c);
+
+        // two mask bits per empty bin
+        empty += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi16(c, zero))) / 2;
+
+        // bins 0x20 to 0x7f here; 0x7f comes off below
+        if (b >= 0x20 && b < 0x80)
+            printable = _mm256_add_epi32(printable, _mm256_madd_epi16(c, ones));
+
+        else if (b >= 0x80)
+            high = _mm256_add_epi32(high, _mm256_madd_epi16(c, ones));
+
+        __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(c));
+        __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(c, 1));
+
+        sum = _mm256_add_ps(sum, _mm256_i32gather_ps(clogc, lo, 4));
+        sum = _mm256_add_ps(sum, _mm256_i32gather_ps(clogc, hi, 4));
+    }
+
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x55));
+
+    // H = log2(n) - sum(c * log2(c)) / n
+    double h = n ? log2((double)n) - _mm_cvtss_f32(s) / n : 0;
+
+    f.bytes = (uint16_t)n;
+    f.distinct = 256 - empty;
+    f.printable = sum_epi32(printable) - counts[0x7f] + counts['\t'] + counts['\r'] +
+        counts['\n'];
+    f.zero = counts[0];
+    f.high = sum_epi32(high);
+    f.entropy = (float)max(h, 0.0);
+}
+
+static bool detect_avx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static const bool has_avx2 = detect_avx2();
+
+#else
+
+static const bool has_avx2 = false;
+
+#endif
+
+bool payload_features_simd()
+{
+    return has_avx2;
+}
+
+void payload_features(const uint8_t* data, size_t n, PayloadFeatures& f)
+{
+    n = min(n, MAX_PAYLOAD_SAMPLE);
+
+#if defined(__x86_64__) || defined(__i386__)
+    if (has_avx2)
+    {
+        payload_features_avx2(data, n, f);
+        return;
+    }
+#endif
+
+    payload_features_scalar(data, n, f);
+}
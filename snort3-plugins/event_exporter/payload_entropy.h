@@ -0,0 +1,58 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// payload_entropy.h - Byte histogram features of a flow's first payload
+
+#ifndef PAYLOAD_ENTROPY_H
+#define PAYLOAD_ENTROPY_H
+
+#include <cstddef>
+#include <cstdint>
+
+//-------------------------------------------------------------------------
+// Shannon entropy and byte class counts over the first payload bytes of a
+// flow direction.  Encrypted or compressed data is near 8 bits per byte
+// with all 256 values present; text stays printable and well below that.
+//
+// The AVX2 kernel counts into four interleaved histograms so consecutive
+// equal bytes do not wait on each other's stores, merges them 16 bins at a
+// time, and sums c * log2(c) from a table with gathers instead of calling
+// log2 for every bin.  It is picked at load time when the CPU has AVX2.
+//-------------------------------------------------------------------------
+
+struct PayloadFeatures
+{
+    uint16_t bytes = 0;         // sampled, 0 = no payload
+    uint16_t distinct = 0;      // byte values present
+    uint16_t printable = 0;     // 0x20 to 0x7e, tab, cr and lf
+    uint16_t zero = 0;
+    uint16_t high = 0;          // 0x80 and above
+    float entropy = 0;          // bits per byte
+};
+
+// the most bytes a sample may have
+static const size_t MAX_PAYLOAD_SAMPLE = 4096;
+
+// n is at most MAX_PAYLOAD_SAMPLE
+void payload_features(const uint8_t*, size_t n, PayloadFeatures&);
+
+// the implementations behind it, for the benchmark
+void payload_features_scalar(const uint8_t*, size_t n, PayloadFeatures&);
+
+#if defined(__x86_64__) || defined(__i386__)
+void payload_features_avx2(const uint8_t*, size_t n, PayloadFeatures&);
+#endif
+
+bool payload_features_simd();
+
+#endif
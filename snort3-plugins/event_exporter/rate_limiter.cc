@@ -0,0 +1,225 @@
+//--------------------------------------------------------------------------
+// rate_limiter.cc - Sensor wide export caps in events and bytes per second
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+using namespace std;
+
+RatePegs rate_pegs;
+
+constexpr chrono::milliseconds RateLimiter::REFILL_INTERVAL;
+
+// highest first; each type may borrow from those after it
+static const EventType borrow_order[EVENT_TYPE_MAX] =
+    { EVENT_ALERT, EVENT_BEACON, EVENT_PROFILE, EVENT_FLOW_END, EVENT_DNS, EVENT_FLOW,
+      EVENT_GRAPH, EVENT_BASELINE };
+
+// a bucket always holds at least one large event's worth of bytes
+static const int64_t MIN_BYTE_CAP = 64 * 1024;
+
+bool parse_rate_shares(const string& list, uint8_t shares[EVENT_TYPE_MAX])
+{
+    unsigned total = 0;
+
+    fill(shares, shares + EVENT_TYPE_MAX, 0);
+
+    istringstream in(list);
+    string w;
+
+    while (in >> w)
+    {
+        size_t colon = w.find(':');
+
+        if (colon == string::npos)
+            return false;
+
+        unsigned t = 0;
+
+        while (t < EVENT_TYPE_MAX && w.compare(0, colon, event_type_names[t]))
+            ++t;
+
+        char* end;
+        unsigned long pct = strtoul(w.c_str() + colon + 1, &end, 10);
+
+        if (t == EVENT_TYPE_MAX || *end || end == w.c_str() + colon + 1 || pct > 100)
+            return false;
+
+        shares[t] = (uint8_t)pct;
+        total += pct;
+    }
+    return total <= 100;
+}
+
+RateLimiter::RateLimiter(const RateLimitConfig& config, unsigned n)
+    : caches(new Cache[n]), threads(n), last_refill(chrono::steady_clock::now())
+{
+    const int64_t limits[KINDS] = { config.events, config.bytes };
+
+    // each thread takes about its part of one refill at a time
+    const int64_t refills = chrono::seconds(1) / REFILL_INTERVAL;
+
+    for (unsigned k = 0; k < KINDS; ++k)
+    {
+        limited[k] = limits[k] > 0;
+
+        for (unsigned t = 0; t < EVENT_TYPE_MAX; ++t)
+        {
+            Bucket& b = buckets[t];
+
+            b.rate[k] = limits[k] * config.shares[t] / 100;
+            b.cap[k] = b.rate[k];
+
+            if (k == BYTES && b.rate[k])
+                b.cap[k] = max(b.cap[k], MIN_BYTE_CAP);
+
+            b.batch[k] = max<int64_t>(1, b.rate[k] / (refills * threads));
+
+            // start with a full second's worth
+            b.tokens[k].store(b.cap[k], memory_order_relaxed);
+        }
+    }
+}
+
+RateLimiter::~RateLimiter()
+{
+    publish();
+}
+
+bool RateLimiter::fill(Cache& c, EventType type, Kind k, int64_t need)
+{
+    int64_t& have = c.tokens[type][k];
+    bool own = true;
+
+    for (EventType from : borrow_order)
+    {
+        if (own && from != type)
+            continue;
+
+        Bucket& b = buckets[from];
+
+        // a batch from our own bucket, only what is missing from others
+        int64_t want = own ? max(need - have, b.batch[k]) : need - have;
+        int64_t cur = b.tokens[k].load(memory_order_relaxed);
+        int64_t got = 0;
+
+        while (cur > 0)
+        {
+            got = min(cur, want);
+
+            if (b.tokens[k].compare_exchange_weak(cur, cur - got, memory_order_relaxed))
+                break;
+
+            got = 0;
+        }
+
+        if (got && !own)
+            c.borrowed.store(c.borrowed.load(memory_order_relaxed) + 1, memory_order_relaxed);
+
+        have += got;
+        own = false;
+
+        if (have >= need)
+            return true;
+    }
+    return false;
+}
+
+bool RateLimiter::take(unsigned thread, EventType type, size_t bytes)
+{
+    if (thread >= threads || type >= EVENT_TYPE_MAX)
+        return true;
+
+    Cache& c = caches[thread];
+    const int64_t need[KINDS] = { 1, (int64_t)bytes };
+
+    for (unsigned k = 0; k < KINDS; ++k)
+    {
+        if (!limited[k] || c.tokens[type][k] >= need[k])
+            continue;
+
+        // what was taken stays cached for the next event
+        if (!fill(c, type, (Kind)k, need[k]))
+        {
+            c.throttled[type].store(c.throttled[type].load(memory_order_relaxed) + 1,
+                memory_order_relaxed);
+            return false;
+        }
+    }
+
+    for (unsigned k = 0; k < KINDS; ++k)
+        if (limited[k])
+            c.tokens[type][k] -= need[k];
+
+    return true;
+}
+
+void RateLimiter::give_back(unsigned thread, EventType type, size_t bytes)
+{
+    if (thread >= threads || type >= EVENT_TYPE_MAX)
+        return;
+
+    Cache& c = caches[thread];
+    const int64_t need[KINDS] = { 1, (int64_t)bytes };
+
+    for (unsigned k = 0; k < KINDS; ++k)
+        if (limited[k])
+            c.tokens[type][k] += need[k];
+}
+
+void RateLimiter::refill(chrono::steady_clock::time_point now)
+{
+    double secs = chrono::duration<double>(now - last_refill).count();
+    last_refill = now;
+
+    for (auto& b : buckets)
+    {
+        for (unsigned k = 0; k < KINDS; ++k)
+        {
+            if (!b.rate[k])
+                continue;
+
+            b.carry[k] += b.rate[k] * secs;
+            int64_t add = (int64_t)b.carry[k];
+            b.carry[k] -= add;
+
+            int64_t cur = b.tokens[k].load(memory_order_relaxed);
+
+            while (cur < b.cap[k] &&
+                !b.tokens[k].compare_exchange_weak(cur, min(b.cap[k], cur + add),
+                    memory_order_relaxed))
+                ;
+        }
+    }
+    publish();
+}
+
+void RateLimiter::publish()
+{
+    for (unsigned t = 0; t < EVENT_TYPE_MAX; ++t)
+    {
+        uint64_t sum = 0;
+
+        for (unsigned i = 0; i < threads; ++i)
+            sum += caches[i].throttled[t].load(memory_order_relaxed);
+
+        rate_pegs.throttled[t].fetch_add(sum - published_throttled[t], memory_order_relaxed);
+        published_throttled[t] = sum;
+    }
+
+    uint64_t sum = 0;
+
+    for (unsigned i = 0; i < threads; ++i)
+        sum += caches[i].borrowed.load(memory_order_relaxed);
+
+    rate_pegs.borrowed.fetch_add(sum - published_borrowed, memory_order_relaxed);
+    published_borrowed = sum;
+}
@@ -0,0 +1,119 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// rate_limiter.h - Sensor wide export caps in events and bytes per second
+
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "event_router.h"
+
+//-------------------------------------------------------------------------
+// One token bucket per event type, each holding its share of the events
+// and bytes per second.  The exporter's timer thread refills them every few
+// milliseconds; packet threads take tokens in small batches into a cache
+// of their own, so most events cost no shared write at all.  A type whose
+// bucket is empty may borrow from the types below it, in the order
+// alert, beacon, profile, flow_end, dns, flow; a flow never takes an
+// alert's tokens.
+// Graph snapshots and baselines come from the timer thread and are not
+// limited.
+//
+// Tokens waiting in thread caches can overshoot the cap by at most one
+// refill's worth.
+//-------------------------------------------------------------------------
+
+struct RateLimitConfig
+{
+    uint32_t events = 0;        // per second, 0 = no limit
+    uint32_t bytes = 0;
+    uint8_t shares[EVENT_TYPE_MAX] = { 50, 25, 25, 0, 0, 0, 0, 0 };
+
+    bool enabled() const
+    { return events || bytes; }
+};
+
+// "alert:50 flow_end:25 flow:25"; percentages of the limits, unnamed
+// types get none of their own
+bool parse_rate_shares(const std::string&, uint8_t shares[EVENT_TYPE_MAX]);
+
+// totals over all limiters, for the module pegs
+struct RatePegs
+{
+    std::atomic<uint64_t> throttled[EVENT_TYPE_MAX] = { };
+    std::atomic<uint64_t> borrowed { 0 };
+};
+
+extern RatePegs rate_pegs;
+
+class RateLimiter
+{
+public:
+    RateLimiter(const RateLimitConfig&, unsigned threads);
+    ~RateLimiter();
+
+    static constexpr std::chrono::milliseconds REFILL_INTERVAL { 10 };
+
+    // called from the packet thread; false if the event must not go out
+    bool take(unsigned thread, EventType, size_t bytes);
+
+    // called from the packet thread when an event take() passed was not
+    // queued after all; its tokens go back to the thread's cache
+    void give_back(unsigned thread, EventType, size_t bytes);
+
+    // called from the timer thread only
+    void refill(std::chrono::steady_clock::time_point now);
+
+private:
+    enum Kind { EVENTS, BYTES, KINDS };
+
+    struct alignas(64) Bucket
+    {
+        std::atomic<int64_t> tokens[KINDS] = { };
+
+        int64_t rate[KINDS] = { };
+        int64_t cap[KINDS] = { };
+        int64_t batch[KINDS] = { };
+        double carry[KINDS] = { };  // fractions of a token not yet added
+    };
+
+    // written only by its packet thread
+    struct alignas(64) Cache
+    {
+        int64_t tokens[EVENT_TYPE_MAX][KINDS] = { };
+        std::atomic<uint64_t> throttled[EVENT_TYPE_MAX] = { };
+        std::atomic<uint64_t> borrowed { 0 };
+    };
+
+    bool fill(Cache&, EventType, Kind, int64_t need);
+    void publish();
+
+    bool limited[KINDS];
+    Bucket buckets[EVENT_TYPE_MAX];
+    std::unique_ptr<Cache[]> caches;
+    const unsigned threads;
+
+    std::chrono::steady_clock::time_point last_refill;
+
+    // what publish() already added to rate_pegs
+    uint64_t published_throttled[EVENT_TYPE_MAX] = { };
+    uint64_t published_borrowed = 0;
+};
+
+#endif
@@ -0,0 +1,213 @@
+//--------------------------------------------------------------------------
+// storm_breaker.cc - Per-sid alert rates and the circuit breaker for storms
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "storm_breaker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+StormPegs storm_pegs;
+
+// weight of each new second in the baseline, about a minute of memory
+static const double ALPHA = 1.0 / 64;
+
+// after this many silent seconds the baseline has decayed to nothing
+static const time_t MAX_GAP = 1024;
+
+static const unsigned SLOT_BITS = 11;
+
+StormBreaker::StormBreaker(const StormConfig& c) : config(c), table(new Entry[SLOTS]())
+{
+    static_assert(SLOTS == 1u << SLOT_BITS, "SLOTS must match SLOT_BITS");
+}
+
+StormBreaker::~StormBreaker()
+{
+    for (auto e : storming)
+        delete e->storm;
+
+    flush_pegs();
+}
+
+StormBreaker::Entry* StormBreaker::find(uint64_t key)
+{
+    unsigned h = (key * 0x9e3779b97f4a7c15ULL) >> (64 - SLOT_BITS);
+    Entry* free = nullptr;
+    Entry* victim = nullptr;
+
+    for (unsigned i = 0; i < PROBES; ++i)
+    {
+        Entry& e = table[(h + i) & (SLOTS - 1)];
+
+        if (e.key == key)
+            return &e;
+
+        if (!e.key)
+        {
+            if (!free)
+                free = &e;
+        }
+        // the quietest sid in the way makes room; storms are never evicted
+        else if (!e.storm && (!victim || e.mean < victim->mean))
+            victim = &e;
+    }
+
+    Entry* e = free ? free : victim;
+
+    if (e)
+        *e = { key, 0, 0, 0, 0, 0, nullptr };
+
+    return e;
+}
+
+double StormBreaker::trip_level(const Entry& e) const
+{
+    double level = numeric_limits<double>::infinity();
+
+    if (config.rate)
+        level = config.rate;
+
+    if (config.zscore > 0)
+    {
+        // counts are at least Poisson noisy, so a flat baseline is not exact
+        double sd = max({ sqrt(e.var), sqrt(e.mean), 1.0 });
+        level = min(level, max((double)config.min_rate, e.mean + config.zscore * sd));
+    }
+    return level;
+}
+
+void StormBreaker::roll(Entry& e, time_t now)
+{
+    if (now <= e.window)
+        return;
+
+    time_t gap = min(now - e.window - 1, MAX_GAP);
+
+    if (e.storm)
+    {
+        double quiet = trip_level(e) / 2;
+
+        e.storm->rate = gap ? 0 : e.count;
+        e.calm = (e.count < quiet ? e.calm + 1 : 0) + gap;
+    }
+    else
+    {
+        // the finished window, then a zero for each second without alerts
+        double x = e.count;
+
+        for (time_t i = 0; i <= gap; ++i, x = 0)
+        {
+            double diff = x - e.mean;
+            double incr = ALPHA * diff;
+
+            e.mean += incr;
+            e.var = (1 - ALPHA) * (e.var + diff * incr);
+        }
+    }
+    e.window = now;
+    e.count = 0;
+}
+
+StormBreaker::Verdict StormBreaker::check(uint32_t gid, uint32_t sid, time_t now, Storm*& storm)
+{
+    Entry* e = find((uint64_t)gid << 32 | sid);
+
+    // every slot in reach is storming; let it through rather than lose it
+    if (!e)
+        return PASS;
+
+    if (!e->window)
+        e->window = now;
+
+    roll(*e, now);
+    e->count++;
+
+    if (e->storm)
+    {
+        e->storm->suppressed++;
+        e->storm->total++;
+        suppressed++;
+        return SUPPRESS;
+    }
+
+    if (e->count <= trip_level(*e))
+        return PASS;
+
+    storm = e->storm = new Storm();
+    storm->gid = gid;
+    storm->sid = sid;
+    storm->started = now;
+    storm->rate = e->count;
+    storm->baseline = e->mean;
+    storm->deviation = sqrt(e->var);
+
+    e->calm = 0;
+    storming.push_back(e);
+    storms++;
+    return TRIP;
+}
+
+void StormBreaker::end(Entry& e, vector<StormReport>& reports)
+{
+    reports.push_back({ STORM_END, *e.storm });
+
+    delete e.storm;
+    e.storm = nullptr;
+    e.calm = 0;
+
+    storming.erase(find_if(storming.begin(), storming.end(),
+        [&e](const Entry* s) { return s == &e; }));
+}
+
+void StormBreaker::tick(time_t now, vector<StormReport>& reports)
+{
+    if (now <= last_tick)
+        return;
+
+    last_tick = now;
+
+    for (size_t i = 0; i < storming.size(); )
+    {
+        Entry& e = *storming[i];
+        roll(e, now);
+
+        if (e.calm >= config.recovery)
+        {
+            end(e, reports);
+            continue;
+        }
+        if (e.storm->suppressed)
+        {
+            reports.push_back({ STORM_ACTIVE, *e.storm });
+            e.storm->suppressed = 0;
+        }
+        ++i;
+    }
+    flush_pegs();
+}
+
+void StormBreaker::finish(vector<StormReport>& reports)
+{
+    while (!storming.empty())
+        end(*storming.back(), reports);
+
+    flush_pegs();
+}
+
+void StormBreaker::flush_pegs()
+{
+    // once a second rather than per alert, so threads in a storm do not
+    // fight over the counters
+    storm_pegs.storms.fetch_add(storms, memory_order_relaxed);
+    storm_pegs.alerts_suppressed.fetch_add(suppressed, memory_order_relaxed);
+
+    storms = suppressed = 0;
+}
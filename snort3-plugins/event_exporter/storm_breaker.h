@@ -0,0 +1,146 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// storm_breaker.h - Per-sid alert rates and the circuit breaker for storms
+
+#ifndef STORM_BREAKER_H
+#define STORM_BREAKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------
+// Each packet thread counts its alerts per gid:sid in one second windows
+// and keeps an exponentially weighted mean and variance of those counts.
+// A sid trips when a window's count passes the absolute rate, or passes
+// min_rate and lies zscore deviations above its baseline; from then on its
+// alerts are only counted and a storm record summarizes them once a second.
+// After recovery seconds below half the trip level the sid is let through
+// again.  The baseline is frozen while a storm lasts so the storm does not
+// become the new normal.
+//
+// Rates are per packet thread: a rule that misfires on a broad traffic
+// class does so on every thread at about the same rate.
+//-------------------------------------------------------------------------
+
+struct StormConfig
+{
+    uint32_t rate = 0;          // alerts per second that always trip, 0 = none
+    double zscore = 0;          // deviations above baseline that trip, 0 = none
+    uint32_t min_rate = 100;    // below this the z-score never trips
+    uint32_t recovery = 10;     // quiet seconds before a storm ends
+
+    bool enabled() const
+    { return rate || zscore > 0; }
+};
+
+enum StormState
+{
+    STORM_START,
+    STORM_ACTIVE,
+    STORM_END
+};
+
+struct Storm
+{
+    uint32_t gid;
+    uint32_t sid;
+    uint32_t rev;
+    uint32_t priority;
+    std::string msg;
+
+    // where the alert that tripped the breaker went; the summaries follow it
+    uint64_t routes;
+    uint32_t topic;
+
+    time_t started;
+    uint32_t rate;              // alerts in the last full second
+    double baseline;            // mean alerts per second before the storm
+    double deviation;
+    uint64_t suppressed;        // since the last summary
+    uint64_t total;             // since the storm started
+};
+
+struct StormReport
+{
+    StormState state;
+    Storm storm;
+};
+
+// totals over all packet threads, for the module pegs
+struct StormPegs
+{
+    std::atomic<uint64_t> storms { 0 };
+    std::atomic<uint64_t> alerts_suppressed { 0 };
+};
+
+extern StormPegs storm_pegs;
+
+class StormBreaker
+{
+public:
+    enum Verdict
+    {
+        PASS,
+        SUPPRESS,
+        TRIP        // the alert starts a storm; fill in the storm and report it
+    };
+
+    StormBreaker(const StormConfig&);
+    ~StormBreaker();
+
+    // counts an alert at packet time now; storm is set when it is TRIP
+    Verdict check(uint32_t gid, uint32_t sid, time_t now, Storm*& storm);
+
+    // once per second at most: summaries of the active storms, and the end
+    // of those that calmed down
+    void tick(time_t now, std::vector<StormReport>&);
+
+    // ends all storms, at thread exit
+    void finish(std::vector<StormReport>&);
+
+private:
+    struct Entry
+    {
+        uint64_t key;           // gid << 32 | sid, 0 if free
+        time_t window;
+        uint32_t count;         // alerts in window
+        uint32_t calm;          // quiet seconds in a storm
+        double mean;
+        double var;
+        Storm* storm;
+    };
+
+    static constexpr unsigned SLOTS = 2048;     // power of 2
+    static constexpr unsigned PROBES = 8;
+
+    Entry* find(uint64_t key);
+    void roll(Entry&, time_t now);
+    double trip_level(const Entry&) const;
+    void end(Entry&, std::vector<StormReport>&);
+    void flush_pegs();
+
+    StormConfig config;
+    std::unique_ptr<Entry[]> table;
+    std::vector<Entry*> storming;
+    time_t last_tick = 0;
+
+    uint64_t storms = 0;
+    uint64_t suppressed = 0;
+};
+
+#endif
@@ -0,0 +1,80 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// swap_handle.h - Read-mostly state replaced as a unit under packet threads
+
+#ifndef SWAP_HANDLE_H
+#define SWAP_HANDLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+//-------------------------------------------------------------------------
+// Compiled tables that packet threads read on every packet but that change
+// rarely (on reload, by control command, or as subscribers come and go).
+// Each reader thread keeps its own reference to the current version and
+// only takes the lock when the generation changes, so a swap never stalls
+// readers and an old version is freed when the last thread lets go of it.
+//-------------------------------------------------------------------------
+
+template<typename T>
+class SwapHandle
+{
+public:
+    void swap(std::shared_ptr<const T> next)
+    {
+        std::lock_guard<std::mutex> lock(swap_mutex);
+        current = std::move(next);
+        generation.store(next_generation(), std::memory_order_release);
+    }
+
+    // the current version as seen by the calling thread
+    const T* get() const
+    {
+        static thread_local Cache cache;
+        uint64_t g = generation.load(std::memory_order_acquire);
+
+        if (cache.owner != this || cache.generation != g)
+        {
+            std::lock_guard<std::mutex> lock(swap_mutex);
+            cache.owner = this;
+            cache.ptr = current;
+            cache.generation = generation.load(std::memory_order_relaxed);
+        }
+        return cache.ptr.get();
+    }
+
+private:
+    struct Cache
+    {
+        const SwapHandle* owner = nullptr;
+        uint64_t generation = 0;
+        std::shared_ptr<const T> ptr;
+    };
+
+    // unique across handles, so a new handle at a freed one's address is
+    // never mistaken for it
+    static uint64_t next_generation()
+    {
+        static std::atomic<uint64_t> last { 0 };
+        return last.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    mutable std::mutex swap_mutex;
+    std::shared_ptr<const T> current;
+    std::atomic<uint64_t> generation { 0 };
+};
+
+#endif
@@ -0,0 +1,107 @@
+//--------------------------------------------------------------------------
+// tcp_health.cc - Handshake timing, retransmits and zero windows of a flow
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "tcp_health.h"
+
+#include <algorithm>
+
+using namespace std;
+
+static const uint8_t FIN = 0x01;
+static const uint8_t SYN = 0x02;
+static const uint8_t RST = 0x04;
+static const uint8_t ACK = 0x10;
+
+// sequence numbers wrap
+static inline bool seq_lt(uint32_t a, uint32_t b)
+{ return (int32_t)(a - b) < 0; }
+
+static uint32_t elapsed_us(uint64_t from, uint64_t to)
+{ return to > from ? (uint32_t)min<uint64_t>(to - from, UINT32_MAX) : 0; }
+
+void TcpHealthTracker::add(uint8_t flags, uint32_t seq, uint16_t window, uint16_t len,
+    bool to_server, uint64_t us)
+{
+    if (flags & RST)
+        return;
+
+    // a retransmitted SYN or SYN-ACK restarts the timing, so the round
+    // trip is that of the one answered
+    if ((flags & (SYN | ACK)) == SYN)
+    {
+        if (to_server)
+            syn_us = us;
+    }
+    else if ((flags & (SYN | ACK)) == (SYN | ACK))
+    {
+        if (!to_server && syn_us)
+        {
+            syn_ack_us = us;
+            health.server_rtt_us = elapsed_us(syn_us, us);
+        }
+    }
+    else if (to_server && syn_ack_us && !health.client_rtt_us)
+        health.client_rtt_us = elapsed_us(syn_ack_us, us);
+
+    const unsigned i = to_server ? 0 : 1;
+    Direction& d = dirs[i];
+
+    // SYNs carry the unscaled window, so only later segments count
+    bool zero = !window && !(flags & SYN);
+
+    if (zero && !d.zero_window && health.zero_windows[i] < UINT16_MAX)
+        health.zero_windows[i]++;
+
+    d.zero_window = zero;
+
+    uint32_t seg_len = len + ((flags & SYN) ? 1 : 0) + ((flags & FIN) ? 1 : 0);
+
+    // pure ACKs and window updates have nothing to resend
+    if (!seg_len)
+        return;
+
+    uint32_t end = seq + seg_len;
+
+    if (!d.started)
+    {
+        d.started = true;
+        d.next = end;
+        return;
+    }
+
+    if (!seq_lt(seq, d.next))
+    {
+        // a jump past what was seen leaves a hole for later segments to fill
+        if (seq != d.next)
+        {
+            d.hole_start = d.next;
+            d.hole_end = seq;
+        }
+        d.next = end;
+        return;
+    }
+
+    // a keep-alive probe resends the last byte or nothing
+    if (len <= 1 && end == d.next && !(flags & (SYN | FIN)))
+        return;
+
+    if (!seq_lt(seq, d.hole_start) && seq_lt(seq, d.hole_end))
+    {
+        health.out_of_order[i]++;
+
+        // holes mostly fill from the front
+        if (seq == d.hole_start)
+            d.hole_start = seq_lt(end, d.hole_end) ? end : d.hole_end;
+    }
+    else
+        health.retransmits[i]++;
+
+    // a resent segment may carry new data past the old end
+    if (seq_lt(d.next, end))
+        d.next = end;
+}
@@ -0,0 +1,68 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// tcp_health.h - Handshake timing, retransmits and zero windows of a flow
+
+#ifndef TCP_HEALTH_H
+#define TCP_HEALTH_H
+
+#include <cstdint>
+
+//-------------------------------------------------------------------------
+// Worked out from the TCP header of each segment as it crossed the sensor,
+// reassembled copies left out.  The handshake gives two round trips: SYN
+// to SYN-ACK is the sensor to the server and back, SYN-ACK to ACK the
+// sensor to the client and back.
+//
+// Each direction keeps the highest sequence number seen and the last hole
+// a jump past it left.  A segment below the highest that lands in the
+// hole came out of order; any other is a retransmit.  Keep-alive probes
+// and pure ACKs are neither.
+//-------------------------------------------------------------------------
+
+struct TcpHealth
+{
+    uint32_t server_rtt_us = 0;         // SYN to SYN-ACK, 0 = not seen
+    uint32_t client_rtt_us = 0;         // SYN-ACK to ACK
+    uint32_t retransmits[2] = { 0, 0 }; // to server, to client
+    uint32_t out_of_order[2] = { 0, 0 };
+    uint16_t zero_windows[2] = { 0, 0 };    // times the sending side's window closed
+};
+
+class TcpHealthTracker
+{
+public:
+    // one segment; len is its payload and us its time
+    void add(uint8_t flags, uint32_t seq, uint16_t window, uint16_t len, bool to_server,
+        uint64_t us);
+
+    const TcpHealth& get() const
+    { return health; }
+
+private:
+    struct Direction
+    {
+        uint32_t next = 0;          // one past the highest sequence number seen
+        uint32_t hole_start = 0;
+        uint32_t hole_end = 0;
+        bool started = false;
+        bool zero_window = false;
+    };
+
+    TcpHealth health;
+    Direction dirs[2];
+    uint64_t syn_us = 0;
+    uint64_t syn_ack_us = 0;
+};
+
+#endif
@@ -0,0 +1,748 @@
+//--------------------------------------------------------------------------
+// tls_fingerprint.cc - JA3 and JA4 fingerprints of TLS hellos
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "tls_fingerprint.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+TlsPegs tls_pegs;
+
+static const uint8_t CONTENT_HANDSHAKE = 22;
+static const uint8_t HS_CLIENT_HELLO = 1;
+static const uint8_t HS_SERVER_HELLO = 2;
+
+// the largest record a peer may send, compression or not
+static const size_t MAX_RECORD = 16384 + 2048;
+
+static const uint16_t EXT_SERVER_NAME = 0x0000;
+static const uint16_t EXT_SUPPORTED_GROUPS = 0x000a;
+static const uint16_t EXT_EC_POINT_FORMATS = 0x000b;
+static const uint16_t EXT_SIGNATURE_ALGORITHMS = 0x000d;
+static const uint16_t EXT_ALPN = 0x0010;
+static const uint16_t EXT_SUPPORTED_VERSIONS = 0x002b;
+
+static const char hex_digits[] = "0123456789abcdef";
+
+//-------------------------------------------------------------------------
+// digests
+//-------------------------------------------------------------------------
+
+template<typename H>
+class Digest
+{
+public:
+    void update(const void* data, size_t n)
+    {
+        const uint8_t* p = (const uint8_t*)data;
+        total += n;
+
+        while (n)
+        {
+            size_t take = min(n, sizeof(buf) - used);
+            memcpy(buf + used, p, take);
+            used += take;
+            p += take;
+            n -= take;
+
+            if (used == sizeof(buf))
+            {
+                static_cast<H*>(this)->block(buf);
+                used = 0;
+            }
+        }
+    }
+
+protected:
+    // 0x80, zeros and the message length in bits
+    void pad(bool big_endian)
+    {
+        const uint64_t bits = total * 8;
+        const uint8_t one = 0x80, zero = 0;
+
+        update(&one, 1);
+
+        while (used != 56)
+            update(&zero, 1);
+
+        uint8_t len[8];
+
+        for (unsigned i = 0; i < 8; ++i)
+            len[i] = (uint8_t)(big_endian ? bits >> (56 - 8 * i) : bits >> (8 * i));
+
+        update(len, 8);
+    }
+
+    uint64_t total = 0;
+    uint8_t buf[64];
+    size_t used = 0;
+};
+
+static inline uint32_t rotl(uint32_t x, unsigned n)
+{ return (x << n) | (x >> (32 - n)); }
+
+static inline uint32_t rotr(uint32_t x, unsigned n)
+{ return (x >> n) | (x << (32 - n)); }
+
+class Md5 : public Digest<Md5>
+{
+public:
+    void final(uint8_t out[16]);
+    void block(const uint8_t*);
+
+private:
+    uint32_t h[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+};
+
+static const uint32_t md5_k[64] =
+{
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const uint8_t md5_shift[4][4] =
+    { { 7, 12, 17, 22 }, { 5, 9, 14, 20 }, { 4, 11, 16, 23 }, { 6, 10, 15, 21 } };
+
+void Md5::block(const uint8_t* p)
+{
+    uint32_t w[16];
+
+    for (unsigned i = 0; i < 16; ++i)
+        w[i] = p[4 * i] | p[4 * i + 1] << 8 | p[4 * i + 2] << 16 | (uint32_t)p[4 * i + 3] << 24;
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+
+    for (unsigned i = 0; i < 64; ++i)
+    {
+        uint32_t f;
+        unsigned g;
+
+        switch (i / 16)
+        {
+        case 0:
+            f = (b & c) | (~b & d);
+            g = i;
+            break;
+        case 1:
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) % 16;
+            break;
+        case 2:
+            f = b ^ c ^ d;
+            g = (3 * i + 5) % 16;
+            break;
+        default:
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+            break;
+        }
+
+        uint32_t t = d;
+        d = c;
+        c = b;
+        b += rotl(a + f + md5_k[i] + w[g], md5_shift[i / 16][i % 4]);
+        a = t;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+}
+
+void Md5::final(uint8_t out[16])
+{
+    pad(false);
+
+    for (unsigned i = 0; i < 16; ++i)
+        out[i] = (uint8_t)(h[i / 4] >> (8 * (i % 4)));
+}
+
+class Sha256 : public Digest<Sha256>
+{
+public:
+    void final(uint8_t out[32]);
+    void block(const uint8_t*);
+
+private:
+    uint32_t h[8] =
+    {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+};
+
+static const uint32_t sha256_k[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+void Sha256::block(const uint8_t* p)
+{
+    uint32_t w[64];
+
+    for (unsigned i = 0; i < 16; ++i)
+        w[i] = (uint32_t)p[4 * i] << 24 | p[4 * i + 1] << 16 | p[4 * i + 2] << 8 | p[4 * i + 3];
+
+    for (unsigned i = 16; i < 64; ++i)
+    {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+
+    for (unsigned i = 0; i < 64; ++i)
+    {
+        uint32_t t1 = k + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) +
+            sha256_k[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+        k = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += k;
+}
+
+void Sha256::final(uint8_t out[32])
+{
+    pad(true);
+
+    for (unsigned i = 0; i < 32; ++i)
+        out[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+static char* put_hex(char* o, const uint8_t* d, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        *o++ = hex_digits[d[i] >> 4];
+        *o++ = hex_digits[d[i] & 0xf];
+    }
+    return o;
+}
+
+//-------------------------------------------------------------------------
+// hello parsing
+//-------------------------------------------------------------------------
+
+// a hello with more than this many of anything is not fingerprinted
+static const unsigned MAX_VALUES = 128;
+
+struct ValueList
+{
+    uint16_t v[MAX_VALUES];
+    unsigned n = 0;
+
+    bool add(uint16_t x)
+    {
+        if (n == MAX_VALUES)
+            return false;
+
+        v[n++] = x;
+        return true;
+    }
+};
+
+struct Hello
+{
+    uint16_t version = 0;       // legacy_version
+    uint16_t supported = 0;     // highest supported_versions entry, 0 = none
+    ValueList ciphers;
+    ValueList extensions;
+    ValueList groups;
+    ValueList formats;
+    ValueList sigalgs;
+    bool sni = false;
+    const uint8_t* alpn = nullptr;  // the first protocol offered or the one chosen
+    uint8_t alpn_len = 0;
+};
+
+// bounds checked; once a read runs off the end every later one fails
+class Reader
+{
+public:
+    Reader(const uint8_t* d, size_t n, bool g = true) : p(d), end(d + n), good(g)
+    { }
+
+    bool ok() const
+    { return good; }
+
+    size_t left() const
+    { return end - p; }
+
+    uint8_t u8()
+    { return need(1) ? *p++ : 0; }
+
+    uint16_t u16()
+    {
+        if (!need(2))
+            return 0;
+
+        uint16_t v = p[0] << 8 | p[1];
+        p += 2;
+        return v;
+    }
+
+    const uint8_t* take(size_t n)
+    {
+        if (!need(n))
+            return nullptr;
+
+        const uint8_t* s = p;
+        p += n;
+        return s;
+    }
+
+    // a block behind a one or two byte length
+    Reader block(unsigned len_bytes)
+    {
+        size_t n = len_bytes == 1 ? u8() : u16();
+        const uint8_t* s = take(n);
+        return s ? Reader(s, n) : Reader(nullptr, 0, false);
+    }
+
+private:
+    bool need(size_t n)
+    {
+        good = good && left() >= n;
+        return good;
+    }
+
+    const uint8_t* p;
+    const uint8_t* end;
+    bool good;
+};
+
+// 0x0a0a, 0x1a1a, ... 0xfafa
+static bool grease(uint16_t v)
+{ return (v & 0x0f0f) == 0x0a0a && (v >> 8) == (v & 0xff); }
+
+static bool read_list(Reader r, ValueList& list)
+{
+    while (r.left() >= 2)
+    {
+        uint16_t v = r.u16();
+
+        if (!grease(v) && !list.add(v))
+            return false;
+    }
+    return true;
+}
+
+static TlsHello handshake(const uint8_t* data, size_t len, uint8_t type, Reader& body)
+{
+    if (!len || data[0] != CONTENT_HANDSHAKE)
+        return TLS_HELLO_NONE;
+
+    if (len < 5)
+        return TLS_HELLO_PARTIAL;
+
+    size_t record = data[3] << 8 | data[4];
+
+    if (data[1] != 3 || record < 4 || record > MAX_RECORD)
+        return TLS_HELLO_NONE;
+
+    if (len < 5 + record)
+        return TLS_HELLO_PARTIAL;
+
+    const uint8_t* h = data + 5;
+    size_t n = h[1] << 16 | h[2] << 8 | h[3];
+
+    // a hello split over records is not followed
+    if (h[0] != type || n > record - 4)
+        return TLS_HELLO_NONE;
+
+    body = Reader(h + 4, n);
+    return TLS_HELLO_DONE;
+}
+
+static bool read_extensions(Reader& r, Hello& hello, bool client)
+{
+    // a hello may end without any
+    if (!r.left())
+        return true;
+
+    Reader exts = r.block(2);
+
+    while (exts.ok() && exts.left())
+    {
+        uint16_t type = exts.u16();
+        Reader data = exts.block(2);
+
+        if (!exts.ok())
+            return false;
+
+        if (grease(type))
+            continue;
+
+        if (!hello.extensions.add(type))
+            return false;
+
+        // a malformed body leaves its list short but the fingerprint stands
+        switch (type)
+        {
+        case EXT_SERVER_NAME:
+            hello.sni = true;
+            break;
+
+        case EXT_SUPPORTED_GROUPS:
+            if (!read_list(data.block(2), hello.groups))
+                return false;
+            break;
+
+        case EXT_EC_POINT_FORMATS:
+        {
+            Reader formats = data.block(1);
+
+            while (formats.left())
+                if (!hello.formats.add(formats.u8()))
+                    return false;
+            break;
+        }
+
+        case EXT_SIGNATURE_ALGORITHMS:
+            if (!read_list(data.block(2), hello.sigalgs))
+                return false;
+            break;
+
+        case EXT_ALPN:
+        {
+            Reader list = data.block(2);
+            Reader first = list.block(1);
+
+            if (first.ok() && first.left())
+            {
+                hello.alpn_len = (uint8_t)first.left();
+                hello.alpn = first.take(first.left());
+            }
+            break;
+        }
+
+        case EXT_SUPPORTED_VERSIONS:
+            if (client)
+            {
+                Reader versions = data.block(1);
+
+                while (versions.left() >= 2)
+                {
+                    uint16_t v = versions.u16();
+
+                    if (!grease(v))
+                        hello.supported = max(hello.supported, v);
+                }
+            }
+            else
+                hello.supported = data.u16();
+            break;
+        }
+    }
+    return exts.ok();
+}
+
+//-------------------------------------------------------------------------
+// JA3
+//-------------------------------------------------------------------------
+
+template<typename H>
+static void put_decimal(H& h, unsigned v)
+{
+    char b[8];
+    char* o = b + sizeof(b);
+
+    do
+        *--o = '0' + v % 10;
+    while (v /= 10);
+
+    h.update(o, b + sizeof(b) - o);
+}
+
+template<typename H>
+static void put_decimals(H& h, const ValueList& list)
+{
+    for (unsigned i = 0; i < list.n; ++i)
+    {
+        if (i)
+            h.update("-", 1);
+
+        put_decimal(h, list.v[i]);
+    }
+}
+
+static void finish_md5(Md5& md5, char* out)
+{
+    uint8_t d[16];
+    md5.final(d);
+    *put_hex(out, d, sizeof(d)) = '\0';
+}
+
+// version,ciphers,extensions,groups,point formats
+static void ja3(const Hello& h, char* out)
+{
+    Md5 md5;
+
+    put_decimal(md5, h.version);
+    md5.update(",", 1);
+    put_decimals(md5, h.ciphers);
+    md5.update(",", 1);
+    put_decimals(md5, h.extensions);
+    md5.update(",", 1);
+    put_decimals(md5, h.groups);
+    md5.update(",", 1);
+    put_decimals(md5, h.formats);
+
+    finish_md5(md5, out);
+}
+
+// version,cipher,extensions
+static void ja3s(const Hello& h, char* out)
+{
+    Md5 md5;
+
+    put_decimal(md5, h.version);
+    md5.update(",", 1);
+    put_decimal(md5, h.ciphers.n ? h.ciphers.v[0] : 0);
+    md5.update(",", 1);
+    put_decimals(md5, h.extensions);
+
+    finish_md5(md5, out);
+}
+
+//-------------------------------------------------------------------------
+// JA4
+//-------------------------------------------------------------------------
+
+static char* put_version(char* o, uint16_t v)
+{
+    const char* s;
+
+    switch (v)
+    {
+    case 0x0304: s = "13"; break;
+    case 0x0303: s = "12"; break;
+    case 0x0302: s = "11"; break;
+    case 0x0301: s = "10"; break;
+    case 0x0300: s = "s3"; break;
+    case 0x0002: s = "s2"; break;
+    default: s = "00"; break;
+    }
+
+    *o++ = s[0];
+    *o++ = s[1];
+    return o;
+}
+
+static char* put_count(char* o, unsigned n)
+{
+    n = min(n, 99u);
+    *o++ = '0' + n / 10;
+    *o++ = '0' + n % 10;
+    return o;
+}
+
+static bool alnum(uint8_t c)
+{ return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+
+// first and last characters of the protocol, or of its hex when they are
+// not alphanumeric
+static char* put_alpn(char* o, const Hello& h)
+{
+    if (!h.alpn_len)
+    {
+        *o++ = '0';
+        *o++ = '0';
+    }
+    else if (alnum(h.alpn[0]) && alnum(h.alpn[h.alpn_len - 1]))
+    {
+        *o++ = h.alpn[0];
+        *o++ = h.alpn[h.alpn_len - 1];
+    }
+    else
+    {
+        *o++ = hex_digits[h.alpn[0] >> 4];
+        *o++ = hex_digits[h.alpn[h.alpn_len - 1] & 0xf];
+    }
+    return o;
+}
+
+static void put_hex_values(Sha256& sha, const ValueList& list)
+{
+    for (unsigned i = 0; i < list.n; ++i)
+    {
+        uint16_t v = list.v[i];
+        const char b[5] = { ',', hex_digits[v >> 12], hex_digits[(v >> 8) & 0xf],
+            hex_digits[(v >> 4) & 0xf], hex_digits[v & 0xf] };
+
+        sha.update(i ? b : b + 1, i ? 5 : 4);
+    }
+}
+
+// the first 12 hex digits of the digest, or zeros for an empty list
+static char* put_list_hash(char* o, const ValueList& list, const ValueList* sigalgs = nullptr)
+{
+    if (!list.n)
+    {
+        memset(o, '0', 12);
+        return o + 12;
+    }
+
+    Sha256 sha;
+    put_hex_values(sha, list);
+
+    if (sigalgs && sigalgs->n)
+    {
+        sha.update("_", 1);
+        put_hex_values(sha, *sigalgs);
+    }
+
+    uint8_t d[32];
+    sha.final(d);
+    return put_hex(o, d, 6);
+}
+
+// t13d1516h2_8daaf6152771_e5627efa2ab1
+static void ja4(const Hello& h, char* out)
+{
+    char* o = out;
+
+    *o++ = 't';
+    o = put_version(o, h.supported ? h.supported : h.version);
+    *o++ = h.sni ? 'd' : 'i';
+    o = put_count(o, h.ciphers.n);
+    o = put_count(o, h.extensions.n);
+    o = put_alpn(o, h);
+    *o++ = '_';
+
+    ValueList sorted = h.ciphers;
+    sort(sorted.v, sorted.v + sorted.n);
+    o = put_list_hash(o, sorted);
+    *o++ = '_';
+
+    // server name and ALPN are already in the first part
+    sorted.n = 0;
+
+    for (unsigned i = 0; i < h.extensions.n; ++i)
+        if (h.extensions.v[i] != EXT_SERVER_NAME && h.extensions.v[i] != EXT_ALPN)
+            sorted.add(h.extensions.v[i]);
+
+    sort(sorted.v, sorted.v + sorted.n);
+    o = put_list_hash(o, sorted, &h.sigalgs);
+    *o = '\0';
+}
+
+// t130200_1301_a56c5b993250
+static void ja4s(const Hello& h, char* out)
+{
+    char* o = out;
+
+    *o++ = 't';
+    o = put_version(o, h.supported ? h.supported : h.version);
+    o = put_count(o, h.extensions.n);
+    o = put_alpn(o, h);
+    *o++ = '_';
+
+    uint16_t cipher = h.ciphers.n ? h.ciphers.v[0] : 0;
+    uint8_t c[2] = { (uint8_t)(cipher >> 8), (uint8_t)cipher };
+    o = put_hex(o, c, 2);
+    *o++ = '_';
+
+    // in the order sent
+    o = put_list_hash(o, h.extensions);
+    *o = '\0';
+}
+
+//-------------------------------------------------------------------------
+// entry points
+//-------------------------------------------------------------------------
+
+TlsHello tls_client_fingerprint(const uint8_t* data, size_t len, TlsFingerprints& fp)
+{
+    Reader r(nullptr, 0);
+    TlsHello res = handshake(data, len, HS_CLIENT_HELLO, r);
+
+    if (res != TLS_HELLO_DONE)
+        return res;
+
+    Hello hello;
+
+    hello.version = r.u16();
+    r.take(32);     // random
+    r.block(1);     // session id
+
+    Reader ciphers = r.block(2);
+    r.block(1);     // compression methods
+
+    if (!r.ok() || !read_list(ciphers, hello.ciphers) || !read_extensions(r, hello, true))
+        return TLS_HELLO_NONE;
+
+    ja3(hello, fp.ja3);
+    ja4(hello, fp.ja4);
+
+    tls_pegs.client_hellos.fetch_add(1, memory_order_relaxed);
+    return TLS_HELLO_DONE;
+}
+
+TlsHello tls_server_fingerprint(const uint8_t* data, size_t len, TlsFingerprints& fp)
+{
+    Reader r(nullptr, 0);
+    TlsHello res = handshake(data, len, HS_SERVER_HELLO, r);
+
+    if (res != TLS_HELLO_DONE)
+        return res;
+
+    Hello hello;
+
+    hello.version = r.u16();
+    r.take(32);     // random
+    r.block(1);     // session id
+
+    uint16_t cipher = r.u16();
+    r.u8();         // compression method
+
+    if (!r.ok() || !read_extensions(r, hello, false))
+        return TLS_HELLO_NONE;
+
+    if (!grease(cipher))
+        hello.ciphers.add(cipher);
+
+    ja3s(hello, fp.ja3s);
+    ja4s(hello, fp.ja4s);
+
+    tls_pegs.server_hellos.fetch_add(1, memory_order_relaxed);
+    return TLS_HELLO_DONE;
+}
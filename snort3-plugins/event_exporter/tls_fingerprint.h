@@ -0,0 +1,65 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// tls_fingerprint.h - JA3 and JA4 fingerprints of TLS hellos
+
+#ifndef TLS_FINGERPRINT_H
+#define TLS_FINGERPRINT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//-------------------------------------------------------------------------
+// The hello is parsed in place into fixed arrays of its cipher suites,
+// extensions, groups and signature algorithms, GREASE values left out.
+// The JA3 strings are fed to MD5 piece by piece as they are formatted and
+// the JA4 lists to SHA-256, so a fingerprint costs no allocation and no
+// string of the whole list.  Results are the usual lower case hex.
+//
+//     ja3   md5 of version,ciphers,extensions,groups,point formats
+//     ja3s  md5 of version,cipher,extensions
+//     ja4   t13d1516h2_8daaf6152771_e5627efa2ab1
+//     ja4s  t130200_1301_a56c5b993250
+//-------------------------------------------------------------------------
+
+struct TlsFingerprints
+{
+    char ja3[33] = "";          // empty until the client hello is seen
+    char ja4[37] = "";
+    char ja3s[33] = "";         // empty until the server hello is seen
+    char ja4s[26] = "";
+};
+
+enum TlsHello
+{
+    TLS_HELLO_DONE,             // fingerprinted
+    TLS_HELLO_PARTIAL,          // a handshake record that is not all here yet
+    TLS_HELLO_NONE              // not a hello, or one that cannot be read
+};
+
+// data is the start of a direction's payload: a handshake record whose
+// first message is the hello
+TlsHello tls_client_fingerprint(const uint8_t* data, size_t len, TlsFingerprints&);
+TlsHello tls_server_fingerprint(const uint8_t* data, size_t len, TlsFingerprints&);
+
+// totals for the module pegs
+struct TlsPegs
+{
+    std::atomic<uint64_t> client_hellos { 0 };
+    std::atomic<uint64_t> server_hellos { 0 };
+};
+
+extern TlsPegs tls_pegs;
+
+#endif
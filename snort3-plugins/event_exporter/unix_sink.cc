@@ -0,0 +1,221 @@
+//--------------------------------------------------------------------------
+// unix_sink.cc - Unix domain datagram sink batched with sendmmsg
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "unix_sink.h"
+
+#include "log/messages.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include "ai_event_exporter.h"
+#include "event_topics.h"
+
+using namespace snort;
+using namespace std;
+
+static const unsigned BATCH_MESSAGES = 256;
+static const size_t BATCH_BYTES = 1024 * 1024;
+
+// how often to retry while the consumer is not there
+static const chrono::seconds RECONNECT_INTERVAL(1);
+
+UnixSink::UnixSink(const string& ep, const string& p, const AIEventExporterConfig& config)
+    : EventSink(ep), path(p),
+      type(config.unix_socket_type == UNIX_DGRAM ? SOCK_DGRAM : SOCK_SEQPACKET)
+{
+}
+
+UnixSink::~UnixSink()
+{
+    disconnect();
+}
+
+void UnixSink::open()
+{
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        throw runtime_error("invalid unix socket path '" + path + "'");
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+
+    events.resize(BATCH_MESSAGES);
+    iov.resize(BATCH_MESSAGES);
+    msgs.resize(BATCH_MESSAGES);
+
+    LogMessage("AI Event Exporter: connecting to %s\n", endpoint.c_str());
+
+    // like a zeromq connect, a missing consumer is not an error
+    if (!reconnect())
+        WarningMessage("AI Event Exporter: %s not accepting yet, will retry\n", path.c_str());
+}
+
+bool UnixSink::reconnect()
+{
+    if (fd >= 0)
+        return true;
+
+    auto now = chrono::steady_clock::now();
+
+    if (now < next_connect)
+        return false;
+
+    next_connect = now + RECONNECT_INTERVAL;
+    fd = socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0)
+        return false;
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)))
+    {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+void UnixSink::disconnect()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+static bool is_heartbeat(const EventRef& event)
+{ return (event.get_topic() & 0xff) == HEARTBEAT_TYPE; }
+
+// lets go of the batched events before end, sent or never to be
+void UnixSink::release(unsigned end)
+{
+    for (; first < end; ++first)
+    {
+        if (!is_heartbeat(events[first]))
+            --unsent_events;
+
+        events[first] = EventRef();
+    }
+}
+
+bool UnixSink::send_batch()
+{
+    while (first < count)
+    {
+        if (!reconnect())
+            return false;
+
+        int n = sendmmsg(fd, &msgs[first], count - first, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if (n > 0)
+        {
+            release(first + n);
+            continue;
+        }
+
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+            return false;
+
+        if (errno == EMSGSIZE)
+        {
+            // larger than the socket allows; it will never go out
+            if (!send_errors++)
+                ErrorMessage("AI Event Exporter: %zu byte event too large for %s\n",
+                    msgs[first].msg_hdr.msg_iov->iov_len, path.c_str());
+            release(first + 1);
+            continue;
+        }
+
+        // consumer went away; keep the batch for the next connection
+        disconnect();
+        return false;
+    }
+
+    first = count = 0;
+    used = 0;
+    return true;
+}
+
+bool UnixSink::write(const EventRef& event)
+{
+    if (count == BATCH_MESSAGES || used + event.size() > BATCH_BYTES)
+    {
+        send_batch();
+
+        if (count == BATCH_MESSAGES || used + event.size() > BATCH_BYTES)
+        {
+            if (count)
+                return false;
+
+            if (!send_errors++)
+                ErrorMessage("AI Event Exporter: %zu byte event too large for %s\n",
+                    event.size(), path.c_str());
+            return true;
+        }
+    }
+
+    events[count] = event;
+
+    if (!is_heartbeat(event))
+        ++unsent_events;
+
+    iov[count].iov_base = const_cast<char*>(event.data());
+    iov[count].iov_len = event.size();
+
+    struct mmsghdr& m = msgs[count];
+    memset(&m, 0, sizeof(m));
+    m.msg_hdr.msg_iov = &iov[count];
+    m.msg_hdr.msg_iovlen = 1;
+
+    used += event.size();
+    ++count;
+    return true;
+}
+
+void UnixSink::flush()
+{
+    send_batch();
+}
+
+void UnixSink::close(chrono::steady_clock::time_point deadline)
+{
+    while (!send_batch() && fd >= 0)
+    {
+        auto left = chrono::duration_cast<chrono::milliseconds>(
+            deadline - chrono::steady_clock::now()).count();
+
+        if (left <= 0)
+            break;
+
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        poll(&pfd, 1, (int)left);
+    }
+
+    disconnect();
+}
+
+void UnixSink::take_unconfirmed(vector<EventRef>& left)
+{
+    for (unsigned i = first; i < count; ++i)
+    {
+        if (!is_heartbeat(events[i]))
+            left.emplace_back(std::move(events[i]));
+
+        events[i] = EventRef();
+    }
+
+    first = count = 0;
+    used = 0;
+    unsent_events = 0;
+}
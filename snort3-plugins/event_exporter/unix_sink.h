@@ -0,0 +1,82 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// unix_sink.h - Unix domain datagram sink batched with sendmmsg
+
+#ifndef UNIX_SINK_H
+#define UNIX_SINK_H
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "event_sink.h"
+
+//-------------------------------------------------------------------------
+// One event per datagram.  The consumer binds (dgram) or listens
+// (seqpacket) on the path; the sink connects and reconnects as the
+// consumer comes and goes.  Events are held by reference in a batch that
+// goes out with a single sendmmsg() when it fills or the segment ends;
+// what is still in it when close() gives up goes back to be spooled.
+//-------------------------------------------------------------------------
+
+class UnixSink : public EventSink
+{
+public:
+    UnixSink(const std::string& endpoint, const std::string& path, const AIEventExporterConfig&);
+    ~UnixSink() override;
+
+    void open() override;
+    bool write(const EventRef& event) override;
+    void flush() override;
+    void close(std::chrono::steady_clock::time_point deadline) override;
+    void take_unconfirmed(std::vector<EventRef>&) override;
+
+    size_t unsent() const override
+    { return unsent_events; }
+
+    // while disconnected, retrying is paced by RECONNECT_INTERVAL instead
+    bool backlogged() const override
+    { return fd >= 0 && first < count; }
+
+private:
+    bool reconnect();
+    void disconnect();
+    bool send_batch();
+    void release(unsigned end);
+
+private:
+    const std::string path;
+    const int type;
+
+    int fd = -1;
+    struct sockaddr_un addr;
+    std::chrono::steady_clock::time_point next_connect;
+
+    std::vector<EventRef> events;
+    std::vector<struct iovec> iov;
+    std::vector<struct mmsghdr> msgs;
+    size_t used = 0;
+    unsigned first = 0;
+    unsigned count = 0;
+
+    // batched events other than heartbeats, which are not worth spooling
+    size_t unsent_events = 0;
+
+    uint64_t send_errors = 0;
+};
+
+#endif
@@ -0,0 +1,335 @@
+//--------------------------------------------------------------------------
+// zmq_sink.cc - ZeroMQ PUSH or PUB sink
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "zmq_sink.h"
+
+#include "log/messages.h"
+
+#include <random>
+
+#include "ai_event_exporter.h"
+#include "event_topics.h"
+
+using namespace snort;
+using namespace std;
+
+// how long closing a batch mode socket waits for queued messages
+static const int BATCH_LINGER_MS = 1000;
+
+// how often a sink without credit announces itself again, in case the
+// consumer restarted and forgot it
+static const chrono::seconds HELLO_INTERVAL(1);
+
+// how long sent alerts wait for an ack before they are all sent again
+static const chrono::seconds ACK_TIMEOUT(1);
+
+ZmqSink::ZmqSink(const string& ep, const AIEventExporterConfig& c, zmq::context_t& ctx,
+    TopicSubscriptions* t, unsigned s)
+    : EventSink(ep), config(c), context(ctx), topics(t), sink(s),
+      credit_mode(!t && c.flow_control == FLOW_CONTROL_CREDIT),
+      acked(!t && c.alert_ack_window > 0),
+      sequenced(c.sequence_events || acked)
+{
+}
+
+ZmqSink::~ZmqSink()
+{
+    if (socket)
+    {
+        socket->close();
+        delete socket;
+    }
+}
+
+void ZmqSink::open()
+{
+    int type = topics ? ZMQ_XPUB : (credit_mode || acked) ? ZMQ_DEALER : ZMQ_PUSH;
+
+    socket = new zmq::socket_t(context, type);
+    socket->set(zmq::sockopt::sndhwm, (int)config.buffer_size);
+
+    if (config.latency_mode == LATENCY_BUSY_POLL)
+    {
+        // never queue behind a peer that is not connected yet, and do not
+        // hold shutdown for messages the peer has not taken
+        socket->set(zmq::sockopt::immediate, 1);
+        socket->set(zmq::sockopt::linger, 0);
+    }
+    else
+        socket->set(zmq::sockopt::linger, BATCH_LINGER_MS);
+
+    // consumers tell a restarted exporter's sequences from the old ones
+    if (sequenced)
+    {
+        random_device rd;
+        stream = rd();
+    }
+
+    if (topics)
+    {
+        // subscribers come to the publisher
+        LogMessage("AI Event Exporter: publishing on %s\n", endpoint.c_str());
+        socket->bind(endpoint);
+        return;
+    }
+
+    LogMessage("AI Event Exporter: connecting to %s\n", endpoint.c_str());
+    socket->connect(endpoint);
+}
+
+void ZmqSink::read_control()
+{
+    zmq::message_t msg;
+
+    while (socket->recv(msg, zmq::recv_flags::dontwait))
+    {
+        if (topics)
+        {
+            // XPUB reports the first subscriber to a prefix and the last
+            // one to leave, as 1 or 0 followed by the prefix
+            if (!msg.size())
+                continue;
+
+            const char* data = msg.data<char>();
+            string prefix(data + 1, msg.size() - 1);
+            bool on = data[0] == 1;
+
+            if (on ? subscribed.insert(prefix).second : subscribed.erase(prefix) > 0)
+                topics->update(sink, prefix, on);
+        }
+        else if (msg.size() == 4)
+        {
+            const uint8_t* p = msg.data<uint8_t>();
+            credit += (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+        }
+        else if (msg.size() == 8 && acked)
+        {
+            const uint8_t* p = msg.data<uint8_t>();
+            uint64_t seq = 0;
+
+            for (unsigned i = 0; i < 8; ++i)
+                seq = seq << 8 | p[i];
+
+            ack(seq);
+        }
+    }
+}
+
+bool ZmqSink::has_credit()
+{
+    if (!credit_mode || credit)
+        return true;
+
+    read_control();
+
+    if (credit)
+        return true;
+
+    auto now = chrono::steady_clock::now();
+
+    if (now >= next_hello)
+    {
+        socket->send(zmq::message_t(), zmq::send_flags::dontwait);
+        next_hello = now + HELLO_INTERVAL;
+    }
+    return false;
+}
+
+static void release_event(void*, void* hint)
+{
+    ((EventBuffer*)hint)->unref();
+}
+
+static void put_be(uint8_t* p, uint64_t v, unsigned n)
+{
+    for (unsigned i = n; i > 0; --i, v >>= 8)
+        p[i - 1] = (uint8_t)v;
+}
+
+bool ZmqSink::send(const EventRef& event, bool header, uint32_t lane, uint64_t seq)
+{
+    if (!has_credit())
+        return false;
+
+    // the later frames of a multipart message are always accepted once the
+    // first is; a PUB socket drops rather than block on a slow subscriber
+    auto more = zmq::send_flags::sndmore | zmq::send_flags::dontwait;
+    bool first = true;
+
+    if (topics)
+    {
+        uint8_t topic[TOPIC_SIZE];
+        topic_bytes(event.get_topic(), topic);
+
+        if (!socket->send(zmq::buffer(topic, sizeof(topic)), more))
+            return false;
+
+        first = false;
+    }
+
+    if (header)
+    {
+        uint8_t h[HEADER_SIZE];
+        put_be(h, stream, 4);
+        put_be(h + 4, lane, 4);
+        put_be(h + 8, seq, 8);
+
+        if (!socket->send(zmq::buffer(h, sizeof(h)), more) && first)
+            return false;
+    }
+
+    // zero copy; the message holds a reference until zeromq is done with it
+    EventRef held = event;
+    zmq::message_t message((void*)event.data(), event.size(), release_event, held.release());
+
+    // false keeps the event queued until the peer catches up
+    if (!socket->send(message, zmq::send_flags::dontwait))
+        return false;
+
+    if (credit_mode)
+        --credit;
+
+    return true;
+}
+
+bool ZmqSink::write(const EventRef& event)
+{
+    uint8_t type = event.get_topic() & 0xff;
+
+    if (!sequenced || type == HEARTBEAT_TYPE)
+        return send(event, false);
+
+    if (acked && type == EVENT_ALERT)
+    {
+        // taken once spooled; the window decides when it goes out
+        if (spool.size() >= config.buffer_size)
+            return false;
+
+        spool.push_back({ ++sequences[LANE_ALERT], event, false });
+        send_spool();
+        return true;
+    }
+
+    uint32_t lane = topics ? event.get_topic() : type == EVENT_ALERT ? LANE_ALERT : LANE_FLOW;
+    uint64_t& last = sequences[lane];
+
+    // a refused event is offered again and keeps its place in the lane
+    if (!send(event, true, lane, last + 1))
+        return false;
+
+    ++last;
+    return true;
+}
+
+void ZmqSink::send_spool()
+{
+    auto now = chrono::steady_clock::now();
+
+    // go back: whatever is in flight was lost with a connection or an ack
+    if (inflight && now >= ack_deadline)
+        inflight = 0;
+
+    size_t sent = 0, resent = 0;
+
+    while (inflight < spool.size() && inflight < config.alert_ack_window)
+    {
+        Spooled& s = spool[inflight];
+
+        if (!send(s.event, true, LANE_ALERT | ACK_REQUESTED, s.seq))
+            break;
+
+        if (s.sent)
+            ++resent;
+
+        s.sent = true;
+        ++inflight;
+        ++sent;
+    }
+
+    if (sent)
+        ack_deadline = now + ACK_TIMEOUT;
+
+    if (resent)
+        sink_pegs.alerts_retransmitted.fetch_add(resent, memory_order_relaxed);
+}
+
+void ZmqSink::ack(uint64_t seq)
+{
+    size_t n = 0;
+
+    // acks are cumulative; one may still arrive for alerts about to be resent
+    while (n < spool.size() && spool[n].sent && spool[n].seq <= seq)
+        ++n;
+
+    if (!n)
+        return;
+
+    spool.erase(spool.begin(), spool.begin() + n);
+    inflight -= min(n, inflight);
+
+    // the consumer is making progress; give the rest a full timeout
+    ack_deadline = chrono::steady_clock::now() + ACK_TIMEOUT;
+    sink_pegs.alerts_acked.fetch_add(n, memory_order_relaxed);
+
+    send_spool();
+}
+
+void ZmqSink::flush()
+{
+    if (topics || credit_mode || acked)
+        read_control();
+
+    if (!spool.empty())
+        send_spool();
+}
+
+void ZmqSink::close(chrono::steady_clock::time_point deadline)
+{
+    // one last chance for acks, then the context waits out what is left of
+    // the drain for queued messages instead of the full batch linger
+    if (acked)
+        read_control();
+
+    auto left = chrono::duration_cast<chrono::milliseconds>(
+        deadline - chrono::steady_clock::now()).count();
+
+    socket->set(zmq::sockopt::linger, (int)max(left, (decltype(left))0));
+
+    if (!topics)
+        return;
+
+    // this socket's subscribers no longer count
+    for (auto& prefix : subscribed)
+        topics->update(sink, prefix, false);
+
+    subscribed.clear();
+}
+
+void ZmqSink::get_lane_marks(vector<LaneMark>& marks) const
+{
+    for (auto& s : sequences)
+    {
+        // spooled alerts have their numbers before they go out
+        if (acked && s.first == LANE_ALERT)
+        {
+            uint64_t seq = spool.empty() ? s.second : spool.front().seq - 1 + inflight;
+            marks.push_back({ stream, LANE_ALERT | ACK_REQUESTED, seq });
+        }
+        else
+            marks.push_back({ stream, s.first, s.second });
+    }
+}
+
+void ZmqSink::take_unconfirmed(vector<EventRef>& left)
+{
+    for (auto& s : spool)
+        left.emplace_back(std::move(s.event));
+
+    spool.clear();
+    inflight = 0;
+}
@@ -0,0 +1,125 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2025 Snort3-AI-Ops Contributors
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//--------------------------------------------------------------------------
+// zmq_sink.h - ZeroMQ PUSH or PUB sink
+
+#ifndef ZMQ_SINK_H
+#define ZMQ_SINK_H
+
+#include <zmq.hpp>
+
+#include <chrono>
+#include <deque>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "event_sink.h"
+
+class TopicSubscriptions;
+
+//-------------------------------------------------------------------------
+// A PUSH sink connects to one consumer.  A PUB sink binds an XPUB socket
+// and sends each event after its topic frame; the subscribe and unsubscribe
+// messages the socket receives are passed on to the sender's subscription
+// table, so packet threads stop encoding classes nobody is subscribed to.
+//
+// With credit flow control a push sink is a DEALER talking to the
+// consumer's ROUTER.  It announces itself with an empty message, and the
+// consumer grants credit as 4 byte big endian event counts.  The sink
+// sends only within its credit and otherwise refuses the event, so the
+// cursor holds it (block) or sheds it (drop) and counts either, instead
+// of zeromq queueing without bound or dropping unseen.
+//
+// With sequence_events each event follows a 16 byte header frame: a random
+// stream id chosen when the socket opens, the lane and the event's 64 bit
+// sequence number in that lane, all big endian.  A push socket has an alert
+// lane and a flow lane; on a PUB socket every topic is a lane of its own,
+// so a subscriber sees a contiguous sequence for each topic it takes.
+//
+// With an alert_ack_window the alert lane is reliable.  The sink is a
+// DEALER, alerts carry the ACK_REQUESTED lane bit, and each is kept in the
+// spool until the consumer returns a cumulative 8 byte ack.  At most the
+// window is in flight; when no ack comes for ACK_TIMEOUT (or the consumer
+// reconnected and lost them) everything unacked is sent again in order.
+// The spool is bounded by buffer_size, after which alerts are refused and
+// the cursor applies backpressure.  Flows never wait for acks.
+//
+// Heartbeats are sent without a header, in no lane, and report the last
+// sequence number sent in each lane so a consumer sees loss at once.
+//-------------------------------------------------------------------------
+
+class ZmqSink : public EventSink
+{
+public:
+    ZmqSink(const std::string& endpoint, const AIEventExporterConfig&, zmq::context_t&,
+        TopicSubscriptions* = nullptr, unsigned sink = 0);
+    ~ZmqSink() override;
+
+    void open() override;
+    bool write(const EventRef& event) override;
+
+    // a PUB sink reads subscription changes here, others credit and acks
+    void flush() override;
+    void close(std::chrono::steady_clock::time_point deadline) override;
+    void take_unconfirmed(std::vector<EventRef>&) override;
+    void get_lane_marks(std::vector<LaneMark>&) const override;
+
+    // unacked alerts are waiting
+    bool backlogged() const override
+    { return !spool.empty(); }
+
+    static constexpr size_t HEADER_SIZE = 16;
+    static constexpr uint32_t LANE_ALERT = 0;
+    static constexpr uint32_t LANE_FLOW = 1;
+    static constexpr uint32_t ACK_REQUESTED = 0x80000000;
+
+private:
+    const AIEventExporterConfig& config;
+    zmq::context_t& context;
+    zmq::socket_t* socket = nullptr;
+
+    struct Spooled
+    {
+        uint64_t seq;
+        EventRef event;
+        bool sent;
+    };
+
+    void read_control();
+    bool has_credit();
+    bool send(const EventRef&, bool header, uint32_t lane = 0, uint64_t seq = 0);
+
+    void send_spool();
+    void ack(uint64_t seq);
+
+    TopicSubscriptions* topics;
+    const unsigned sink;
+    std::set<std::string> subscribed;
+
+    const bool credit_mode;
+    uint64_t credit = 0;
+    std::chrono::steady_clock::time_point next_hello;
+
+    const bool acked;
+    const bool sequenced;
+    uint32_t stream = 0;
+    std::unordered_map<uint32_t, uint64_t> sequences;
+
+    // unacked alerts; the first inflight of them have been sent
+    std::deque<Spooled> spool;
+    size_t inflight = 0;
+    std::chrono::steady_clock::time_point ack_deadline;
+};
+
+#endif
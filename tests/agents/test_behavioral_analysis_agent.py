@@ -0,0 +1,116 @@
+"""
+Test suite for Behavioral Analysis Agent host profiles
+"""
+
+import pytest
+from agents.behavioral_analysis_agent import BehavioralAnalysisAgent
+from core.config import BehavioralConfig
+
+
+def host_profile(host, flows=120, peers=14):
+    """A host profile as the exporter writes it."""
+    return {
+        'host': host,
+        'first_seen': 1765440000000,
+        'last_seen': 1765447200000,
+        'flows': flows,
+        'hours': 3,
+        'active_hours': 1792,
+        'bytes_out': {'typical': 5200, 'spread': 1.8},
+        'bytes_in': {'typical': 48000, 'spread': 2.4},
+        'peers': peers,
+        'peers_per_hour': {'mean': 6.5, 'sd': 1.2, 'current': 7},
+        'new_ports_per_hour': {'mean': 0.4, 'sd': 0.5, 'current': 0}
+    }
+
+
+@pytest.fixture
+def agent():
+    """Create agent instance."""
+    return BehavioralAnalysisAgent(config=BehavioralConfig(enabled=True))
+
+
+class TestHostProfiles:
+    """Test cases for profile records from the exporter."""
+
+    @pytest.mark.asyncio
+    async def test_snapshot_replaces_profiles(self, agent):
+        """Test snapshot parts store every profile they carry."""
+        first = {
+            'type': 'profile',
+            'kind': 'snapshot',
+            'timestamp': 1765447200000,
+            'part': 0,
+            'parts': 2,
+            'profiles': [host_profile('10.0.0.5'), host_profile('10.0.0.6')]
+        }
+        second = dict(first, part=1, profiles=[host_profile('10.0.0.7')])
+
+        assert await agent.process_profile(first) == []
+        assert await agent.process_profile(second) == []
+
+        assert set(agent.host_profiles) == {'10.0.0.5', '10.0.0.6', '10.0.0.7'}
+        assert agent.host_profiles['10.0.0.6']['bytes_in']['typical'] == 48000
+
+        # A later snapshot brings each host up to date
+        update = dict(first, parts=1, profiles=[host_profile('10.0.0.5', flows=300)])
+        await agent.process_profile(update)
+
+        assert agent.host_profiles['10.0.0.5']['flows'] == 300
+        assert len(agent.host_profiles) == 3
+
+    @pytest.mark.asyncio
+    async def test_empty_snapshot(self, agent):
+        """Test a snapshot of no hosts, sent as one empty part."""
+        event = {'type': 'profile', 'kind': 'snapshot', 'part': 0, 'parts': 1,
+                 'profiles': []}
+
+        assert await agent.process_profile(event) == []
+        assert agent.host_profiles == {}
+
+    @pytest.mark.asyncio
+    async def test_deviation_returns_deviations(self, agent):
+        """Test a deviation reports its metrics and updates the host."""
+        deviations = [
+            {'metric': 'peers', 'value': 41, 'expected': 6.5, 'zscore': 28.75},
+            {'metric': 'active_hour', 'value': 3}
+        ]
+        event = {
+            'type': 'profile',
+            'kind': 'deviation',
+            'timestamp': 1765447260000,
+            'flow_id': 9817,
+            'deviations': deviations,
+            'profile': host_profile('10.0.0.5', peers=41)
+        }
+
+        result = await agent.process_profile(event)
+
+        assert result == deviations
+        assert [d['metric'] for d in result] == ['peers', 'active_hour']
+        # A new active hour has no baseline, so nothing to score against
+        assert 'zscore' not in result[1]
+        assert agent.host_profiles['10.0.0.5']['peers'] == 41
+
+    @pytest.mark.asyncio
+    async def test_deviation_updates_snapshot_profile(self, agent):
+        """Test a deviation's profile replaces the one from the snapshot."""
+        await agent.process_profile({
+            'type': 'profile', 'kind': 'snapshot', 'part': 0, 'parts': 1,
+            'profiles': [host_profile('10.0.0.5', flows=100)]
+        })
+
+        await agent.process_profile({
+            'type': 'profile',
+            'kind': 'deviation',
+            'flow_id': 1,
+            'deviations': [{'metric': 'bytes_out', 'value': 9000000,
+                            'expected': 5200, 'zscore': 12.4}],
+            'profile': host_profile('10.0.0.5', flows=101)
+        })
+
+        assert agent.host_profiles['10.0.0.5']['flows'] == 101
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
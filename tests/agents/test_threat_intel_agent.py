@@ -99,6 +99,77 @@ class TestThreatIntelligenceAgent:
             # Clean IP should not be malicious
             assert result['threat_score'] == 0
     
+    @pytest.mark.asyncio
+    async def test_enrich_event_with_tls_fingerprints(self, agent):
+        """Test lookup of the JA3/JA4 fingerprints of a flow's TLS hellos."""
+        event = {
+            'type': 'flow_end',
+            'src_ip': '192.168.1.100',
+            'dst_ip': '8.8.8.8',
+            'tls': {
+                'ja3': 'e7d705a3286e19ea42f587b344ee6865',
+                'ja4': 't13d1516h2_8daaf6152771_e5627efa2ab1',
+                'ja3s': 'f4febc55ea12b31ae17cfb7e614afda8',
+                'ja4s': 't130200_1301_a56c5b993250'
+            }
+        }
+
+        async def lookup(ioc, ioc_type):
+            malicious = ioc_type == 'ja3' and ioc == event['tls']['ja3']
+            return {
+                'value': ioc,
+                'type': ioc_type,
+                'threat_score': 90 if malicious else 0,
+                'malicious': malicious,
+                'sources': {},
+                'tags': ['malware_c2'] if malicious else [],
+                'first_seen': None,
+                'last_seen': None
+            }
+
+        with patch.object(agent, '_lookup_ioc', new_callable=AsyncMock) as mock_lookup:
+            mock_lookup.side_effect = lookup
+
+            result = await agent.enrich_event(event)
+
+            # Every fingerprint is looked up by its own type
+            looked_up = [call.args for call in mock_lookup.call_args_list]
+            assert ('e7d705a3286e19ea42f587b344ee6865', 'ja3') in looked_up
+            assert ('t13d1516h2_8daaf6152771_e5627efa2ab1', 'ja4') in looked_up
+            assert ('f4febc55ea12b31ae17cfb7e614afda8', 'ja3s') in looked_up
+            assert ('t130200_1301_a56c5b993250', 'ja4s') in looked_up
+
+            assert len(result['iocs']) == 6
+            assert result['threat_score'] == 90
+            assert 'BLOCK_IMMEDIATELY' in result['recommendations']
+
+            # Fingerprints are cached like any other IOC
+            assert 'ja4:t13d1516h2_8daaf6152771_e5627efa2ab1' in agent.cache
+
+    @pytest.mark.asyncio
+    async def test_enrich_event_with_partial_tls(self, agent):
+        """Test only the hellos that were seen are looked up."""
+        client_only = {
+            'type': 'flow_end',
+            'src_ip': '192.168.1.100',
+            'tls': {'ja3': 'e7d705a3286e19ea42f587b344ee6865',
+                    'ja4': 't13d1516h2_8daaf6152771_e5627efa2ab1'}
+        }
+        no_tls = {'type': 'flow_end', 'src_ip': '192.168.1.100'}
+
+        with patch.object(agent, '_lookup_ioc', new_callable=AsyncMock) as mock_lookup:
+            mock_lookup.return_value = {'value': 'x', 'type': 'x', 'threat_score': 10}
+
+            result = await agent.enrich_event(client_only)
+            types = [call.args[1] for call in mock_lookup.call_args_list]
+            assert types == ['ip', 'ja3', 'ja4']
+            assert len(result['iocs']) == 3
+
+            # The IP is cached now, and there is nothing else to look up
+            result = await agent.enrich_event(no_tls)
+            assert mock_lookup.call_count == 3
+            assert len(result['iocs']) == 1
+
     @pytest.mark.asyncio
     async def test_caching(self, agent):
         """Test that results are cached."""
@@ -0,0 +1,322 @@
+"""
+Test suite for the Snort3 event stream's sequence, ack, heartbeat and
+credit handling
+"""
+
+import asyncio
+import struct
+
+import pytest
+import zmq
+import zmq.asyncio
+from unittest.mock import AsyncMock, Mock
+
+from connectors.snort3_event_stream import ACK_REQUESTED, Snort3EventStream
+
+
+PEER = b'sender-0'
+STREAM = 7
+LANE = 1
+
+
+def header(seq, lane=LANE, stream=STREAM):
+    """A sequence header as the exporter sends it."""
+    return struct.pack('!IIQ', stream, lane, seq)
+
+
+def acked(seq, lane=LANE):
+    return header(seq, lane | ACK_REQUESTED)
+
+
+@pytest.fixture
+def stream():
+    """A connector whose socket only records what is sent on it."""
+    connector = Snort3EventStream(
+        endpoint='tcp://127.0.0.1:5555',
+        flow_control='credit',
+        credit_window=10,
+        alert_acks=True
+    )
+    connector.socket = Mock()
+    connector.socket.send_multipart = AsyncMock()
+    return connector
+
+
+def sent(connector):
+    """The frames sent on the connector's socket, in order."""
+    return [c.args[0] for c in connector.socket.send_multipart.call_args_list]
+
+
+class TestSequenceGaps:
+    """Gaps and duplicates on best effort lanes."""
+
+    def test_in_order_events_are_taken(self, stream):
+        """Consecutive sequence numbers count nothing missed."""
+        for seq in range(5):
+            assert stream._check_sequence(PEER, header(seq)) == (True, None)
+
+        assert stream.stats['events_missed'] == 0
+        assert stream.stats['duplicates'] == 0
+
+    def test_gap_counts_missed_events(self, stream):
+        """A jump ahead counts the numbers skipped."""
+        stream._check_sequence(PEER, header(0))
+        stream._check_sequence(PEER, header(1))
+
+        assert stream._check_sequence(PEER, header(5)) == (True, None)
+        assert stream.stats['events_missed'] == 3
+
+    def test_first_event_is_not_a_gap(self, stream):
+        """Joining a lane mid-stream loses nothing we could have had."""
+        stream._check_sequence(PEER, header(1000))
+        assert stream.stats['events_missed'] == 0
+
+    def test_duplicate_is_dropped_without_false_gaps(self, stream):
+        """An event seen again neither moves the lane back nor counts a gap."""
+        for seq in range(3):
+            stream._check_sequence(PEER, header(seq))
+
+        assert stream._check_sequence(PEER, header(1)) == (False, None)
+        assert stream._check_sequence(PEER, header(3)) == (True, None)
+
+        assert stream.stats['duplicates'] == 1
+        assert stream.stats['events_missed'] == 0
+
+    def test_lanes_streams_and_peers_are_separate(self, stream):
+        """Every (peer, stream, lane) keeps its own sequence."""
+        stream._check_sequence(PEER, header(0, lane=1))
+        stream._check_sequence(PEER, header(0, lane=2))
+        stream._check_sequence(PEER, header(0, stream=8))
+        stream._check_sequence(b'sender-1', header(0))
+        stream._check_sequence(PEER, header(1, lane=2))
+
+        assert stream.stats['events_missed'] == 0
+        assert len(stream.sequences) == 4
+
+    def test_event_without_header_is_taken(self, stream):
+        """Events from an exporter without sequence_events pass through."""
+        assert stream._check_sequence(PEER, b'') == (True, None)
+        assert stream.sequences == {}
+
+
+class TestAckedLanes:
+    """Acked lanes are taken strictly in order."""
+
+    def test_in_order_event_is_acked(self, stream):
+        assert stream._check_sequence(PEER, acked(0)) == (True, (PEER, 0))
+        assert stream._check_sequence(PEER, acked(1)) == (True, (PEER, 1))
+
+    def test_duplicate_reacks_last_taken(self, stream):
+        """A resent alert we already have is dropped and the last ack repeated."""
+        stream._check_sequence(PEER, acked(0))
+        stream._check_sequence(PEER, acked(1))
+
+        assert stream._check_sequence(PEER, acked(0)) == (False, (PEER, 1))
+        assert stream.stats['duplicates'] == 1
+
+    def test_gap_is_refused_until_resent(self, stream):
+        """An alert past a loss is refused; the exporter resends from the ack."""
+        stream._check_sequence(PEER, acked(0))
+
+        assert stream._check_sequence(PEER, acked(2)) == (False, (PEER, 0))
+        assert stream.stats['events_missed'] == 0
+        assert stream.stats['duplicates'] == 0
+
+        assert stream._check_sequence(PEER, acked(1)) == (True, (PEER, 1))
+        assert stream._check_sequence(PEER, acked(2)) == (True, (PEER, 2))
+
+    def test_acked_and_best_effort_lane_share_number(self, stream):
+        """The ack bit is not part of the lane key."""
+        stream._check_sequence(PEER, acked(0))
+        assert (PEER, STREAM, LANE) in stream.sequences
+
+    @pytest.mark.asyncio
+    async def test_ack_reply_frames(self, stream):
+        """An ack goes to the sender's identity with the sequence number."""
+        await stream._ack((PEER, 41))
+        await stream._ack(None)
+
+        assert sent(stream) == [[PEER, struct.pack('!Q', 41)]]
+
+
+class TestHeartbeats:
+    """Heartbeat lane marks reveal loss at the tail of a lane."""
+
+    @pytest.mark.asyncio
+    async def test_heartbeat_counts_lost_tail(self, stream):
+        """A mark past what was received lost the difference."""
+        stream._check_sequence(PEER, header(0))
+        stream._check_sequence(PEER, header(1))
+
+        stream._heartbeat(PEER, {'type': 'heartbeat', 'sender': 0,
+                                 'sequences': [[STREAM, LANE, 4]]})
+
+        assert stream.stats['events_missed'] == 3
+        assert stream.stats['heartbeats'] == 1
+
+        # the events the heartbeat gave up on do not count again
+        stream._check_sequence(PEER, header(5))
+        assert stream.stats['events_missed'] == 3
+
+    @pytest.mark.asyncio
+    async def test_heartbeat_matching_last_event(self, stream):
+        """Nothing is missed when the mark is the last event received."""
+        stream._check_sequence(PEER, header(0))
+        stream._heartbeat(PEER, {'sequences': [[STREAM, LANE, 0]]})
+
+        assert stream.stats['events_missed'] == 0
+
+    @pytest.mark.asyncio
+    async def test_heartbeat_skips_acked_and_unseen_lanes(self, stream):
+        """Acked lanes are resent and unsubscribed lanes were never ours."""
+        stream._check_sequence(PEER, acked(0))
+
+        stream._heartbeat(PEER, {'sequences': [
+            [STREAM, LANE | ACK_REQUESTED, 9],
+            [STREAM, 3, 9],
+        ]})
+
+        assert stream.stats['events_missed'] == 0
+        assert (PEER, STREAM, 3) not in stream.sequences
+
+    @pytest.mark.asyncio
+    async def test_heartbeat_is_kept_per_sender(self, stream):
+        stream._heartbeat(PEER, {'sender': 0, 'uptime': 1})
+        stream._heartbeat(PEER, {'sender': 1, 'uptime': 2})
+        stream._heartbeat(PEER, {'sender': 0, 'uptime': 3})
+
+        liveness = stream.get_liveness()
+        assert liveness[(PEER, 0)]['uptime'] == 3
+        assert liveness[(PEER, 1)]['uptime'] == 2
+
+    @pytest.mark.asyncio
+    async def test_silence_past_three_intervals_is_a_stall(self, stream):
+        now = asyncio.get_running_loop().time()
+        stream.heartbeat_interval = 1.0
+
+        stream.last_message = now - 2.0
+        stream._check_stall()
+        assert not stream.stalled
+
+        stream.last_message = now - 4.0
+        stream._check_stall()
+        stream._check_stall()
+        assert stream.stalled
+        assert stream.stats['stalls'] == 1
+
+        stream._alive()
+        assert not stream.stalled
+
+
+class TestCredit:
+    """Credit grants to exporters running with flow_control = 'credit'."""
+
+    @pytest.mark.asyncio
+    async def test_hello_grants_full_window(self, stream):
+        await stream._hello(PEER)
+        assert sent(stream) == [[PEER, struct.pack('!I', 10)]]
+
+    @pytest.mark.asyncio
+    async def test_credit_replenished_at_half_window(self, stream):
+        """What was consumed is granted back once half the window is used."""
+        await stream._hello(PEER)
+
+        for _ in range(4):
+            await stream._account_credit(PEER)
+        assert len(sent(stream)) == 1
+
+        await stream._account_credit(PEER)
+        assert sent(stream)[-1] == [PEER, struct.pack('!I', 5)]
+        assert stream.consumed[PEER] == 0
+
+    @pytest.mark.asyncio
+    async def test_hello_resets_consumed(self, stream):
+        """A sink out of credit gets a full window, not the remainder."""
+        await stream._account_credit(PEER)
+        await stream._account_credit(PEER)
+        await stream._hello(PEER)
+
+        assert stream.consumed[PEER] == 0
+        assert sent(stream)[-1] == [PEER, struct.pack('!I', 10)]
+
+    @pytest.mark.asyncio
+    async def test_credit_is_per_peer(self, stream):
+        for _ in range(5):
+            await stream._account_credit(PEER)
+        await stream._account_credit(b'sender-1')
+
+        assert sent(stream) == [[PEER, struct.pack('!I', 5)]]
+        assert stream.consumed[b'sender-1'] == 1
+
+    @pytest.mark.asyncio
+    async def test_no_grants_without_credit_mode(self, stream):
+        stream.flow_control = 'none'
+        await stream._hello(PEER)
+
+        assert sent(stream) == []
+
+
+class TestRouterStream:
+    """End to end over a real socket, the exporter played by a DEALER."""
+
+    @pytest.mark.asyncio
+    async def test_acked_alerts_credit_and_heartbeat(self, tmp_path):
+        endpoint = f'ipc://{tmp_path}/events'
+        connector = Snort3EventStream(
+            endpoint=endpoint,
+            timeout=200,
+            flow_control='credit',
+            credit_window=4,
+            alert_acks=True
+        )
+        await connector.connect()
+
+        context = zmq.asyncio.Context()
+        exporter = context.socket(zmq.DEALER)
+        exporter.setsockopt(zmq.LINGER, 0)
+        exporter.connect(endpoint)
+
+        events = connector.stream()
+        try:
+            # the stream answers the hello while waiting for the first event
+            first = asyncio.ensure_future(events.__anext__())
+
+            await exporter.send(b'')
+            assert await asyncio.wait_for(exporter.recv(), 5) == struct.pack('!I', 4)
+
+            await exporter.send_multipart([acked(0), b'{"type": "alert", "sid": 1}'])
+            assert (await asyncio.wait_for(first, 5))['sid'] == 1
+
+            await exporter.send_multipart([acked(0), b'{"type": "alert", "sid": 1}'])
+            await exporter.send_multipart([acked(1), b'{"type": "alert", "sid": 2}'])
+            await exporter.send(b'{"type": "heartbeat", "sender": 0, "sequences": []}')
+            await exporter.send_multipart([acked(2), b'{"type": "alert", "sid": 3}'])
+
+            second = await asyncio.wait_for(events.__anext__(), 5)
+            third = await asyncio.wait_for(events.__anext__(), 5)
+            assert (second['sid'], third['sid']) == (2, 3)
+
+            # an alert is acked once it was handled and the duplicate
+            # re-acks it; every two messages, heartbeats included, are
+            # granted back
+            replies = [await asyncio.wait_for(exporter.recv(), 5) for _ in range(5)]
+            assert replies == [
+                struct.pack('!Q', 0),
+                struct.pack('!I', 2),
+                struct.pack('!Q', 0),
+                struct.pack('!Q', 1),
+                struct.pack('!I', 2),
+            ]
+
+            assert connector.stats['duplicates'] == 1
+            assert connector.stats['heartbeats'] == 1
+            assert connector.stats['events_received'] == 3
+        finally:
+            await events.aclose()
+            exporter.close()
+            context.term()
+            await connector.disconnect()
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
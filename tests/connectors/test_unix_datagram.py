@@ -0,0 +1,199 @@
+"""
+Test suite for the unix:// datagram receiver
+"""
+
+import asyncio
+import socket
+
+import pytest
+
+from connectors.snort3_event_stream import Snort3EventStream
+from connectors.unix_datagram import MMsgReader, UnixDatagramReceiver
+
+
+@pytest.fixture
+def socket_path(tmp_path):
+    return str(tmp_path / 'events.sock')
+
+
+async def drain(receiver, count):
+    """The next count events, failing if they do not all arrive."""
+    return [await receiver.get(5) for _ in range(count)]
+
+
+class TestMMsgReader:
+    """Batched reads of whatever is queued on a socket."""
+
+    def test_reads_queued_datagrams_in_order(self):
+        left, right = socket.socketpair(socket.AF_UNIX, socket.SOCK_DGRAM)
+        try:
+            for i in range(10):
+                left.send(b'event %d' % i)
+
+            messages, closed = MMsgReader(batch=64).read(right)
+
+            assert messages == [b'event %d' % i for i in range(10)]
+            assert not closed
+        finally:
+            left.close()
+            right.close()
+
+    def test_batch_bounds_one_read(self):
+        left, right = socket.socketpair(socket.AF_UNIX, socket.SOCK_DGRAM)
+        try:
+            for i in range(5):
+                left.send(b'%d' % i)
+
+            reader = MMsgReader(batch=3)
+            assert reader.read(right)[0] == [b'0', b'1', b'2']
+            assert reader.read(right)[0] == [b'3', b'4']
+            assert reader.read(right) == ([], False)
+        finally:
+            left.close()
+            right.close()
+
+    def test_seqpacket_close_is_reported(self):
+        left, right = socket.socketpair(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+        try:
+            left.send(b'last')
+            left.close()
+
+            assert MMsgReader().read(right) == ([b'last'], True)
+        finally:
+            right.close()
+
+    def test_fallback_matches_recvmmsg(self):
+        left, right = socket.socketpair(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+        try:
+            left.send(b'a')
+            left.send(b'b')
+            left.close()
+
+            assert MMsgReader()._read_fallback(right) == ([b'a', b'b'], True)
+        finally:
+            right.close()
+
+
+class TestUnixDatagramReceiver:
+    """The consumer end of the exporter's unix:// sink."""
+
+    def test_unknown_socket_type(self, socket_path):
+        with pytest.raises(ValueError):
+            UnixDatagramReceiver(socket_path, socket_type='stream')
+
+    @pytest.mark.asyncio
+    async def test_dgram_events_are_queued(self, socket_path):
+        receiver = UnixDatagramReceiver(socket_path, socket_type='dgram')
+        await receiver.start()
+
+        sender = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+        try:
+            for i in range(3):
+                sender.sendto(b'{"n": %d}' % i, socket_path)
+
+            assert await drain(receiver, 3) == [b'{"n": 0}', b'{"n": 1}', b'{"n": 2}']
+        finally:
+            sender.close()
+            await receiver.stop()
+
+    @pytest.mark.asyncio
+    async def test_seqpacket_accepts_each_sender(self, socket_path):
+        """Every sender thread of the exporter connects on its own."""
+        receiver = UnixDatagramReceiver(socket_path)
+        await receiver.start()
+
+        senders = [socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET) for _ in range(2)]
+        try:
+            for i, sender in enumerate(senders):
+                sender.connect(socket_path)
+                sender.send(b'from %d' % i)
+
+            assert sorted(await drain(receiver, 2)) == [b'from 0', b'from 1']
+            assert len(receiver._connections) == 2
+
+            # a sender that goes away is forgotten
+            senders[0].close()
+            await asyncio.sleep(0.1)
+            assert len(receiver._connections) == 1
+        finally:
+            for sender in senders:
+                sender.close()
+            await receiver.stop()
+
+    @pytest.mark.asyncio
+    async def test_full_queue_counts_drops(self, socket_path):
+        receiver = UnixDatagramReceiver(socket_path, socket_type='dgram', buffer_size=2)
+        await receiver.start()
+
+        sender = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+        try:
+            for i in range(5):
+                sender.sendto(b'%d' % i, socket_path)
+
+            await asyncio.sleep(0.1)
+
+            assert await drain(receiver, 2) == [b'0', b'1']
+            assert receiver.dropped == 3
+        finally:
+            sender.close()
+            await receiver.stop()
+
+    @pytest.mark.asyncio
+    async def test_get_times_out(self, socket_path):
+        receiver = UnixDatagramReceiver(socket_path, socket_type='dgram')
+        await receiver.start()
+        try:
+            with pytest.raises(asyncio.TimeoutError):
+                await receiver.get(0.05)
+        finally:
+            await receiver.stop()
+
+    @pytest.mark.asyncio
+    async def test_stale_socket_is_replaced_and_removed(self, socket_path):
+        open(socket_path, 'w').close()
+
+        receiver = UnixDatagramReceiver(socket_path)
+        await receiver.start()
+        await receiver.stop()
+
+        with pytest.raises(FileNotFoundError):
+            open(socket_path)
+
+
+class TestUnixEventStream:
+    """Events from a unix:// endpoint through the stream connector."""
+
+    @pytest.mark.asyncio
+    async def test_stream_over_unix_socket(self, socket_path):
+        connector = Snort3EventStream(
+            endpoint=f'unix://{socket_path}',
+            buffer_size=3,
+            unix_socket_type='dgram'
+        )
+        await connector.connect()
+
+        sender = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+        events = connector.stream()
+        try:
+            sender.sendto(b'{"type": "alert", "sid": 1}', socket_path)
+            sender.sendto(b'{"type": "heartbeat", "sender": 0}', socket_path)
+            sender.sendto(b'{"type": "flow"}', socket_path)
+            sender.sendto(b'{"type": "flow"}', socket_path)
+
+            first = await asyncio.wait_for(events.__anext__(), 5)
+            second = await asyncio.wait_for(events.__anext__(), 5)
+
+            assert first['sid'] == 1
+            assert second['type'] == 'flow'
+            assert connector.stats['heartbeats'] == 1
+        finally:
+            await events.aclose()
+            sender.close()
+            await connector.disconnect()
+
+        # the receiver's queue held three; the fourth event was dropped
+        assert connector.stats['events_dropped'] == 1
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
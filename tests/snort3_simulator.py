@@ -3,6 +3,8 @@ Snort3 Event Simulator
 Simulates Snort3 events over ZeroMQ for testing AI-Ops integration
 """
 
+import os
+import sys
 import zmq
 import msgpack
 import time
@@ -11,6 +13,10 @@ import json
 from datetime import datetime, UTC
 from typing import Dict, Any
 
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from connectors.event_topics import event_topic
+
 class Snort3EventSimulator:
     """Simulates Snort3 events for testing purposes."""
     
@@ -113,7 +119,9 @@ class Snort3EventSimulator:
         else:
             data = json.dumps(event).encode()
         
-        self.socket.send(data)
+        # same framing as the exporter's PUB mode, so subscribers can
+        # filter by topic prefix
+        self.socket.send_multipart([event_topic(event), data])
         
     def simulate(self, duration: int = 60, events_per_second: float = 2.0):
         """